@@ -1,17 +1,22 @@
 #include "GolfBall.hpp"
+#include "MeshBlob.hpp"
 #include "Paths.hpp"
+#include "ShaderWatcher.hpp"
 #include "LayoutLocations.glsl"
 
-#include <atlas/utils/Mesh.hpp>
 #include <atlas/core/STB.hpp>
 #include <atlas/core/Float.hpp>
 #include <atlas/utils/GUI.hpp>
 
+#include <algorithm>
+
 namespace lab2
 {
     GolfBall::GolfBall() :
         mVertexBuffer(GL_ARRAY_BUFFER),
         mIndexBuffer(GL_ELEMENT_ARRAY_BUFFER),
+        mUniformTable({ "model", "projection", "view", "materialColour" }),
+        mShaderGeneration(0),
         mTruePosition(6, 1, 12),
         mApproxPosition(-6, 1, 12),
         mOffset(6, 1, 12),
@@ -19,37 +24,24 @@ namespace lab2
         mApproxOldPosition(-6, 1, 12),
         mForce(0, 0, -10),
         mMass(1.0f),
-        mIntegrator(0)
+        mIntegrator(0),
+        mEnsembleMode(false),
+        mEnsembleSize(4096)
     {
-        using atlas::utils::Mesh;
         namespace gl = atlas::gl;
         namespace math = atlas::math;
 
-        Mesh sphere;
+        MeshBlob sphere;
         std::string path{ DataDirectory };
         path = path + "sphere.obj";
-        Mesh::fromFile(path, sphere);
-
-        mIndexCount = static_cast<GLsizei>(sphere.indices().size());
-
-        std::vector<float> data;
-        for (std::size_t i = 0; i < sphere.vertices().size(); ++i)
-        {
-            data.push_back(sphere.vertices()[i].x);
-            data.push_back(sphere.vertices()[i].y);
-            data.push_back(sphere.vertices()[i].z);
-
-            data.push_back(sphere.normals()[i].x);
-            data.push_back(sphere.normals()[i].y);
-            data.push_back(sphere.normals()[i].z);
-
-            data.push_back(sphere.texCoords()[i].x);
-            data.push_back(sphere.texCoords()[i].y);
-        }
+        // Without the mesh the ball is simply not drawn; load() has
+        // already logged why.
+        bool loaded = sphere.load(path);
+        mIndexCount = loaded ? static_cast<GLsizei>(sphere.indexCount()) : 0;
 
         mVao.bindVertexArray();
         mVertexBuffer.bindBuffer();
-        mVertexBuffer.bufferData(gl::size<float>(data.size()), data.data(),
+        mVertexBuffer.bufferData(sphere.vertexBytes(), sphere.vertices(),
             GL_STATIC_DRAW);
         mVertexBuffer.vertexAttribPointer(VERTICES_LAYOUT_LOCATION, 3, GL_FLOAT,
             GL_FALSE, gl::stride<float>(8), gl::bufferOffset<float>(0));
@@ -63,8 +55,8 @@ namespace lab2
         mVao.enableVertexAttribArray(TEXTURES_LAYOUT_LOCATION);
 
         mIndexBuffer.bindBuffer();
-        mIndexBuffer.bufferData(gl::size<GLuint>(sphere.indices().size()),
-            sphere.indices().data(), GL_STATIC_DRAW);
+        mIndexBuffer.bufferData(sphere.indexBytes(), sphere.indices(),
+            GL_STATIC_DRAW);
 
         mIndexBuffer.unBindBuffer();
         mVertexBuffer.unBindBuffer();
@@ -77,31 +69,39 @@ namespace lab2
         };
 
         mShaders.emplace_back(shaders);
+
+#if defined(SHADER_HOT_RELOAD)
+        for (auto const& unit : shaders)
+        {
+            ShaderWatcher::getInstance().watch(unit.filename);
+        }
+        mShaderGeneration = ShaderWatcher::getInstance().generation();
+#endif
+
         mShaders[0].setShaderIncludeDir(ShaderDirectory);
-        mShaders[0].compileShaders();
-        mShaders[0].linkShaders();
-
-        auto var = mShaders[0].getUniformVariable("model");
-        mUniforms.insert(UniformKey("model", var));
-        var = mShaders[0].getUniformVariable("projection");
-        mUniforms.insert(UniformKey("projection", var));
-        var = mShaders[0].getUniformVariable("view");
-        mUniforms.insert(UniformKey("view", var));
-        var = mShaders[0].getUniformVariable("materialColour");
-        mUniforms.insert(UniformKey("materialColour", var));
-
-        mShaders[0].disableShaders();
+        mProgram.build(mShaders[0], shaders, ShaderDirectory);
+
+        mUniformTable.resolve(mProgram);
+
+        mProgram.disableProgram();
     }
 
     void GolfBall::updateGeometry(atlas::core::Time<> const& t)
     {
         using atlas::core::leq;
 
+        // The ensemble runs on the same clock as the ball, so it stops when
+        // the ball lands.
         if (leq(mTruePosition.z, -12.0f))
         {
             return;
         }
 
+        if (mEnsembleMode && mEnsemble.size() > 0)
+        {
+            mEnsemble.step(t.deltaTime);
+        }
+
         switch (mIntegrator)
         {
         case 0:
@@ -130,7 +130,7 @@ namespace lab2
 
     void GolfBall::drawGui()
     {
-        ImGui::SetNextWindowSize(ImVec2(300, 100), ImGuiSetCond_FirstUseEver);
+        ImGui::SetNextWindowSize(ImVec2(420, 220), ImGuiSetCond_FirstUseEver);
         ImGui::Begin("Integration Controls");
 
         std::vector<const char*> integratorNames = { "Euler Intergrator",
@@ -138,6 +138,27 @@ namespace lab2
         ImGui::Combo("Integrator", &mIntegrator, integratorNames.data(),
             ((int)integratorNames.size()));
         ImGui::InputFloat("Set force", &mForce.z, 1.0f, 5.0f, 1);
+
+        ImGui::Checkbox("Ensemble Mode", &mEnsembleMode);
+        ImGui::InputInt("Ensemble size", &mEnsembleSize, 256, 4096);
+        if (ImGui::Button("Generate Ensemble"))
+        {
+            mEnsembleSize = std::max(mEnsembleSize, 1);
+            mEnsemble.generate(static_cast<std::size_t>(mEnsembleSize),
+                GolfEnsemble::defaultParams(), 473u);
+        }
+
+        if (mEnsemble.size() > 0)
+        {
+            ImGui::Text("Step %d, t = %.3f s", (int)mEnsemble.steps(),
+                mEnsemble.time());
+            for (std::size_t i = 0; i < IntegratorCount; ++i)
+            {
+                auto const& stats = mEnsemble.stats(static_cast<Integrator>(i));
+                ImGui::Text("%-26s mean %.2e  rms %.2e  max %.2e",
+                    integratorNames[i], stats.mean, stats.rms, stats.max);
+            }
+        }
         ImGui::End();
     }
     
@@ -146,27 +167,40 @@ namespace lab2
     {
         namespace math = atlas::math;
 
-        mShaders[0].hotReloadShaders();
-        if (!mShaders[0].shaderProgramValid())
+#if defined(SHADER_HOT_RELOAD)
+        auto generation = ShaderWatcher::getInstance().generation();
+        if (generation != mShaderGeneration)
+        {
+            mShaderGeneration = generation;
+            mProgram.reload(mShaders[0]);
+        }
+#endif
+
+        if (!mProgram.programValid())
         {
             return;
         }
 
-        mShaders[0].enableShaders();
+        mUniformTable.resolve(mProgram);
+
+        mProgram.enableProgram();
 
         mVao.bindVertexArray();
         mIndexBuffer.bindBuffer();
 
-        glUniformMatrix4fv(mUniforms["projection"], 1, GL_FALSE,
-            &projection[0][0]);
-        glUniformMatrix4fv(mUniforms["view"], 1, GL_FALSE, &view[0][0]);
+        glUniformMatrix4fv(mUniformTable.get<GolfUniform::Projection>(),
+            1, GL_FALSE, &projection[0][0]);
+        glUniformMatrix4fv(mUniformTable.get<GolfUniform::View>(),
+            1, GL_FALSE, &view[0][0]);
 
         // Render the true sphere first.
         {
             const math::Vector copper{ 0.71f, 0.44f, 0.19f };
             auto model = glm::translate(math::Matrix4(1.0f), mTruePosition);
-            glUniformMatrix4fv(mUniforms["model"], 1, GL_FALSE, &model[0][0]);
-            glUniform3fv(mUniforms["materialColour"], 1, &copper[0]);
+            glUniformMatrix4fv(mUniformTable.get<GolfUniform::Model>(),
+                1, GL_FALSE, &model[0][0]);
+            glUniform3fv(mUniformTable.get<GolfUniform::MaterialColour>(),
+                1, &copper[0]);
             glDrawElements(GL_TRIANGLES, mIndexCount, GL_UNSIGNED_INT, 0);
         }
 
@@ -174,14 +208,16 @@ namespace lab2
         {
             const math::Vector metalGray{ 0.0f, 0.46f, 0.69f };
             auto model = glm::translate(math::Matrix4(1.0f), mApproxPosition);
-            glUniformMatrix4fv(mUniforms["model"], 1, GL_FALSE, &model[0][0]);
-            glUniform3fv(mUniforms["materialColour"], 1, &metalGray[0]);
+            glUniformMatrix4fv(mUniformTable.get<GolfUniform::Model>(),
+                1, GL_FALSE, &model[0][0]);
+            glUniform3fv(mUniformTable.get<GolfUniform::MaterialColour>(),
+                1, &metalGray[0]);
             glDrawElements(GL_TRIANGLES, mIndexCount, GL_UNSIGNED_INT, 0);
         }
 
         mIndexBuffer.unBindBuffer();
         mVao.unBindVertexArray();
-        mShaders[0].disableShaders();
+        mProgram.disableProgram();
     }
 
     void GolfBall::resetGeometry()
@@ -190,6 +226,8 @@ namespace lab2
         mApproxPosition = { -6, 1, 12 };
         mApproxOldPosition = mApproxPosition;
         mApproxVelocity = { 0, 0, 0 };
+
+        mEnsemble.reset();
     }
 
     void GolfBall::eulerIntegrator(atlas::core::Time<> const& t)
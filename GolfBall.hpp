@@ -5,8 +5,23 @@
 #include <atlas/gl/VertexArrayObject.hpp>
 #include <atlas/gl/Texture.hpp>
 
+#include "GolfEnsemble.hpp"
+#include "UniformTable.hpp"
+#include "CachedProgram.hpp"
+
+#include <cstdint>
+
 namespace lab2
 {
+    enum class GolfUniform : std::size_t
+    {
+        Model = 0,
+        Projection,
+        View,
+        MaterialColour,
+        Count
+    };
+
     class GolfBall : public atlas::utils::Geometry
     {
     public:
@@ -29,6 +44,10 @@ namespace lab2
         atlas::gl::Buffer mIndexBuffer;
         atlas::gl::VertexArrayObject mVao;
 
+        UniformTable<GolfUniform> mUniformTable;
+        CachedProgram mProgram;
+        std::uint64_t mShaderGeneration;
+
         atlas::math::Vector mTruePosition;
         atlas::math::Vector mOffset;
         atlas::math::Vector mApproxPosition;
@@ -40,6 +59,10 @@ namespace lab2
         float mMass;
         int mIntegrator;
 
+        GolfEnsemble mEnsemble;
+        bool mEnsembleMode;
+        int mEnsembleSize;
+
         GLsizei mIndexCount;
     };
 }
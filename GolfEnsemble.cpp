@@ -0,0 +1,339 @@
+#include "GolfEnsemble.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace lab2
+{
+    void EnsembleState::resize(std::size_t count)
+    {
+        x.resize(count);
+        y.resize(count);
+        z.resize(count);
+        vx.resize(count);
+        vy.resize(count);
+        vz.resize(count);
+        ox.resize(count);
+        oy.resize(count);
+        oz.resize(count);
+    }
+
+    GolfEnsemble::GolfEnsemble() :
+        mSteps(0),
+        mTime(0.0)
+    {
+        mStats.fill({ 0.0, 0.0, 0.0 });
+        mStateSteps.fill(0);
+    }
+
+    EnsembleParams GolfEnsemble::defaultParams()
+    {
+        return { 1.0f, 20.0f, 0.05f, 2.0f, 1.0f, 20.0f };
+    }
+
+    void GolfEnsemble::generate(std::size_t count,
+        EnsembleParams const& params, unsigned int seed)
+    {
+        std::mt19937 engine(seed);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::uniform_real_distribution<float> speed(params.minSpeed,
+            params.maxSpeed);
+        std::uniform_real_distribution<float> mass(params.minMass,
+            params.maxMass);
+        std::uniform_real_distribution<float> force(params.minForce,
+            params.maxForce);
+
+        for (auto v : { &mX0, &mY0, &mZ0, &mVx0, &mVy0, &mVz0, &mAx, &mAy,
+            &mAz, &mMass, &mTrueX, &mTrueY, &mTrueZ })
+        {
+            v->resize(count);
+        }
+
+        const float twoPi = 6.2831853f;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            // Launch from the tee in a random direction above the ground.
+            float azimuth = twoPi * unit(engine);
+            float elevation = 0.5f * 3.1415927f * unit(engine);
+            float s = speed(engine);
+
+            mX0[i] = -6.0f;
+            mY0[i] = 1.0f;
+            mZ0[i] = 12.0f;
+
+            mVx0[i] = s * std::cos(elevation) * std::cos(azimuth);
+            mVy0[i] = s * std::cos(elevation) * std::sin(azimuth);
+            mVz0[i] = s * std::sin(elevation);
+
+            mMass[i] = mass(engine);
+            mAx[i] = 0.0f;
+            mAy[i] = 0.0f;
+            mAz[i] = -force(engine) / mMass[i];
+        }
+
+        for (auto& state : mStates)
+        {
+            state.resize(count);
+        }
+
+        reset();
+    }
+
+    void GolfEnsemble::reset()
+    {
+        for (auto& state : mStates)
+        {
+            std::copy(mX0.begin(), mX0.end(), state.x.begin());
+            std::copy(mY0.begin(), mY0.end(), state.y.begin());
+            std::copy(mZ0.begin(), mZ0.end(), state.z.begin());
+            std::copy(mVx0.begin(), mVx0.end(), state.vx.begin());
+            std::copy(mVy0.begin(), mVy0.end(), state.vy.begin());
+            std::copy(mVz0.begin(), mVz0.end(), state.vz.begin());
+            std::copy(mX0.begin(), mX0.end(), state.ox.begin());
+            std::copy(mY0.begin(), mY0.end(), state.oy.begin());
+            std::copy(mZ0.begin(), mZ0.end(), state.oz.begin());
+        }
+
+        mStats.fill({ 0.0, 0.0, 0.0 });
+        mStateSteps.fill(0);
+        mSteps = 0;
+        mTime = 0.0;
+    }
+
+    void GolfEnsemble::step(float dt)
+    {
+        for (std::size_t k = 0; k < IntegratorCount; ++k)
+        {
+            advance(static_cast<Integrator>(k), dt, 1);
+        }
+
+        // Frame times vary, so the clock sums the steps actually taken.
+        ++mSteps;
+        mTime += static_cast<double>(dt);
+        computeErrors();
+    }
+
+    void GolfEnsemble::advance(Integrator integrator, float dt,
+        std::size_t steps)
+    {
+        std::size_t index = static_cast<std::size_t>(integrator);
+        auto& state = mStates[index];
+
+        for (std::size_t i = 0; i < steps; ++i)
+        {
+            switch (integrator)
+            {
+            case Integrator::Euler:
+                eulerStep(state, mAx, mAy, mAz, dt);
+                break;
+
+            case Integrator::ImplicitEuler:
+                implicitEulerStep(state, mAx, mAy, mAz, dt);
+                break;
+
+            case Integrator::Verlet:
+                if (mStateSteps[index] == 0)
+                {
+                    startVerlet(state, mAx, mAy, mAz, dt);
+                }
+                verletStep(state, mAx, mAy, mAz, dt);
+                break;
+
+            case Integrator::RungeKutta:
+                rk4Step(state, mAx, mAy, mAz, dt);
+                break;
+
+            default:
+                break;
+            }
+
+            ++mStateSteps[index];
+        }
+    }
+
+    ErrorStats GolfEnsemble::errorAt(Integrator integrator, double time)
+    {
+        computeTruth(time);
+        return measure(mStates[static_cast<std::size_t>(integrator)], mTrueX,
+            mTrueY, mTrueZ);
+    }
+
+    void GolfEnsemble::computeTruth(double time)
+    {
+        const std::size_t n = size();
+        const double halfTSq = 0.5 * time * time;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            mTrueX[i] = static_cast<float>(mX0[i] + time * mVx0[i] +
+                halfTSq * mAx[i]);
+            mTrueY[i] = static_cast<float>(mY0[i] + time * mVy0[i] +
+                halfTSq * mAy[i]);
+            mTrueZ[i] = static_cast<float>(mZ0[i] + time * mVz0[i] +
+                halfTSq * mAz[i]);
+        }
+    }
+
+    std::size_t GolfEnsemble::size() const
+    {
+        return mMass.size();
+    }
+
+    std::size_t GolfEnsemble::steps() const
+    {
+        return mSteps;
+    }
+
+    double GolfEnsemble::time() const
+    {
+        return mTime;
+    }
+
+    ErrorStats const& GolfEnsemble::stats(Integrator integrator) const
+    {
+        return mStats[static_cast<std::size_t>(integrator)];
+    }
+
+    void GolfEnsemble::eulerStep(EnsembleState& s,
+        std::vector<float> const& ax, std::vector<float> const& ay,
+        std::vector<float> const& az, float dt)
+    {
+        const std::size_t n = s.x.size();
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            s.x[i] += dt * s.vx[i];
+            s.y[i] += dt * s.vy[i];
+            s.z[i] += dt * s.vz[i];
+
+            s.vx[i] += dt * ax[i];
+            s.vy[i] += dt * ay[i];
+            s.vz[i] += dt * az[i];
+        }
+    }
+
+    void GolfEnsemble::implicitEulerStep(EnsembleState& s,
+        std::vector<float> const& ax, std::vector<float> const& ay,
+        std::vector<float> const& az, float dt)
+    {
+        const std::size_t n = s.x.size();
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            s.vx[i] += dt * ax[i];
+            s.vy[i] += dt * ay[i];
+            s.vz[i] += dt * az[i];
+
+            s.x[i] += dt * s.vx[i];
+            s.y[i] += dt * s.vy[i];
+            s.z[i] += dt * s.vz[i];
+        }
+    }
+
+    void GolfEnsemble::startVerlet(EnsembleState& s,
+        std::vector<float> const& ax, std::vector<float> const& ay,
+        std::vector<float> const& az, float dt)
+    {
+        const std::size_t n = s.x.size();
+        const float halfDtSq = 0.5f * dt * dt;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            s.ox[i] = s.x[i] - dt * s.vx[i] + halfDtSq * ax[i];
+            s.oy[i] = s.y[i] - dt * s.vy[i] + halfDtSq * ay[i];
+            s.oz[i] = s.z[i] - dt * s.vz[i] + halfDtSq * az[i];
+        }
+    }
+
+    void GolfEnsemble::verletStep(EnsembleState& s,
+        std::vector<float> const& ax, std::vector<float> const& ay,
+        std::vector<float> const& az, float dt)
+    {
+        const std::size_t n = s.x.size();
+        const float dtSq = dt * dt;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            float x = 2.0f * s.x[i] - s.ox[i] + dtSq * ax[i];
+            float y = 2.0f * s.y[i] - s.oy[i] + dtSq * ay[i];
+            float z = 2.0f * s.z[i] - s.oz[i] + dtSq * az[i];
+
+            s.ox[i] = s.x[i];
+            s.oy[i] = s.y[i];
+            s.oz[i] = s.z[i];
+
+            s.x[i] = x;
+            s.y[i] = y;
+            s.z[i] = z;
+        }
+    }
+
+    // Classic RK4 on the state (x, v) with x' = v and v' = F / m. The force
+    // does not depend on the state, so every acceleration stage is a.
+    void GolfEnsemble::rk4Step(EnsembleState& s,
+        std::vector<float> const& ax, std::vector<float> const& ay,
+        std::vector<float> const& az, float dt)
+    {
+        const std::size_t n = s.x.size();
+        const float h = 0.5f * dt;
+        const float sixth = dt / 6.0f;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            float k1x = s.vx[i];
+            float k1y = s.vy[i];
+            float k1z = s.vz[i];
+
+            float k2x = s.vx[i] + h * ax[i];
+            float k2y = s.vy[i] + h * ay[i];
+            float k2z = s.vz[i] + h * az[i];
+
+            float k4x = s.vx[i] + dt * ax[i];
+            float k4y = s.vy[i] + dt * ay[i];
+            float k4z = s.vz[i] + dt * az[i];
+
+            // k3 equals k2 because the acceleration is constant.
+            s.x[i] += sixth * (k1x + 4.0f * k2x + k4x);
+            s.y[i] += sixth * (k1y + 4.0f * k2y + k4y);
+            s.z[i] += sixth * (k1z + 4.0f * k2z + k4z);
+
+            s.vx[i] += dt * ax[i];
+            s.vy[i] += dt * ay[i];
+            s.vz[i] += dt * az[i];
+        }
+    }
+
+    ErrorStats GolfEnsemble::measure(EnsembleState const& s,
+        std::vector<float> const& x, std::vector<float> const& y,
+        std::vector<float> const& z)
+    {
+        const std::size_t n = s.x.size();
+        if (n == 0)
+        {
+            return { 0.0, 0.0, 0.0 };
+        }
+
+        double sum = 0.0;
+        double sumSq = 0.0;
+        double max = 0.0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            double dx = s.x[i] - x[i];
+            double dy = s.y[i] - y[i];
+            double dz = s.z[i] - z[i];
+            double errSq = dx * dx + dy * dy + dz * dz;
+            double err = std::sqrt(errSq);
+
+            sum += err;
+            sumSq += errSq;
+            max = std::max(max, err);
+        }
+
+        return { sum / n, std::sqrt(sumSq / n), max };
+    }
+
+    void GolfEnsemble::computeErrors()
+    {
+        // Every state is at mTime, so one truth serves them all.
+        computeTruth(mTime);
+        for (std::size_t k = 0; k < IntegratorCount; ++k)
+        {
+            mStats[k] = measure(mStates[k], mTrueX, mTrueY, mTrueZ);
+        }
+    }
+}
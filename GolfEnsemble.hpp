@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace lab2
+{
+    enum class Integrator : int
+    {
+        Euler = 0,
+        ImplicitEuler,
+        Verlet,
+        RungeKutta,
+        Count
+    };
+
+    constexpr std::size_t IntegratorCount =
+        static_cast<std::size_t>(Integrator::Count);
+
+    struct ErrorStats
+    {
+        double mean;
+        double rms;
+        double max;
+    };
+
+    struct EnsembleParams
+    {
+        float minSpeed;
+        float maxSpeed;
+        float minMass;
+        float maxMass;
+        float minForce;
+        float maxForce;
+    };
+
+    // Structure-of-arrays state for one integrator. Each component lives in
+    // its own contiguous array so the per-step loops vectorize.
+    struct EnsembleState
+    {
+        void resize(std::size_t count);
+
+        std::vector<float> x, y, z;
+        std::vector<float> vx, vy, vz;
+        std::vector<float> ox, oy, oz;
+    };
+
+    // Integrates many independent balls under constant forces with every
+    // integrator side by side, and measures each one against the closed
+    // form x0 + v0 t + 0.5 F/m t^2 after every step.
+    class GolfEnsemble
+    {
+    public:
+        GolfEnsemble();
+
+        void generate(std::size_t count, EnsembleParams const& params,
+            unsigned int seed);
+        void reset();
+
+        void step(float dt);
+
+        // Advances a single integrator's state without touching the others
+        // or the ensemble clock, so integrators can be timed in isolation.
+        void advance(Integrator integrator, float dt, std::size_t steps);
+        ErrorStats errorAt(Integrator integrator, double time);
+
+        std::size_t size() const;
+        std::size_t steps() const;
+        double time() const;
+        ErrorStats const& stats(Integrator integrator) const;
+
+        static EnsembleParams defaultParams();
+
+        static void eulerStep(EnsembleState& s, std::vector<float> const& ax,
+            std::vector<float> const& ay, std::vector<float> const& az,
+            float dt);
+        static void implicitEulerStep(EnsembleState& s,
+            std::vector<float> const& ax, std::vector<float> const& ay,
+            std::vector<float> const& az, float dt);
+        static void verletStep(EnsembleState& s, std::vector<float> const& ax,
+            std::vector<float> const& ay, std::vector<float> const& az,
+            float dt);
+        static void rk4Step(EnsembleState& s, std::vector<float> const& ax,
+            std::vector<float> const& ay, std::vector<float> const& az,
+            float dt);
+
+        // Position Verlet needs the previous position; seeding it with the
+        // second-order Taylor step keeps the scheme consistent from t = 0.
+        // verletStep never writes the velocity, which nothing reads, so it
+        // stays at v0 for this seed.
+        static void startVerlet(EnsembleState& s,
+            std::vector<float> const& ax, std::vector<float> const& ay,
+            std::vector<float> const& az, float dt);
+
+        static ErrorStats measure(EnsembleState const& s,
+            std::vector<float> const& x, std::vector<float> const& y,
+            std::vector<float> const& z);
+
+    private:
+        // Fills mTrue* with the closed-form positions at time.
+        void computeTruth(double time);
+        void computeErrors();
+
+        // Initial conditions and per-ball parameters, shared by all states.
+        std::vector<float> mX0, mY0, mZ0;
+        std::vector<float> mVx0, mVy0, mVz0;
+        std::vector<float> mAx, mAy, mAz;
+        std::vector<float> mMass;
+
+        std::array<EnsembleState, IntegratorCount> mStates;
+        std::array<ErrorStats, IntegratorCount> mStats;
+        std::array<std::size_t, IntegratorCount> mStateSteps;
+        std::vector<float> mTrueX, mTrueY, mTrueZ;
+
+        std::size_t mSteps;
+        double mTime;
+    };
+}
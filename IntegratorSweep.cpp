@@ -0,0 +1,391 @@
+// Headless accuracy/cost sweep over the GolfBall integrators.
+//
+// Every integrator is run over a ladder of time steps against the closed
+// form solution, reporting the global error at the final time, the
+// empirical convergence order between neighbouring steps and the cost per
+// ball-step. Rows whose error is within float round-off of the solution
+// are flagged roundoff_limited; rows whose error is larger than at the
+// next-coarser step are flagged error_growing, which is how accumulated
+// round-off shows once it outgrows truncation error. With --target it also
+// picks the cheapest integrator and step that meet the requested error.
+//
+// Built by the CMakeLists.txt next to this file.
+//
+// Usage: IntegratorSweep [--balls N] [--time T] [--dt DT] [--levels L]
+//        [--threads N] [--format csv|json] [--out FILE] [--target ERR]
+
+#include "GolfEnsemble.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using namespace lab2;
+
+    const char* integratorNames[] = { "euler", "implicit_euler", "verlet",
+        "rk4" };
+
+    struct SweepOptions
+    {
+        std::size_t balls = 2048;
+        double time = 2.0;
+        double dt = 0.125;
+        int levels = 10;
+        unsigned int threads = 0;
+        std::string format = "csv";
+        std::string out;
+        double target = 0.0;
+    };
+
+    struct SweepResult
+    {
+        Integrator integrator;
+        double dt;
+        std::size_t steps;
+        ErrorStats error;
+        double nsPerStep;
+        double order;
+        bool roundoffLimited;
+        bool errorGrowing;
+    };
+
+    bool parseOptions(int argc, char** argv, SweepOptions& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (i + 1 >= argc)
+            {
+                std::fprintf(stderr, "missing value for %s\n", arg.c_str());
+                return false;
+            }
+
+            const char* value = argv[++i];
+            if (arg == "--balls")
+            {
+                options.balls = std::strtoul(value, nullptr, 10);
+            }
+            else if (arg == "--time")
+            {
+                options.time = std::strtod(value, nullptr);
+            }
+            else if (arg == "--dt")
+            {
+                options.dt = std::strtod(value, nullptr);
+            }
+            else if (arg == "--levels")
+            {
+                options.levels = std::atoi(value);
+            }
+            else if (arg == "--threads")
+            {
+                options.threads = std::strtoul(value, nullptr, 10);
+            }
+            else if (arg == "--format")
+            {
+                options.format = value;
+            }
+            else if (arg == "--out")
+            {
+                options.out = value;
+            }
+            else if (arg == "--target")
+            {
+                options.target = std::strtod(value, nullptr);
+            }
+            else
+            {
+                std::fprintf(stderr, "unknown option %s\n", arg.c_str());
+                return false;
+            }
+        }
+
+        return options.balls > 0 && options.levels > 0 && options.dt > 0.0 &&
+            options.time > 0.0 &&
+            (options.format == "csv" || options.format == "json");
+    }
+
+    // Bound on how far any ball can be from the origin at the final time,
+    // which sets the size of one float ulp in the position error.
+    double solutionScale(EnsembleParams const& params, double time)
+    {
+        double accel = params.maxForce / params.minMass;
+        return 14.0 + params.maxSpeed * time + 0.5 * accel * time * time;
+    }
+
+    // Cost per ball-step does not depend on dt, so timing needs only a
+    // short run rather than the whole ladder rung.
+    const std::size_t TimingSteps = 256;
+
+    void runJob(GolfEnsemble const& prototype, SweepResult& result,
+        double scale)
+    {
+        // Each job integrates its own copy so jobs never share state.
+        GolfEnsemble ensemble = prototype;
+        ensemble.advance(result.integrator, static_cast<float>(result.dt),
+            result.steps);
+        result.error = ensemble.errorAt(result.integrator,
+            result.steps * result.dt);
+
+        // Each step rounds by up to an ulp of the solution scale, and the
+        // roundings add up like a random walk, so below about sqrt(steps)
+        // ulps the error is float round-off rather than truncation and the
+        // order means nothing.
+        result.roundoffLimited = result.error.rms <
+            std::numeric_limits<float>::epsilon() * scale *
+            std::sqrt(static_cast<double>(result.steps));
+    }
+
+    // Run with nothing else going on, so jobs do not contend for cores and
+    // memory bandwidth while they are timed.
+    void timeJob(GolfEnsemble const& prototype, SweepResult& result)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        GolfEnsemble ensemble = prototype;
+        std::size_t steps = std::min(result.steps, TimingSteps);
+
+        auto start = Clock::now();
+        ensemble.advance(result.integrator, static_cast<float>(result.dt),
+            steps);
+        auto stop = Clock::now();
+
+        double ns = std::chrono::duration<double, std::nano>(
+            stop - start).count();
+        result.nsPerStep = ns / (steps * ensemble.size());
+    }
+
+    void computeOrders(std::vector<SweepResult>& results, int levels)
+    {
+        for (std::size_t k = 0; k < IntegratorCount; ++k)
+        {
+            SweepResult* row = results.data() + k * levels;
+            row[0].order = std::numeric_limits<double>::quiet_NaN();
+            for (int l = 1; l < levels; ++l)
+            {
+                SweepResult const& coarse = row[l - 1];
+                SweepResult& fine = row[l];
+
+                // Truncation error only falls with the step, so an error
+                // that rises is round-off accumulating over the extra
+                // steps. Position Verlet's grows with the square of the
+                // step count, as each step differences two nearby
+                // positions.
+                fine.errorGrowing = fine.error.rms > coarse.error.rms;
+
+                if (coarse.roundoffLimited || fine.roundoffLimited ||
+                    fine.error.rms <= 0.0 ||
+                    fine.error.rms >= coarse.error.rms)
+                {
+                    fine.order = std::numeric_limits<double>::quiet_NaN();
+                    continue;
+                }
+
+                fine.order = std::log(coarse.error.rms / fine.error.rms) /
+                    std::log(coarse.dt / fine.dt);
+            }
+        }
+    }
+
+    void writeCsv(std::FILE* out, std::vector<SweepResult> const& results)
+    {
+        std::fprintf(out, "integrator,dt,steps,rms_error,mean_error,"
+            "max_error,order,ns_per_step,roundoff_limited,error_growing\n");
+        for (auto const& r : results)
+        {
+            std::fprintf(out, "%s,%.9g,%zu,%.9g,%.9g,%.9g,",
+                integratorNames[static_cast<int>(r.integrator)], r.dt,
+                r.steps, r.error.rms, r.error.mean, r.error.max);
+            if (std::isnan(r.order))
+            {
+                std::fprintf(out, ",");
+            }
+            else
+            {
+                std::fprintf(out, "%.4f,", r.order);
+            }
+            std::fprintf(out, "%.4f,%d,%d\n", r.nsPerStep,
+                r.roundoffLimited ? 1 : 0, r.errorGrowing ? 1 : 0);
+        }
+    }
+
+    void writeJson(std::FILE* out, std::vector<SweepResult> const& results,
+        SweepOptions const& options)
+    {
+        std::fprintf(out, "{\n  \"balls\": %zu,\n  \"time\": %.9g,\n"
+            "  \"results\": [\n", options.balls, options.time);
+        for (std::size_t i = 0; i < results.size(); ++i)
+        {
+            auto const& r = results[i];
+            std::fprintf(out, "    {\"integrator\": \"%s\", \"dt\": %.9g, "
+                "\"steps\": %zu, \"rms_error\": %.9g, \"mean_error\": %.9g, "
+                "\"max_error\": %.9g, \"order\": ",
+                integratorNames[static_cast<int>(r.integrator)], r.dt,
+                r.steps, r.error.rms, r.error.mean, r.error.max);
+            if (std::isnan(r.order))
+            {
+                std::fprintf(out, "null");
+            }
+            else
+            {
+                std::fprintf(out, "%.4f", r.order);
+            }
+            std::fprintf(out, ", \"ns_per_step\": %.4f, "
+                "\"roundoff_limited\": %s, \"error_growing\": %s}%s\n",
+                r.nsPerStep, r.roundoffLimited ? "true" : "false",
+                r.errorGrowing ? "true" : "false",
+                (i + 1 < results.size()) ? "," : "");
+        }
+        std::fprintf(out, "  ]\n}\n");
+    }
+
+    // Total cost of a run is its per-step cost times the number of steps,
+    // so the cheapest choice is not always the cheapest integrator.
+    void reportCheapest(std::vector<SweepResult> const& results,
+        double target)
+    {
+        SweepResult const* best = nullptr;
+        double bestCost = std::numeric_limits<double>::max();
+        for (auto const& r : results)
+        {
+            double cost = r.nsPerStep * r.steps;
+            if (r.error.rms <= target && cost < bestCost)
+            {
+                best = &r;
+                bestCost = cost;
+            }
+        }
+
+        if (best == nullptr)
+        {
+            std::fprintf(stderr, "no integrator reaches rms error %g\n",
+                target);
+            return;
+        }
+
+        std::fprintf(stderr, "cheapest for rms error %g: %s at dt = %g "
+            "(%.1f ns per ball)\n", target,
+            integratorNames[static_cast<int>(best->integrator)], best->dt,
+            bestCost);
+
+        // Rows of one integrator are adjacent, finest last.
+        SweepResult const* finer = best + 1;
+        if (finer != results.data() + results.size() &&
+            finer->integrator == best->integrator && finer->errorGrowing)
+        {
+            std::fprintf(stderr, "  smaller steps are less accurate: %s "
+                "accumulates round-off faster than it loses truncation "
+                "error\n", integratorNames[static_cast<int>(best->integrator)]);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    SweepOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        std::fprintf(stderr, "usage: %s [--balls N] [--time T] [--dt DT] "
+            "[--levels L] [--threads N] [--format csv|json] [--out FILE] "
+            "[--target ERR]\n", argv[0]);
+        return 1;
+    }
+
+    EnsembleParams params = GolfEnsemble::defaultParams();
+    GolfEnsemble prototype;
+    prototype.generate(options.balls, params, 473u);
+    double scale = solutionScale(params, options.time);
+
+    // Halve the step at every level; the step count keeps the final time
+    // fixed so errors at different steps are comparable.
+    std::vector<SweepResult> results;
+    for (std::size_t k = 0; k < IntegratorCount; ++k)
+    {
+        for (int l = 0; l < options.levels; ++l)
+        {
+            SweepResult r{};
+            r.integrator = static_cast<Integrator>(k);
+            r.dt = options.dt / std::ldexp(1.0, l);
+            r.steps = static_cast<std::size_t>(
+                std::llround(options.time / r.dt));
+            r.steps = (r.steps == 0) ? 1 : r.steps;
+            results.push_back(r);
+        }
+    }
+
+    unsigned int threads = options.threads;
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Errors are measured in parallel. Longest jobs are at the end of each
+    // ladder; handing jobs out from a shared counter keeps the workers
+    // balanced regardless.
+    std::atomic<std::size_t> next(0);
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&]()
+        {
+            std::size_t job;
+            while ((job = next.fetch_add(1)) < results.size())
+            {
+                runJob(prototype, results[job], scale);
+            }
+        });
+    }
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    for (auto& result : results)
+    {
+        timeJob(prototype, result);
+    }
+
+    computeOrders(results, options.levels);
+
+    std::FILE* out = stdout;
+    if (!options.out.empty())
+    {
+        out = std::fopen(options.out.c_str(), "w");
+        if (out == nullptr)
+        {
+            std::fprintf(stderr, "could not open %s\n", options.out.c_str());
+            return 1;
+        }
+    }
+
+    if (options.format == "json")
+    {
+        writeJson(out, results, options);
+    }
+    else
+    {
+        writeCsv(out, results);
+    }
+
+    if (out != stdout)
+    {
+        std::fclose(out);
+    }
+
+    if (options.target > 0.0)
+    {
+        reportCheapest(results, options.target);
+    }
+
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include "ShaderWatcher.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <sys/stat.h>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace lab2
+{
+    namespace
+    {
+        const int pollIntervalMs = 250;
+
+        long long modificationTime(std::string const& path)
+        {
+            struct stat info;
+            if (stat(path.c_str(), &info) != 0)
+            {
+                return 0;
+            }
+
+            return static_cast<long long>(info.st_mtime);
+        }
+
+#if defined(__linux__)
+        std::string directoryOf(std::string const& path)
+        {
+            auto slash = path.find_last_of("/\\");
+            return (slash == std::string::npos) ? "." : path.substr(0, slash);
+        }
+#endif
+    }
+
+    ShaderWatcher& ShaderWatcher::getInstance()
+    {
+        static ShaderWatcher instance;
+        return instance;
+    }
+
+    ShaderWatcher::ShaderWatcher() :
+        mGeneration(0),
+        mRunning(true),
+        mNotify(-1)
+    {
+#if defined(__linux__)
+        mNotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+        mThread = std::thread(&ShaderWatcher::run, this);
+    }
+
+    ShaderWatcher::~ShaderWatcher()
+    {
+        mRunning = false;
+        if (mThread.joinable())
+        {
+            mThread.join();
+        }
+
+#if defined(__linux__)
+        if (mNotify >= 0)
+        {
+            close(mNotify);
+        }
+#endif
+    }
+
+    void ShaderWatcher::watch(std::string const& file)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if (std::find(mFiles.begin(), mFiles.end(), file) != mFiles.end())
+        {
+            return;
+        }
+
+        mFiles.push_back(file);
+        mTimes.push_back(modificationTime(file));
+
+#if defined(__linux__)
+        // Editors often save by writing a new file and renaming it over
+        // the old one, so watch the directory rather than the file.
+        std::string directory = directoryOf(file);
+        if (mNotify >= 0 && std::find(mDirectories.begin(),
+            mDirectories.end(), directory) == mDirectories.end())
+        {
+            inotify_add_watch(mNotify, directory.c_str(),
+                IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+            mDirectories.push_back(directory);
+        }
+#endif
+    }
+
+    std::uint64_t ShaderWatcher::generation() const
+    {
+        return mGeneration.load(std::memory_order_acquire);
+    }
+
+    void ShaderWatcher::run()
+    {
+        while (mRunning)
+        {
+            bool changed = false;
+
+#if defined(__linux__)
+            if (mNotify >= 0)
+            {
+                pollfd fd{ mNotify, POLLIN, 0 };
+                if (poll(&fd, 1, pollIntervalMs) > 0)
+                {
+                    // Drain every pending event; one bump covers them all.
+                    alignas(inotify_event) char buffer[4096];
+                    while (read(mNotify, buffer, sizeof(buffer)) > 0)
+                    {
+                        changed = true;
+                    }
+                }
+            }
+            else
+#endif
+            {
+                std::this_thread::sleep_for(
+                    std::chrono::milliseconds(pollIntervalMs));
+                changed = pollFiles();
+            }
+
+            if (changed)
+            {
+                mGeneration.fetch_add(1, std::memory_order_release);
+            }
+        }
+    }
+
+    bool ShaderWatcher::pollFiles()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        bool changed = false;
+        for (std::size_t i = 0; i < mFiles.size(); ++i)
+        {
+            long long time = modificationTime(mFiles[i]);
+            if (time != mTimes[i])
+            {
+                mTimes[i] = time;
+                changed = true;
+            }
+        }
+
+        return changed;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace lab2
+{
+    // Watches shader sources from a background thread and bumps a counter
+    // whenever one of them changes. The render thread compares counters
+    // instead of touching the file system every frame.
+    class ShaderWatcher
+    {
+    public:
+        static ShaderWatcher& getInstance();
+
+        ~ShaderWatcher();
+
+        ShaderWatcher(ShaderWatcher const&) = delete;
+        ShaderWatcher& operator=(ShaderWatcher const&) = delete;
+
+        void watch(std::string const& file);
+        std::uint64_t generation() const;
+
+    private:
+        ShaderWatcher();
+
+        void run();
+        bool pollFiles();
+
+        std::atomic<std::uint64_t> mGeneration;
+        std::atomic<bool> mRunning;
+
+        std::mutex mMutex;
+        std::vector<std::string> mFiles;
+        std::vector<long long> mTimes;
+        std::vector<std::string> mDirectories;
+
+        int mNotify;
+        std::thread mThread;
+    };
+}
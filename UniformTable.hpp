@@ -0,0 +1,67 @@
+#pragma once
+
+#include "CachedProgram.hpp"
+
+#include <atlas/gl/GL.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace lab2
+{
+    // Uniform locations indexed by an enum class whose last entry is Count.
+    // Locations are looked up once per link rather than by name on every
+    // draw, and get<Key>() compiles down to a fixed array read.
+    template <typename Key>
+    class UniformTable
+    {
+    public:
+        static constexpr std::size_t Size =
+            static_cast<std::size_t>(Key::Count);
+        using Names = std::array<const char*, Size>;
+
+        explicit UniformTable(Names const& names) :
+            mNames(names),
+            mProgram(0),
+            mLinks(0)
+        {
+            mLocations.fill(-1);
+        }
+
+        // Looks the locations up again only when program has been linked
+        // since they were resolved. A relink can hand back the same name,
+        // so the link count is compared as well. Returns true if it did.
+        bool resolve(CachedProgram const& program)
+        {
+            if (program.getProgram() == mProgram &&
+                program.links() == mLinks)
+            {
+                return false;
+            }
+
+            mProgram = program.getProgram();
+            mLinks = program.links();
+            for (std::size_t i = 0; i < Size; ++i)
+            {
+                mLocations[i] = glGetUniformLocation(mProgram, mNames[i]);
+            }
+
+            return true;
+        }
+
+        template <Key K>
+        GLint get() const
+        {
+            static_assert(static_cast<std::size_t>(K) < Size,
+                "uniform key out of range");
+            return std::get<static_cast<std::size_t>(K)>(mLocations);
+        }
+
+    private:
+        Names mNames;
+        std::array<GLint, Size> mLocations;
+        GLuint mProgram;
+        std::uint64_t mLinks;
+    };
+}
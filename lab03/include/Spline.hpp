@@ -4,12 +4,35 @@
 #include <atlas/gl/Buffer.hpp>
 #include <atlas/gl/VertexArrayObject.hpp>
 
+#include "UniformTable.hpp"
+#include "CachedProgram.hpp"
+
+#include <cstdint>
+
 namespace lab3
 {
+    enum class SpeedProfile : int
+    {
+        Constant = 0,
+        EaseInOut,
+        EaseIn,
+        EaseOut,
+        Custom
+    };
+
+    enum class SplineUniform : std::size_t
+    {
+        Model = 0,
+        Colour,
+        Count
+    };
+
+    // A chain of cubic Bezier segments sharing end points, so the control
+    // points are laid out as 3 * segments + 1.
     class Spline : public atlas::utils::Geometry
     {
     public:
-        Spline(int totalFrames);
+        Spline(float duration);
 
         void updateGeometry(atlas::core::Time<> const& t) override;
         void renderGeometry(atlas::math::Matrix4 const& projection,
@@ -17,22 +40,54 @@ namespace lab3
         void drawGui() override;
 
         void resetGeometry();
-        
+
         atlas::math::Point getPosition() const;
         bool doneInterpolation() const;
 
+        void setDuration(float duration);
+        void setSpeedProfile(SpeedProfile profile);
+
+        // Speeds are sampled uniformly over the normalized animation time
+        // and linearly interpolated in between. They only need to be
+        // non-negative; the curve is rescaled so the whole track is covered
+        // in exactly the animation duration.
+        void setSpeedCurve(std::vector<float> const& speeds);
+
+        void setViewport(int width, int height);
+        void setControlPoint(std::size_t index,
+            atlas::math::Point const& point);
+        void appendSegment(atlas::math::Point const& c1,
+            atlas::math::Point const& c2, atlas::math::Point const& end);
+        std::size_t segmentCount() const;
+
     private:
-        atlas::math::Point interpolateOnSpline() const;
+        atlas::math::Point interpolateOnSpline(float time);
 
-        atlas::math::Point evaluateSpline(float t) const;
+        float distanceAtTime(float tau);
+        float customDistance(float tau);
+        float parameterAtDistance(float distance);
+
+        atlas::math::Point evaluateSpline(float u) const;
+        atlas::math::Point evaluateSegment(std::size_t segment,
+            float t) const;
         void generateArcLengthTable();
-        int tableLookUp(float distance) const;
-        float chooseEpsilon() const;
+        void updateArcLengthTable(std::size_t first, std::size_t last);
+        void generateSpeedTable(std::vector<float> const& speeds);
+
+        int segmentResolution(std::size_t segment,
+            atlas::math::Matrix4 const& mvp) const;
+        void updateTessellation(atlas::math::Matrix4 const& mvp);
+        void uploadSegments(std::size_t first, std::size_t last);
+        void markSegmentsDirty(std::size_t point);
 
         atlas::math::Matrix4 mBasisMatrix;
         std::vector<atlas::math::Point> mControlPoints;
 
+        // Per-segment arc-length samples, followed by the running total
+        // over the whole track.
+        std::vector<float> mSegmentLengths;
         std::vector<float> mTable;
+        std::vector<float> mSpeedTable;
 
         atlas::math::Point mSplinePosition;
 
@@ -41,9 +96,33 @@ namespace lab3
         atlas::gl::Buffer mControlBuffer;
         atlas::gl::Buffer mSplineBuffer;
 
+        UniformTable<SplineUniform> mUniformTable;
+        CachedProgram mProgram;
+        std::uint64_t mShaderGeneration;
+
+        // Every segment owns a fixed slot of the vertex buffer, so a change
+        // in one segment's tessellation never moves any other segment.
+        std::vector<GLint> mSegmentFirst;
+        std::vector<GLsizei> mSegmentVertices;
+        std::vector<char> mDirtySegments;
+        std::vector<atlas::math::Point> mScratch;
+        std::size_t mBufferCapacity;
+        bool mControlBufferDirty;
+
         int mResolution;
-        int mTotalFrames;
-        int mCurrentFrame;
+        int mMaxSegmentResolution;
+        float mPixelTolerance;
+        int mViewportWidth;
+        int mViewportHeight;
+        int mSelectedPoint;
+
+        float mDuration;
+        int mProfile;
+
+        // Time only moves forward while playing, so both lookups resume
+        // from the entry they stopped at last frame.
+        std::size_t mTableCursor;
+        std::size_t mSpeedCursor;
 
         bool mShowControlPoints;
         bool mShowCage;
@@ -51,4 +130,4 @@ namespace lab3
         bool mShowSpline;
         bool mIsInterpolationDone;
     };
-}
\ No newline at end of file
+}
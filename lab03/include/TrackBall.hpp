@@ -5,8 +5,20 @@
 #include <atlas/gl/VertexArrayObject.hpp>
 #include <atlas/gl/Texture.hpp>
 
+#include "UniformTable.hpp"
+#include "CachedProgram.hpp"
+
+#include <cstdint>
+
 namespace lab3
 {
+    enum class BallUniform : std::size_t
+    {
+        Model = 0,
+        MaterialColour,
+        Count
+    };
+
     class TrackBall : public atlas::utils::Geometry
     {
     public:
@@ -23,6 +35,10 @@ namespace lab3
         atlas::gl::Buffer mIndexBuffer;
         atlas::gl::VertexArrayObject mVao;
 
+        UniformTable<BallUniform> mUniformTable;
+        CachedProgram mProgram;
+        std::uint64_t mShaderGeneration;
+
         GLsizei mIndexCount;
     };
 }
\ No newline at end of file
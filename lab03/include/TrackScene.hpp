@@ -2,6 +2,7 @@
 
 #include "TrackBall.hpp"
 #include "Spline.hpp"
+#include "FrameUniforms.hpp"
 
 #include <atlas/tools/ModellingScene.hpp>
 #include <atlas/utils/FPSCounter.hpp>
@@ -23,6 +24,7 @@ namespace lab3
 
         atlas::core::Time<float> mAnimTime;
         atlas::utils::FPSCounter mCounter;
+        FrameUniforms mFrameUniforms;
 
         TrackBall mBall;
         Spline mSpline;
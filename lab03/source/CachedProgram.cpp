@@ -0,0 +1,357 @@
+#include "CachedProgram.hpp"
+#include "Paths.hpp"
+
+#include <atlas/core/Log.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#endif
+
+namespace lab3
+{
+    namespace
+    {
+        struct ProgramBinaryHeader
+        {
+            std::uint32_t magic;
+            std::uint32_t version;
+            std::uint32_t format;
+            std::uint32_t length;
+            std::uint64_t sourceHash;
+            std::uint64_t driverHash;
+        };
+
+        // FNV-1a; only has to tell one set of sources from the next.
+        std::uint64_t hashBytes(const void* data, std::size_t size,
+            std::uint64_t hash = 0xcbf29ce484222325ull)
+        {
+            auto bytes = static_cast<const unsigned char*>(data);
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                hash ^= bytes[i];
+                hash *= 0x100000001b3ull;
+            }
+
+            return hash;
+        }
+
+        std::uint64_t hashString(std::string const& str,
+            std::uint64_t hash = 0xcbf29ce484222325ull)
+        {
+            return hashBytes(str.data(), str.size(), hash);
+        }
+
+        // A binary is only valid for the exact driver that produced it.
+        std::uint64_t driverHash()
+        {
+            std::uint64_t hash = 0xcbf29ce484222325ull;
+            for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+            {
+                auto str = reinterpret_cast<const char*>(glGetString(name));
+                hash = hashString(str ? str : "", hash);
+            }
+
+            return hash;
+        }
+
+        bool binariesSupported()
+        {
+            GLint formats = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            return formats > 0;
+        }
+
+        std::string cacheDirectory()
+        {
+            std::string directory = std::string(DataDirectory) +
+                "shadercache";
+#if defined(_WIN32)
+            _mkdir(directory.c_str());
+#else
+            mkdir(directory.c_str(), 0755);
+#endif
+            return directory + "/";
+        }
+    }
+
+    CachedProgram::CachedProgram() :
+        mSourceHash(0),
+        mProgram(0),
+        mBinaryProgram(0),
+        mLinks(0),
+        mCompiled(false)
+    { }
+
+    CachedProgram::~CachedProgram()
+    {
+        releaseBinary();
+    }
+
+    void CachedProgram::build(atlas::gl::Shader& shader,
+        std::vector<atlas::gl::ShaderUnit> const& units,
+        std::string const& includeDir)
+    {
+        mUnits = units;
+        mIncludeDir = includeDir;
+
+        // One file per program, named after its units, so a stale binary
+        // is overwritten rather than left behind.
+        std::uint64_t name = 0xcbf29ce484222325ull;
+        for (auto const& unit : mUnits)
+        {
+            name = hashString(unit.filename, name);
+        }
+
+        char fileName[32];
+        std::snprintf(fileName, sizeof(fileName), "%016llx.bin",
+            static_cast<unsigned long long>(name));
+        mCachePath = cacheDirectory() + fileName;
+
+        mSourceHash = hashSources();
+        if (loadBinary())
+        {
+            return;
+        }
+
+        compile(shader);
+        storeBinary();
+    }
+
+    void CachedProgram::reload(atlas::gl::Shader& shader)
+    {
+        // The watcher reports changes per directory, so most reloads are
+        // for some other program's sources.
+        std::uint64_t sourceHash = hashSources();
+        if (sourceHash == mSourceHash && mProgram != 0)
+        {
+            return;
+        }
+
+        mSourceHash = sourceHash;
+        compile(shader);
+        storeBinary();
+    }
+
+    bool CachedProgram::programValid() const
+    {
+        return mProgram != 0;
+    }
+
+    GLuint CachedProgram::getProgram() const
+    {
+        return mProgram;
+    }
+
+    std::uint64_t CachedProgram::links() const
+    {
+        return mLinks;
+    }
+
+    void CachedProgram::enableProgram() const
+    {
+        glUseProgram(mProgram);
+    }
+
+    void CachedProgram::disableProgram() const
+    {
+        glUseProgram(0);
+    }
+
+    void CachedProgram::compile(atlas::gl::Shader& shader)
+    {
+        if (mCompiled)
+        {
+            shader.hotReloadShaders();
+        }
+        else
+        {
+            shader.compileShaders();
+            shader.linkShaders();
+            mCompiled = true;
+        }
+
+        releaseBinary();
+        mProgram = shader.shaderProgramValid() ? shader.getShaderProgram() : 0;
+        ++mLinks;
+    }
+
+    bool CachedProgram::loadBinary()
+    {
+        if (!binariesSupported())
+        {
+            return false;
+        }
+
+        std::FILE* file = std::fopen(mCachePath.c_str(), "rb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        ProgramBinaryHeader header;
+        std::vector<char> binary;
+        bool read = std::fread(&header, sizeof(header), 1, file) == 1 &&
+            header.magic == Magic && header.version == Version &&
+            header.sourceHash == mSourceHash &&
+            header.driverHash == driverHash();
+        if (read)
+        {
+            // Matching hashes say the file is ours, not that it is whole,
+            // so a damaged length must agree with the file before it
+            // sizes anything.
+            long fileSize = -1;
+            if (std::fseek(file, 0, SEEK_END) == 0)
+            {
+                fileSize = std::ftell(file);
+            }
+            read = fileSize >= 0 &&
+                static_cast<std::uint64_t>(fileSize) ==
+                sizeof(header) + static_cast<std::uint64_t>(header.length) &&
+                std::fseek(file, sizeof(header), SEEK_SET) == 0;
+        }
+        if (read)
+        {
+            binary.resize(header.length);
+            read = std::fread(binary.data(), 1, binary.size(), file) ==
+                binary.size();
+        }
+        std::fclose(file);
+
+        if (!read)
+        {
+            return false;
+        }
+
+        GLuint program = glCreateProgram();
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+            GL_TRUE);
+        glProgramBinary(program, header.format, binary.data(),
+            static_cast<GLsizei>(binary.size()));
+
+        // Drivers may reject their own binaries after an update that kept
+        // the version string, so the link status is the final word.
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (linked != GL_TRUE)
+        {
+            glDeleteProgram(program);
+            return false;
+        }
+
+        mBinaryProgram = program;
+        mProgram = program;
+        ++mLinks;
+        return true;
+    }
+
+    void CachedProgram::storeBinary() const
+    {
+        if (mProgram == 0 || !binariesSupported())
+        {
+            return;
+        }
+
+        // Atlas links without the retrievable hint, which drivers treat as
+        // advisory; an empty binary just means there is nothing to cache.
+        GLint length = 0;
+        glGetProgramiv(mProgram, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+        {
+            return;
+        }
+
+        std::vector<char> binary(static_cast<std::size_t>(length));
+        GLenum format = 0;
+        glGetProgramBinary(mProgram, length, &length, &format, binary.data());
+
+        ProgramBinaryHeader header{};
+        header.magic = Magic;
+        header.version = Version;
+        header.format = format;
+        header.length = static_cast<std::uint32_t>(length);
+        header.sourceHash = mSourceHash;
+        header.driverHash = driverHash();
+
+        std::string tmpPath = mCachePath + ".tmp";
+        std::FILE* file = std::fopen(tmpPath.c_str(), "wb");
+        if (file == nullptr)
+        {
+            WARN_LOG("Could not write program cache " + mCachePath);
+            return;
+        }
+
+        bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+            std::fwrite(binary.data(), 1, header.length, file) ==
+            header.length;
+        written = (std::fclose(file) == 0) && written;
+
+#if defined(_WIN32)
+        std::remove(mCachePath.c_str());
+#endif
+
+        if (!written || std::rename(tmpPath.c_str(), mCachePath.c_str()) != 0)
+        {
+            std::remove(tmpPath.c_str());
+            WARN_LOG("Could not write program cache " + mCachePath);
+        }
+    }
+
+    void CachedProgram::releaseBinary()
+    {
+        if (mBinaryProgram != 0)
+        {
+            glDeleteProgram(mBinaryProgram);
+            mBinaryProgram = 0;
+        }
+    }
+
+    std::uint64_t CachedProgram::hashSources() const
+    {
+        std::uint64_t hash = 0xcbf29ce484222325ull;
+        for (auto const& unit : mUnits)
+        {
+            hash = hashBytes(&unit.type, sizeof(unit.type), hash);
+            hash = hashString(expandSource(unit.filename, 0), hash);
+        }
+
+        return hash;
+    }
+
+    std::string CachedProgram::expandSource(std::string const& file,
+        int depth) const
+    {
+        std::ifstream stream(file);
+        if (!stream || depth > 16)
+        {
+            return {};
+        }
+
+        // Includes are hashed in place so editing LayoutLocations.glsl
+        // invalidates every program that uses it.
+        std::ostringstream out;
+        std::string line;
+        while (std::getline(stream, line))
+        {
+            auto pos = line.find("#include");
+            auto open = line.find('"');
+            auto close = line.rfind('"');
+            if (pos != std::string::npos && open != std::string::npos &&
+                close > open)
+            {
+                out << expandSource(mIncludeDir +
+                    line.substr(open + 1, close - open - 1), depth + 1);
+            }
+            else
+            {
+                out << line << '\n';
+            }
+        }
+
+        return out.str();
+    }
+}
@@ -0,0 +1,271 @@
+#include "MeshBlob.hpp"
+
+#include <atlas/utils/Mesh.hpp>
+#include <atlas/core/Log.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace lab3
+{
+    namespace
+    {
+        bool modificationTime(std::string const& path, long long& time)
+        {
+            struct stat info;
+            if (stat(path.c_str(), &info) != 0)
+            {
+                return false;
+            }
+
+            time = static_cast<long long>(info.st_mtime);
+            return true;
+        }
+    }
+
+    MeshBlob::MeshBlob() :
+        mMapping(nullptr),
+        mMappingSize(0)
+    { }
+
+    MeshBlob::~MeshBlob()
+    {
+        release();
+    }
+
+    bool MeshBlob::load(std::string const& objPath)
+    {
+        release();
+
+        std::string blobPath = objPath + ".bin";
+
+        long long objTime = 0;
+        long long blobTime = 0;
+        bool haveBlob = modificationTime(blobPath, blobTime);
+        bool haveObj = modificationTime(objPath, objTime);
+
+        if (haveBlob && (!haveObj || blobTime >= objTime) && map(blobPath))
+        {
+            return true;
+        }
+
+        return convert(objPath, blobPath);
+    }
+
+    void MeshBlob::release()
+    {
+#if !defined(_WIN32)
+        if (mMapping != nullptr)
+        {
+            munmap(mMapping, mMappingSize);
+        }
+#endif
+        mMapping = nullptr;
+        mMappingSize = 0;
+
+        std::vector<char>().swap(mOwned);
+    }
+
+    float const* MeshBlob::vertices() const
+    {
+        return header() ?
+            reinterpret_cast<float const*>(header() + 1) : nullptr;
+    }
+
+    GLuint const* MeshBlob::indices() const
+    {
+        return header() ? reinterpret_cast<GLuint const*>(vertices() +
+            header()->vertexCount * header()->floatsPerVertex) : nullptr;
+    }
+
+    std::size_t MeshBlob::vertexCount() const
+    {
+        return header() ? header()->vertexCount : 0;
+    }
+
+    std::size_t MeshBlob::indexCount() const
+    {
+        return header() ? header()->indexCount : 0;
+    }
+
+    std::size_t MeshBlob::vertexBytes() const
+    {
+        return header() ?
+            sizeof(float) * header()->vertexCount * header()->floatsPerVertex :
+            0;
+    }
+
+    std::size_t MeshBlob::indexBytes() const
+    {
+        return sizeof(GLuint) * indexCount();
+    }
+
+    MeshBlobHeader const* MeshBlob::header() const
+    {
+        if (mMapping != nullptr)
+        {
+            return static_cast<MeshBlobHeader const*>(mMapping);
+        }
+
+        if (!mOwned.empty())
+        {
+            return reinterpret_cast<MeshBlobHeader const*>(mOwned.data());
+        }
+
+        return nullptr;
+    }
+
+    bool MeshBlob::map(std::string const& blobPath)
+    {
+#if !defined(_WIN32)
+        int fd = open(blobPath.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 ||
+            static_cast<std::size_t>(info.st_size) < sizeof(MeshBlobHeader))
+        {
+            close(fd);
+            return false;
+        }
+
+        std::size_t size = static_cast<std::size_t>(info.st_size);
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (mapping == MAP_FAILED)
+        {
+            return false;
+        }
+
+        mMapping = mapping;
+        mMappingSize = size;
+#else
+        std::FILE* file = std::fopen(blobPath.c_str(), "rb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        std::fseek(file, 0, SEEK_END);
+        long fileSize = std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+
+        if (fileSize < static_cast<long>(sizeof(MeshBlobHeader)))
+        {
+            std::fclose(file);
+            return false;
+        }
+
+        mOwned.resize(static_cast<std::size_t>(fileSize));
+        std::size_t read = std::fread(mOwned.data(), 1, mOwned.size(), file);
+        std::fclose(file);
+
+        if (read != mOwned.size())
+        {
+            release();
+            return false;
+        }
+
+        std::size_t size = mOwned.size();
+#endif
+
+        // Reject blobs from another version or that were cut short.
+        auto h = header();
+        std::size_t expected = sizeof(MeshBlobHeader) +
+            sizeof(float) * std::size_t(h->vertexCount) * h->floatsPerVertex +
+            sizeof(GLuint) * std::size_t(h->indexCount);
+        if (h->magic != Magic || h->version != Version ||
+            h->floatsPerVertex != FloatsPerVertex || size < expected)
+        {
+            release();
+            return false;
+        }
+
+        return true;
+    }
+
+    bool MeshBlob::convert(std::string const& objPath,
+        std::string const& blobPath)
+    {
+        using atlas::utils::Mesh;
+
+        Mesh mesh;
+        if (!Mesh::fromFile(objPath, mesh))
+        {
+            ERROR_LOG("Could not load mesh " + objPath);
+            return false;
+        }
+
+        MeshBlobHeader h{};
+        h.magic = Magic;
+        h.version = Version;
+        h.vertexCount = static_cast<std::uint32_t>(mesh.vertices().size());
+        h.indexCount = static_cast<std::uint32_t>(mesh.indices().size());
+        h.floatsPerVertex = FloatsPerVertex;
+
+        std::size_t vertexBytes =
+            sizeof(float) * std::size_t(h.vertexCount) * FloatsPerVertex;
+        std::size_t indexBytes = sizeof(GLuint) * std::size_t(h.indexCount);
+
+        mOwned.resize(sizeof(MeshBlobHeader) + vertexBytes + indexBytes);
+        std::memcpy(mOwned.data(), &h, sizeof(MeshBlobHeader));
+
+        float* out = reinterpret_cast<float*>(
+            mOwned.data() + sizeof(MeshBlobHeader));
+        for (std::size_t i = 0; i < h.vertexCount; ++i)
+        {
+            auto const& v = mesh.vertices()[i];
+            auto const& n = mesh.normals()[i];
+            auto const& t = mesh.texCoords()[i];
+
+            *out++ = v.x;
+            *out++ = v.y;
+            *out++ = v.z;
+            *out++ = n.x;
+            *out++ = n.y;
+            *out++ = n.z;
+            *out++ = t.x;
+            *out++ = t.y;
+        }
+
+        std::memcpy(out, mesh.indices().data(), indexBytes);
+
+        // Write to a temporary and rename so a concurrent reader never maps
+        // a half-written blob. Failing to write only costs the next startup.
+        std::string tmpPath = blobPath + ".tmp";
+        std::FILE* file = std::fopen(tmpPath.c_str(), "wb");
+        if (file == nullptr)
+        {
+            WARN_LOG("Could not write mesh cache " + blobPath);
+            return true;
+        }
+
+        bool written =
+            std::fwrite(mOwned.data(), 1, mOwned.size(), file) == mOwned.size();
+        written = (std::fclose(file) == 0) && written;
+
+#if defined(_WIN32)
+        // rename() does not replace an existing file on Windows.
+        std::remove(blobPath.c_str());
+#endif
+
+        if (!written || std::rename(tmpPath.c_str(), blobPath.c_str()) != 0)
+        {
+            std::remove(tmpPath.c_str());
+            WARN_LOG("Could not write mesh cache " + blobPath);
+        }
+
+        return true;
+    }
+}
@@ -1,6 +1,9 @@
 #include "Spline.hpp"
 
+#include "FrameUniforms.hpp"
+#include "CachedProgram.hpp"
 #include "Paths.hpp"
+#include "ShaderWatcher.hpp"
 #include "LayoutLocations.glsl"
 
 #include <atlas/utils/Mesh.hpp>
@@ -9,14 +12,29 @@
 #include <atlas/utils/GUI.hpp>
 #include <atlas/core/Macros.hpp>
 
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+
 namespace lab3
 {
-    Spline::Spline(int totalFrames) :
+    Spline::Spline(float duration) :
         mControlBuffer(GL_ARRAY_BUFFER),
         mSplineBuffer(GL_ARRAY_BUFFER),
-        mResolution(500),
-        mTotalFrames(totalFrames),
-        mCurrentFrame(0),
+        mUniformTable({ "model", "colour" }),
+        mShaderGeneration(0),
+        mBufferCapacity(0),
+        mControlBufferDirty(true),
+        mResolution(100),
+        mMaxSegmentResolution(128),
+        mPixelTolerance(0.5f),
+        mViewportWidth(1280),
+        mViewportHeight(720),
+        mSelectedPoint(0),
+        mDuration(duration),
+        mProfile(static_cast<int>(SpeedProfile::Constant)),
+        mTableCursor(0),
+        mSpeedCursor(0),
         mShowSplinePoints(false),
         mShowControlPoints(true),
         mShowCage(false),
@@ -41,21 +59,19 @@ namespace lab3
             { 20, 8.2f, 4.4f }
         };
 
-        std::vector<Point> splinePoints;
-
-        float scale = 1.0f / mResolution;
-        for (int res = 0; res < mResolution; ++res)
-        {
-            auto pt = evaluateSpline(scale * res);
-            splinePoints.push_back(pt);
-        }
-
         generateArcLengthTable();
+        generateSpeedTable({ 0.25f, 1.0f, 1.75f, 1.0f, 0.25f });
+
+        std::size_t segments = segmentCount();
+        mSegmentFirst.resize(segments);
+        mSegmentVertices.assign(segments, 0);
+        mDirtySegments.assign(segments, 1);
 
         mControlVao.bindVertexArray();
         mControlBuffer.bindBuffer();
         mControlBuffer.bufferData(gl::size<Point>(mControlPoints.size()),
-            mControlPoints.data(), GL_STATIC_DRAW);
+            mControlPoints.data(), GL_DYNAMIC_DRAW);
+        mControlBufferDirty = false;
         mControlBuffer.vertexAttribPointer(VERTICES_LAYOUT_LOCATION, 3, GL_FLOAT,
             GL_FALSE, 0, gl::bufferOffset<float>(0));
         mControlVao.enableVertexAttribArray(VERTICES_LAYOUT_LOCATION);
@@ -65,8 +81,6 @@ namespace lab3
 
         mSplineVao.bindVertexArray();
         mSplineBuffer.bindBuffer();
-        mSplineBuffer.bufferData(gl::size<Point>(splinePoints.size()),
-            splinePoints.data(), GL_STATIC_DRAW);
         mSplineBuffer.vertexAttribPointer(VERTICES_LAYOUT_LOCATION, 3, GL_FLOAT,
             GL_FALSE, 0, gl::bufferOffset<float>(0));
         mSplineVao.enableVertexAttribArray(VERTICES_LAYOUT_LOCATION);
@@ -80,31 +94,31 @@ namespace lab3
         };
 
         mShaders.emplace_back(shaders);
+
+#if defined(SHADER_HOT_RELOAD)
+        for (auto const& unit : shaders)
+        {
+            ShaderWatcher::getInstance().watch(unit.filename);
+        }
+        mShaderGeneration = ShaderWatcher::getInstance().generation();
+#endif
+
         mShaders[0].setShaderIncludeDir(ShaderDirectory);
-        mShaders[0].compileShaders();
-        mShaders[0].linkShaders();
+        mProgram.build(mShaders[0], shaders, ShaderDirectory);
 
-        auto var = mShaders[0].getUniformVariable("model");
-        mUniforms.insert(UniformKey("model", var));
-        var = mShaders[0].getUniformVariable("projection");
-        mUniforms.insert(UniformKey("projection", var));
-        var = mShaders[0].getUniformVariable("view");
-        mUniforms.insert(UniformKey("view", var));
-        var = mShaders[0].getUniformVariable("colour");
-        mUniforms.insert(UniformKey("colour", var));
+        GLuint program = mProgram.getProgram();
+        mUniformTable.resolve(mProgram);
+        FrameUniforms::bindProgram(program);
 
-        mSplinePosition = interpolateOnSpline();
+        mSplinePosition = interpolateOnSpline(0.0f);
 
-        mShaders[0].disableShaders();
+        mProgram.disableProgram();
     }
 
     void Spline::updateGeometry(atlas::core::Time<> const& t)
     {
-        UNUSED(t);
-
-        mSplinePosition = interpolateOnSpline();
-        mCurrentFrame++;
-        if (mCurrentFrame == mTotalFrames)
+        mSplinePosition = interpolateOnSpline(t.currentTime);
+        if (t.currentTime >= mDuration)
         {
             mIsInterpolationDone = true;
             return;
@@ -115,23 +129,48 @@ namespace lab3
         atlas::math::Matrix4 const& view)
     {
         namespace math = atlas::math;
+        namespace gl = atlas::gl;
+
+#if defined(SHADER_HOT_RELOAD)
+        auto generation = ShaderWatcher::getInstance().generation();
+        if (generation != mShaderGeneration)
+        {
+            mShaderGeneration = generation;
+            mProgram.reload(mShaders[0]);
+        }
+#endif
 
-        mShaders[0].hotReloadShaders();
-        if (!mShaders[0].shaderProgramValid())
+        if (!mProgram.programValid())
         {
             return;
         }
 
-        mShaders[0].enableShaders();
+        GLuint program = mProgram.getProgram();
+        if (mUniformTable.resolve(mProgram))
+        {
+            FrameUniforms::bindProgram(program);
+        }
+
+        updateTessellation(projection * view * mModel);
+
+        if (mControlBufferDirty)
+        {
+            mControlBuffer.bindBuffer();
+            mControlBuffer.bufferData(
+                gl::size<math::Point>(mControlPoints.size()),
+                mControlPoints.data(), GL_DYNAMIC_DRAW);
+            mControlBuffer.unBindBuffer();
+            mControlBufferDirty = false;
+        }
+
+        mProgram.enableProgram();
         mControlVao.bindVertexArray();
 
-        glUniformMatrix4fv(mUniforms["projection"], 1, GL_FALSE,
-            &projection[0][0]);
-        glUniformMatrix4fv(mUniforms["view"], 1, GL_FALSE, &view[0][0]);
-        glUniformMatrix4fv(mUniforms["model"], 1, GL_FALSE, &mModel[0][0]);
+        glUniformMatrix4fv(mUniformTable.get<SplineUniform::Model>(),
+            1, GL_FALSE, &mModel[0][0]);
 
         // Render the control points first.
-        glUniform3f(mUniforms["colour"], 1, 0, 0);
+        glUniform3f(mUniformTable.get<SplineUniform::Colour>(), 1, 0, 0);
 
         if (mShowControlPoints)
         {
@@ -150,21 +189,24 @@ namespace lab3
         mSplineVao.bindVertexArray();
 
         // Now draw the splines.
-        glUniform3f(mUniforms["colour"], 0, 1, 0);
+        glUniform3f(mUniformTable.get<SplineUniform::Colour>(), 0, 1, 0);
         
+        GLsizei segments = GLsizei(mSegmentFirst.size());
         if (mShowSpline)
         {
-            glDrawArrays(GL_LINE_STRIP, 0, mResolution);
+            glMultiDrawArrays(GL_LINE_STRIP, mSegmentFirst.data(),
+                mSegmentVertices.data(), segments);
         }
         if (mShowSplinePoints)
         {
             glPointSize(8.0f);
-            glDrawArrays(GL_POINTS, 0, mResolution);
+            glMultiDrawArrays(GL_POINTS, mSegmentFirst.data(),
+                mSegmentVertices.data(), segments);
             glPointSize(1.0f);
         }
 
         mSplineVao.unBindVertexArray();
-        mShaders[0].disableShaders();
+        mProgram.disableProgram();
     }
 
     void Spline::drawGui()
@@ -176,14 +218,40 @@ namespace lab3
         ImGui::Checkbox("Show Cage", &mShowCage);
         ImGui::Checkbox("Show Spline", &mShowSpline);
         ImGui::Checkbox("Show Spline Points", &mShowSplinePoints);
+
+        std::vector<const char*> profileNames = { "Constant Speed",
+        "Ease In/Out", "Ease In", "Ease Out", "Custom Speed Curve" };
+        ImGui::Combo("Speed Profile", &mProfile, profileNames.data(),
+            ((int)profileNames.size()));
+
+        ImGui::SliderFloat("Pixel Tolerance", &mPixelTolerance, 0.1f, 8.0f);
+        ImGui::Text("Segments: %d", (int)segmentCount());
+
+        int lastPoint = (int)mControlPoints.size() - 1;
+        ImGui::SliderInt("Control Point", &mSelectedPoint, 0, lastPoint);
+        mSelectedPoint = glm::clamp(mSelectedPoint, 0, lastPoint);
+
+        auto point = mControlPoints[mSelectedPoint];
+        if (ImGui::DragFloat3("Position", &point[0], 0.1f))
+        {
+            setControlPoint(mSelectedPoint, point);
+        }
+
+        if (ImGui::Button("Add Segment"))
+        {
+            auto end = mControlPoints[lastPoint];
+            auto dir = end - mControlPoints[lastPoint - 1];
+            appendSegment(end + dir, end + 2.0f * dir, end + 3.0f * dir);
+        }
         ImGui::End();
     }
 
     void Spline::resetGeometry()
     {
-        mCurrentFrame = 0;
+        mTableCursor = 0;
+        mSpeedCursor = 0;
         mIsInterpolationDone = false;
-        mSplinePosition = interpolateOnSpline();
+        mSplinePosition = interpolateOnSpline(0.0f);
     }
 
     atlas::math::Point Spline::getPosition() const
@@ -196,30 +264,162 @@ namespace lab3
         return mIsInterpolationDone;
     }
 
-    atlas::math::Point Spline::interpolateOnSpline() const
+    void Spline::setDuration(float duration)
+    {
+        mDuration = duration;
+    }
+
+    void Spline::setSpeedProfile(SpeedProfile profile)
     {
-        float totalDistance = mTable[mTable.size() - 1];
-        float step = totalDistance / mTotalFrames;
-        float currDistance = step * mCurrentFrame;
+        mProfile = static_cast<int>(profile);
+    }
 
-        int index = tableLookUp(currDistance);
-        float t = (1.0f / mResolution) * (index % mResolution);
-        return evaluateSpline(t);
+    void Spline::setSpeedCurve(std::vector<float> const& speeds)
+    {
+        generateSpeedTable(speeds);
+        mSpeedCursor = 0;
     }
 
-    atlas::math::Point Spline::evaluateSpline(float t) const
+    void Spline::setViewport(int width, int height)
+    {
+        mViewportWidth = width;
+        mViewportHeight = height;
+    }
+
+    void Spline::setControlPoint(std::size_t index,
+        atlas::math::Point const& point)
+    {
+        mControlPoints[index] = point;
+        markSegmentsDirty(index);
+    }
+
+    void Spline::appendSegment(atlas::math::Point const& c1,
+        atlas::math::Point const& c2, atlas::math::Point const& end)
+    {
+        mControlPoints.push_back(c1);
+        mControlPoints.push_back(c2);
+        mControlPoints.push_back(end);
+
+        std::size_t segments = segmentCount();
+        mSegmentFirst.resize(segments);
+        mSegmentVertices.resize(segments, 0);
+        mDirtySegments.resize(segments, 1);
+        mSegmentLengths.resize(segments * mResolution);
+        mTable.resize(segments * mResolution + 1);
+
+        updateArcLengthTable(segments - 1, segments);
+        mControlBufferDirty = true;
+    }
+
+    std::size_t Spline::segmentCount() const
+    {
+        return (mControlPoints.size() - 1) / 3;
+    }
+
+    atlas::math::Point Spline::interpolateOnSpline(float time)
+    {
+        float tau = glm::clamp(time / mDuration, 0.0f, 1.0f);
+        float distance = distanceAtTime(tau) * mTable.back();
+        return evaluateSpline(parameterAtDistance(distance));
+    }
+
+    // Maps normalized time onto the normalized distance travelled along the
+    // track, so every profile starts at 0 and ends at 1.
+    float Spline::distanceAtTime(float tau)
+    {
+        const float pi = glm::pi<float>();
+
+        switch (static_cast<SpeedProfile>(mProfile))
+        {
+        case SpeedProfile::EaseInOut:
+            return 0.5f * (1.0f - glm::cos(pi * tau));
+
+        case SpeedProfile::EaseIn:
+            return 1.0f - glm::cos(0.5f * pi * tau);
+
+        case SpeedProfile::EaseOut:
+            return glm::sin(0.5f * pi * tau);
+
+        case SpeedProfile::Custom:
+            return customDistance(tau);
+
+        case SpeedProfile::Constant:
+        default:
+            return tau;
+        }
+    }
+
+    float Spline::customDistance(float tau)
+    {
+        float scaled = tau * (mSpeedTable.size() - 1);
+
+        if (scaled < static_cast<float>(mSpeedCursor))
+        {
+            mSpeedCursor = 0;
+        }
+
+        while (mSpeedCursor + 2 < mSpeedTable.size() &&
+            scaled >= static_cast<float>(mSpeedCursor + 1))
+        {
+            ++mSpeedCursor;
+        }
+
+        float frac = scaled - static_cast<float>(mSpeedCursor);
+        return glm::mix(mSpeedTable[mSpeedCursor],
+            mSpeedTable[mSpeedCursor + 1], frac);
+    }
+
+    // Returns the spline parameter at which the arc length equals distance.
+    // Walks forward from the previous lookup, so a monotonic sequence of
+    // queries costs amortized O(1) each.
+    float Spline::parameterAtDistance(float distance)
+    {
+        if (distance < mTable[mTableCursor])
+        {
+            mTableCursor = 0;
+        }
+
+        while (mTableCursor + 2 < mTable.size() &&
+            distance >= mTable[mTableCursor + 1])
+        {
+            ++mTableCursor;
+        }
+
+        float segment = mTable[mTableCursor + 1] - mTable[mTableCursor];
+        float frac = 0.0f;
+        if (segment > 0.0f)
+        {
+            frac = glm::clamp((distance - mTable[mTableCursor]) / segment,
+                0.0f, 1.0f);
+        }
+
+        return (mTableCursor + frac) / mResolution;
+    }
+
+    // u runs from 0 to the number of segments; its integer part picks the
+    // segment and the fractional part is the local Bezier parameter.
+    atlas::math::Point Spline::evaluateSpline(float u) const
+    {
+        std::size_t last = segmentCount() - 1;
+        float clamped = glm::max(u, 0.0f);
+        std::size_t segment = std::min(static_cast<std::size_t>(clamped),
+            last);
+        return evaluateSegment(segment, clamped - segment);
+    }
+
+    atlas::math::Point Spline::evaluateSegment(std::size_t segment,
+        float t) const
     {
-        
         using atlas::math::Vector4;
         using atlas::math::Point;
 
-        // TODO by students.
         Vector4 tVec = Vector4(1.0, t, t*t, t*t*t);
-        
+        auto p = mControlPoints.data() + 3 * segment;
+
         //find x-, y-,  & z-coords for control points
-        Vector4 x = {mControlPoints[0].x, mControlPoints[1].x, mControlPoints[2].x, mControlPoints[3].x};
-        Vector4 y = {mControlPoints[0].y, mControlPoints[1].y, mControlPoints[2].y, mControlPoints[3].y};
-        Vector4 z = {mControlPoints[0].z, mControlPoints[1].z, mControlPoints[2].z, mControlPoints[3].z};
+        Vector4 x = {p[0].x, p[1].x, p[2].x, p[3].x};
+        Vector4 y = {p[0].y, p[1].y, p[2].y, p[3].y};
+        Vector4 z = {p[0].z, p[1].z, p[2].z, p[3].z};
         
         //evaluate first half of point eqn: point(t) = [x,y,z]*B
         auto xt = x * mBasisMatrix;
@@ -235,60 +435,200 @@ namespace lab3
     }
 
     void Spline::generateArcLengthTable()
+    {
+        std::size_t segments = segmentCount();
+        mSegmentLengths.assign(segments * mResolution, 0.0f);
+        mTable.assign(segments * mResolution + 1, 0.0f);
+
+        updateArcLengthTable(0, segments);
+    }
+
+    // Re-samples the segments in [first, last) and then only re-accumulates
+    // the running total from the first changed entry onwards.
+    void Spline::updateArcLengthTable(std::size_t first, std::size_t last)
     {
         using atlas::math::Point;
 
-        if (!mTable.empty())
+        float scale = 1.0f / mResolution;
+
+        for (std::size_t s = first; s < last; ++s)
         {
-            mTable.clear();
+            float* lengths = mSegmentLengths.data() + s * mResolution;
+            Point p0 = evaluateSegment(s, 0.0f);
+            for (int i = 1; i < mResolution + 1; ++i)
+            {
+                Point p1 = evaluateSegment(s, i * scale);
+                lengths[i - 1] = glm::distance(p0, p1);
+                p0 = p1;
+            }
         }
 
-        // TODO by students.
-        float scale = 1.0f/mResolution;
-        
-        mTable.push_back(0.0f);
-        
-        for (int i = 1; i < mResolution + 1; ++i)
+        for (std::size_t i = first * mResolution; i < mSegmentLengths.size();
+            ++i)
+        {
+            mTable[i + 1] = mTable[i] + mSegmentLengths[i];
+        }
+
+        mTableCursor = 0;
+    }
+
+    // Integrates the piecewise-linear speed curve with the trapezoid rule
+    // into a normalized distance-over-time table.
+    void Spline::generateSpeedTable(std::vector<float> const& speeds)
+    {
+        mSpeedTable.clear();
+        mSpeedTable.push_back(0.0f);
+
+        if (speeds.size() < 2)
+        {
+            mSpeedTable.push_back(1.0f);
+            return;
+        }
+
+        for (std::size_t i = 1; i < speeds.size(); ++i)
+        {
+            float v0 = glm::max(speeds[i - 1], 0.0f);
+            float v1 = glm::max(speeds[i], 0.0f);
+            mSpeedTable.push_back(mSpeedTable[i - 1] + 0.5f * (v0 + v1));
+        }
+
+        float total = mSpeedTable.back();
+        for (auto& d : mSpeedTable)
+        {
+            d = (total > 0.0f) ? d / total : 0.0f;
+        }
+        mSpeedTable.back() = 1.0f;
+    }
+
+    // The deviation of a cubic from its chord polyline with n uniform steps
+    // is bounded by max|B''| / (8 n^2), and max|B''| is 6 times the largest
+    // second difference of the control points. Measuring those differences
+    // in pixels gives the step count that keeps the error under tolerance.
+    int Spline::segmentResolution(std::size_t segment,
+        atlas::math::Matrix4 const& mvp) const
+    {
+        using atlas::math::Vector4;
+
+        glm::vec2 screen[4];
+        for (int i = 0; i < 4; ++i)
         {
-            //find points on spline at [i-1] and [i]
-            Point p0 = evaluateSpline((i-1)*scale);
-            Point p1 = evaluateSpline(i*scale);
-            
-            //push next distance (between p0 & p1) into mTable
-            mTable.push_back(mTable[i-1] + glm::distance(p0, p1));
+            Vector4 clip = mvp * Vector4(mControlPoints[3 * segment + i], 1.0f);
+            if (clip.w <= 1.0e-4f)
+            {
+                return mMaxSegmentResolution;
+            }
+
+            screen[i] = glm::vec2(
+                0.5f * mViewportWidth * clip.x / clip.w,
+                0.5f * mViewportHeight * clip.y / clip.w);
         }
+
+        float d0 = glm::length(screen[0] - 2.0f * screen[1] + screen[2]);
+        float d1 = glm::length(screen[1] - 2.0f * screen[2] + screen[3]);
+        float bound = 6.0f * glm::max(d0, d1);
+
+        int steps = static_cast<int>(
+            glm::ceil(glm::sqrt(bound / (8.0f * mPixelTolerance))));
+        return glm::clamp(steps, 1, mMaxSegmentResolution);
     }
 
-    //returns the index of the table at which the spline's arclength is equal (or close enough) to distance
-    int Spline::tableLookUp(float distance) const
+    void Spline::updateTessellation(atlas::math::Matrix4 const& mvp)
     {
-        float epsilon = chooseEpsilon();
-        for (std::size_t i = 0; i < mTable.size(); ++i)
+        namespace gl = atlas::gl;
+        using atlas::math::Point;
+
+        std::size_t segments = segmentCount();
+        std::size_t slot = mMaxSegmentResolution + 1;
+
+        if (segments * slot > mBufferCapacity)
+        {
+            // Grow geometrically so appending segments one at a time does
+            // not reallocate every frame.
+            mBufferCapacity = std::max(segments * slot, 2 * mBufferCapacity);
+            mSplineBuffer.bindBuffer();
+            mSplineBuffer.bufferData(gl::size<Point>(mBufferCapacity),
+                nullptr, GL_DYNAMIC_DRAW);
+            mSplineBuffer.unBindBuffer();
+
+            std::fill(mDirtySegments.begin(), mDirtySegments.end(), 1);
+        }
+
+        for (std::size_t s = 0; s < segments; ++s)
         {
-            if (glm::abs(mTable[i] - distance) < epsilon)
+            mSegmentFirst[s] = static_cast<GLint>(s * slot);
+
+            GLsizei vertices = segmentResolution(s, mvp) + 1;
+            if (vertices != mSegmentVertices[s])
             {
-                return static_cast<int>(i);
+                mSegmentVertices[s] = vertices;
+                mDirtySegments[s] = 1;
             }
         }
 
-        return -1;
+        // Upload each run of consecutive dirty segments with one call.
+        std::size_t s = 0;
+        while (s < segments)
+        {
+            if (!mDirtySegments[s])
+            {
+                ++s;
+                continue;
+            }
+
+            std::size_t first = s;
+            while (s < segments && mDirtySegments[s])
+            {
+                mDirtySegments[s] = 0;
+                ++s;
+            }
+
+            uploadSegments(first, s);
+        }
     }
 
-    float Spline::chooseEpsilon() const
+    void Spline::uploadSegments(std::size_t first, std::size_t last)
     {
-        float epsilon = 0.0f;
-        float diff;
+        namespace gl = atlas::gl;
+        using atlas::math::Point;
+
+        std::size_t slot = mMaxSegmentResolution + 1;
+        mScratch.resize((last - first) * slot);
 
-        for (std::size_t i = 0; i < mTable.size() - 1; ++i)
+        for (std::size_t s = first; s < last; ++s)
         {
-            diff = glm::abs(mTable[i] - mTable[i + 1]);
-                if (diff > epsilon)
-                {
-                    epsilon = diff;
-                }
+            Point* out = mScratch.data() + (s - first) * slot;
+            GLsizei steps = mSegmentVertices[s] - 1;
+            float scale = 1.0f / steps;
+            for (GLsizei i = 0; i <= steps; ++i)
+            {
+                out[i] = evaluateSegment(s, i * scale);
+            }
         }
 
-        return epsilon;
+        // Only the used prefix of the last slot has to go over the bus.
+        std::size_t count = (last - 1 - first) * slot +
+            mSegmentVertices[last - 1];
+
+        mSplineBuffer.bindBuffer();
+        mSplineBuffer.bufferSubData(gl::size<Point>(first * slot),
+            gl::size<Point>(count), mScratch.data());
+        mSplineBuffer.unBindBuffer();
     }
 
+    // Segment s uses control points 3s to 3s + 3, so an end point is shared
+    // by two segments while the inner handles belong to one.
+    void Spline::markSegmentsDirty(std::size_t point)
+    {
+        std::size_t segments = segmentCount();
+        std::size_t first = (point == 0) ? 0 : (point - 1) / 3;
+        std::size_t last = std::min(point / 3 + 1, segments);
+
+        for (std::size_t s = first; s < last; ++s)
+        {
+            mDirtySegments[s] = 1;
+        }
+
+        updateArcLengthTable(first, last);
+        mControlBufferDirty = true;
+    }
 }
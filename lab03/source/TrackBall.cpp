@@ -1,47 +1,37 @@
 #include "TrackBall.hpp"
+#include "MeshBlob.hpp"
+#include "FrameUniforms.hpp"
 #include "Paths.hpp"
+#include "ShaderWatcher.hpp"
 #include "LayoutLocations.glsl"
 
-#include <atlas/utils/Mesh.hpp>
 #include <atlas/core/STB.hpp>
 #include <atlas/core/Float.hpp>
 #include <atlas/utils/GUI.hpp>
+#include <atlas/core/Macros.hpp>
 
 namespace lab3
 {
     TrackBall::TrackBall() :
         mVertexBuffer(GL_ARRAY_BUFFER),
-        mIndexBuffer(GL_ELEMENT_ARRAY_BUFFER)
+        mIndexBuffer(GL_ELEMENT_ARRAY_BUFFER),
+        mUniformTable({ "model", "materialColour" }),
+        mShaderGeneration(0)
     {
-        using atlas::utils::Mesh;
         namespace gl = atlas::gl;
         namespace math = atlas::math;
 
-        Mesh sphere;
+        MeshBlob sphere;
         std::string path{ DataDirectory };
         path = path + "sphere.obj";
-        Mesh::fromFile(path, sphere);
-
-        mIndexCount = static_cast<GLsizei>(sphere.indices().size());
-
-        std::vector<float> data;
-        for (std::size_t i = 0; i < sphere.vertices().size(); ++i)
-        {
-            data.push_back(sphere.vertices()[i].x);
-            data.push_back(sphere.vertices()[i].y);
-            data.push_back(sphere.vertices()[i].z);
-
-            data.push_back(sphere.normals()[i].x);
-            data.push_back(sphere.normals()[i].y);
-            data.push_back(sphere.normals()[i].z);
-
-            data.push_back(sphere.texCoords()[i].x);
-            data.push_back(sphere.texCoords()[i].y);
-        }
+        // Without the mesh the ball is simply not drawn; load() has
+        // already logged why.
+        bool loaded = sphere.load(path);
+        mIndexCount = loaded ? static_cast<GLsizei>(sphere.indexCount()) : 0;
 
         mVao.bindVertexArray();
         mVertexBuffer.bindBuffer();
-        mVertexBuffer.bufferData(gl::size<float>(data.size()), data.data(),
+        mVertexBuffer.bufferData(sphere.vertexBytes(), sphere.vertices(),
             GL_STATIC_DRAW);
         mVertexBuffer.vertexAttribPointer(VERTICES_LAYOUT_LOCATION, 3, GL_FLOAT,
             GL_FALSE, gl::stride<float>(8), gl::bufferOffset<float>(0));
@@ -55,8 +45,8 @@ namespace lab3
         mVao.enableVertexAttribArray(TEXTURES_LAYOUT_LOCATION);
 
         mIndexBuffer.bindBuffer();
-        mIndexBuffer.bufferData(gl::size<GLuint>(sphere.indices().size()),
-            sphere.indices().data(), GL_STATIC_DRAW);
+        mIndexBuffer.bufferData(sphere.indexBytes(), sphere.indices(),
+            GL_STATIC_DRAW);
 
         mIndexBuffer.unBindBuffer();
         mVertexBuffer.unBindBuffer();
@@ -69,50 +59,67 @@ namespace lab3
         };
 
         mShaders.emplace_back(shaders);
+
+#if defined(SHADER_HOT_RELOAD)
+        for (auto const& unit : shaders)
+        {
+            ShaderWatcher::getInstance().watch(unit.filename);
+        }
+        mShaderGeneration = ShaderWatcher::getInstance().generation();
+#endif
+
         mShaders[0].setShaderIncludeDir(ShaderDirectory);
-        mShaders[0].compileShaders();
-        mShaders[0].linkShaders();
-
-        auto var = mShaders[0].getUniformVariable("model");
-        mUniforms.insert(UniformKey("model", var));
-        var = mShaders[0].getUniformVariable("projection");
-        mUniforms.insert(UniformKey("projection", var));
-        var = mShaders[0].getUniformVariable("view");
-        mUniforms.insert(UniformKey("view", var));
-        var = mShaders[0].getUniformVariable("materialColour");
-        mUniforms.insert(UniformKey("materialColour", var));
-
-        mShaders[0].disableShaders();
+        mProgram.build(mShaders[0], shaders, ShaderDirectory);
+
+        GLuint program = mProgram.getProgram();
+        mUniformTable.resolve(mProgram);
+        FrameUniforms::bindProgram(program);
+
+        mProgram.disableProgram();
     }
     
     void TrackBall::renderGeometry(atlas::math::Matrix4 const& projection,
         atlas::math::Matrix4 const& view)
     {
         namespace math = atlas::math;
+        UNUSED(projection);
+        UNUSED(view);
+
+#if defined(SHADER_HOT_RELOAD)
+        auto generation = ShaderWatcher::getInstance().generation();
+        if (generation != mShaderGeneration)
+        {
+            mShaderGeneration = generation;
+            mProgram.reload(mShaders[0]);
+        }
+#endif
 
-        mShaders[0].hotReloadShaders();
-        if (!mShaders[0].shaderProgramValid())
+        if (!mProgram.programValid())
         {
             return;
         }
 
-        mShaders[0].enableShaders();
+        GLuint program = mProgram.getProgram();
+        if (mUniformTable.resolve(mProgram))
+        {
+            FrameUniforms::bindProgram(program);
+        }
+
+        mProgram.enableProgram();
 
         mVao.bindVertexArray();
         mIndexBuffer.bindBuffer();
 
-        glUniformMatrix4fv(mUniforms["projection"], 1, GL_FALSE,
-            &projection[0][0]);
-        glUniformMatrix4fv(mUniforms["view"], 1, GL_FALSE, &view[0][0]);
-
         const math::Vector metalGray{ 0.0f, 0.46f, 0.69f };
-        glUniformMatrix4fv(mUniforms["model"], 1, GL_FALSE, &mModel[0][0]);
-        glUniform3fv(mUniforms["materialColour"], 1, &metalGray[0]);
+        glUniformMatrix4fv(mUniformTable.get<BallUniform::Model>(),
+            1, GL_FALSE, &mModel[0][0]);
+        glUniform3fv(mUniformTable.get<BallUniform::MaterialColour>(),
+            1, &metalGray[0]);
         glDrawElements(GL_TRIANGLES, mIndexCount, GL_UNSIGNED_INT, 0);
 
         mIndexBuffer.unBindBuffer();
         mVao.unBindVertexArray();
-        mShaders[0].disableShaders();
+        mProgram.disableProgram();
     }
 
     void TrackBall::transformGeometry(atlas::math::Matrix4 const& t)
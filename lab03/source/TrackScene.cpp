@@ -11,7 +11,7 @@ namespace lab3
         mPlay(false),
         mFPS(60.0f),
         mAnimLength(10.0f),
-        mSpline(int(mAnimLength * mFPS)),
+        mSpline(mAnimLength),
         mCounter(mFPS)
     { }
 
@@ -56,9 +56,11 @@ namespace lab3
             glm::radians(mCamera.getCameraFOV()),
             (float)mWidth / mHeight, 1.0f, 100000000.0f);
         mView = mCamera.getCameraMatrix();
+        mFrameUniforms.update(mProjection, mView);
 
         mGrid.renderGeometry(mProjection, mView);
         mBall.renderGeometry(mProjection, mView);
+        mSpline.setViewport(mWidth, mHeight);
         mSpline.renderGeometry(mProjection, mView);
 
         // Global HUD
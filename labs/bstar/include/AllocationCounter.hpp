@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+namespace bstar
+{
+    // Counts of heap allocations made through operator new, for the
+    // instrumentation panel. AllocationCounter.cpp replaces the global
+    // operator new and delete of whatever program links it; allocations
+    // that bypass them, such as ImGui's and the GL driver's, are not seen.
+    namespace allocations
+    {
+        // Made by the calling thread since it started.
+        std::uint64_t thisThread();
+
+        // Made by every thread since the program started.
+        std::uint64_t total();
+        std::uint64_t totalBytes();
+    }
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bstar
+{
+    // Initial conditions of one planet-and-binary system. The stars start
+    // on a circular orbit about their centre of mass, separated along x;
+    // the planet starts in the orbital plane at (planetX, 0, planetZ) with
+    // speedScale times the circular speed about the binary's total mass.
+    struct SystemParameters
+    {
+        double planetMass;
+        double firstStarMass;
+        double secondStarMass;
+        double separation;
+        double planetX;
+        double planetZ;
+        double speedScale;
+    };
+
+    enum class Outcome : int
+    {
+        Running = 0,
+        // Unbound from the binary and beyond the escape radius.
+        Escaped,
+        // Within the collision radius of a star.
+        Collided,
+        // MEGNO grew past the chaotic threshold.
+        Chaotic,
+        // MEGNO settled at or below the quasi-periodic value of 2.
+        Stable,
+        // Ran to the end without meeting any criterion.
+        Undecided
+    };
+
+    // Thresholds for the online classifiers. A run stops at the first step
+    // that meets one, so most unstable systems cost a fraction of the full
+    // step count.
+    struct ClassifierSettings
+    {
+        double escapeRadius = 50.0;
+        double collisionRadius = 0.35;
+
+        // MEGNO only says something once it has averaged over a few orbits,
+        // so neither chaos nor stability is called before this time.
+        double megnoTime = 100.0;
+        double chaoticMegno = 4.0;
+        double stableTolerance = 0.05;
+
+        // Calling a run stable before the end is a gamble on slow
+        // diffusion; 0 leaves stability to be judged at the final step.
+        double stableTime = 0.0;
+    };
+
+    struct SystemResult
+    {
+        Outcome outcome;
+        // Steps taken before the run was classified, or all of them.
+        std::size_t steps;
+        double time;
+        // Planet distance from the binary's centre of mass.
+        double minDistance;
+        double maxDistance;
+        double finalDistance;
+        // Relative drift in total energy, a check on the step size.
+        double energyError;
+        // Time-averaged MEGNO and the finite-time Lyapunov exponent.
+        double megno;
+        double lyapunov;
+    };
+
+    // A batch of independent three-body systems integrated in lockstep,
+    // one system per SIMD lane; a single three-body system has far too
+    // little work to parallelize internally. Systems are packed into
+    // fixed-width blocks that hold every component as [body][lane], so the
+    // loops over lanes have a constant trip count and provably disjoint
+    // arrays and vectorize without runtime checks.
+    //
+    // Alongside each system a tangent vector is carried through the same
+    // leapfrog map to give the MEGNO and Lyapunov indicators. Finished
+    // lanes keep stepping with their block but stop recording; a block
+    // stops as soon as all its lanes have finished.
+    class BinaryEnsemble
+    {
+    public:
+        static constexpr std::size_t Bodies = 3;
+        static constexpr std::size_t Planet = 0;
+        static constexpr std::size_t FirstStar = 1;
+        static constexpr std::size_t SecondStar = 2;
+
+        // Lanes per block: one AVX-512 or two AVX2 vectors of doubles.
+        static constexpr std::size_t Width = 8;
+
+        BinaryEnsemble();
+
+        void setClassifier(ClassifierSettings const& settings);
+
+        // Runs the numerical core built without FMA contraction, so results
+        // match bit for bit across machines, compilers' -march settings and
+        // vector widths. Takes effect at the next setup().
+        void setDeterministic(bool deterministic);
+
+        void setup(SystemParameters const* params, std::size_t count);
+
+        // Kick-drift-kick leapfrog, the same scheme the viewer's Verlet
+        // integrator uses. Runs every system for at most the given number
+        // of steps from the start. With stepHashes, a hash of every
+        // running system's state is added to the entry for each step.
+        void run(double dt, std::size_t steps,
+            std::uint64_t* stepHashes = nullptr);
+
+        std::size_t size() const;
+        void results(SystemResult* out) const;
+
+    private:
+        struct Block
+        {
+            double x[Bodies][Width];
+            double y[Bodies][Width];
+            double z[Bodies][Width];
+            double vx[Bodies][Width];
+            double vy[Bodies][Width];
+            double vz[Bodies][Width];
+            double ax[Bodies][Width];
+            double ay[Bodies][Width];
+            double az[Bodies][Width];
+            double mass[Bodies][Width];
+
+            // Tangent vector in phase space and its acceleration.
+            double dx[Bodies][Width];
+            double dy[Bodies][Width];
+            double dz[Bodies][Width];
+            double dvx[Bodies][Width];
+            double dvy[Bodies][Width];
+            double dvz[Bodies][Width];
+            double dax[Bodies][Width];
+            double day[Bodies][Width];
+            double daz[Bodies][Width];
+
+            // Running integrals for MEGNO, and the log of the tangent
+            // vector's growth removed by renormalisation.
+            double megnoSum[Width];
+            double megnoMeanSum[Width];
+            double logGrowth[Width];
+
+            // 1 while a lane is still running, 0 once it has finished.
+            double active[Width];
+            double initialEnergy[Width];
+            double minDistance[Width];
+            double maxDistance[Width];
+
+            // Recorded when a lane finishes.
+            double finalDistance[Width];
+            double energyError[Width];
+            double megno[Width];
+            double lyapunov[Width];
+            std::size_t finishStep[Width];
+            Outcome outcome[Width];
+            std::size_t running;
+        };
+
+        // Defined in EnsembleKernel.hpp.
+        template <bool Strict>
+        struct Kernel;
+
+        static void setupBlock(Block& block, SystemParameters const* params,
+            std::size_t first, std::size_t count);
+        static void runBlock(Block& block, ClassifierSettings const& settings,
+            double dt, std::size_t steps, std::uint64_t* stepHashes);
+
+        // The same, from BinaryEnsembleStrict.cpp.
+        static void setupBlockStrict(Block& block,
+            SystemParameters const* params, std::size_t first,
+            std::size_t count);
+        static void runBlockStrict(Block& block,
+            ClassifierSettings const& settings, double dt, std::size_t steps,
+            std::uint64_t* stepHashes);
+
+        ClassifierSettings mSettings;
+        bool mDeterministic;
+        std::size_t mCount;
+        double mDt;
+        std::vector<Block> mBlocks;
+    };
+}
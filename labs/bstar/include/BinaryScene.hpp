@@ -1,9 +1,12 @@
 #pragma once
 
 #include "Body.hpp"
+#include "FrameUniforms.hpp"
+#include "FrameArena.hpp"
 
 #include <atlas/tools/ModellingScene.hpp>
-#include <atlas/utils/FPSCounter.hpp>
+
+#include <cstdint>
 
 namespace bstar
 {
@@ -16,12 +19,25 @@ namespace bstar
         void renderScene() override;
 
     private:
+        void drawInstrumentation();
+        void endFrame();
+
         bool mPlay;
         int mFPSOption;
         float mFPS;
 
-        atlas::core::Time<float> mAnimTime;
-        atlas::utils::FPSCounter mCounter;
+        FrameUniforms mFrameUniforms;
+
+        // Declared before mBall, which keeps its draw lists in it.
+        FrameArena mFrameArena;
+
+        // Heap allocations counted at the end of the last frame, and made
+        // during it, on this thread and on all of them.
+        std::uint64_t mThreadAllocations;
+        std::uint64_t mTotalAllocations;
+        std::uint64_t mFrameThreadAllocations;
+        std::uint64_t mFrameTotalAllocations;
+        std::uint64_t mCleanFrames;
 
         Body mBall;
     };
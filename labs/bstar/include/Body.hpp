@@ -5,12 +5,50 @@
 #include <atlas/gl/VertexArrayObject.hpp>
 #include <atlas/gl/Texture.hpp>
 
+#include "UniformTable.hpp"
+#include "CachedProgram.hpp"
+#include "SphereLod.hpp"
+#include "VisibilityGrid.hpp"
+#include "TrailBuffer.hpp"
+#include "SimulationThread.hpp"
+#include "FrameArena.hpp"
+
+#include <array>
+#include <cstdint>
+
 namespace bstar
 {
+    enum class BodyUniform : std::size_t
+    {
+        Model = 0,
+        Count
+    };
+
+    enum class ImpostorUniform : std::size_t
+    {
+        Model = 0,
+        ViewportHeight,
+        Count
+    };
+
+    enum class TrailUniform : std::size_t
+    {
+        Model = 0,
+        Trail,
+        Bodies,
+        Capacity,
+        Oldest,
+        Points,
+        Colour,
+        Count
+    };
+
     class Body : public atlas::utils::Geometry
     {
     public:
-        Body();
+        // Per-frame lists come from the arena, which the owner resets once
+        // each frame has been drawn.
+        explicit Body(FrameArena& frameArena);
 
         void updateGeometry(atlas::core::Time<> const& t) override;
         void drawGui() override;
@@ -19,43 +57,86 @@ namespace bstar
 
         void resetGeometry() override;
 
+        void setViewport(int width, int height);
+
+        // Forwarded to the simulation thread, which steps at the given rate
+        // with a time step of one over it.
+        void setPlaying(bool playing);
+        void setStepRate(float rate);
+
     private:
-        void eulerIntegrator(atlas::core::Time<> const& t);
-        void implicitEulerIntegrator(atlas::core::Time<> const& t);
-        void verletIntegrator(atlas::core::Time<> const& t);
-        void rk4Integrator(atlas::core::Time<> const& t);
-        float gravity(atlas::math::Vector m1Position, atlas::math::Vector m2Position, float m1Mass, float m2Mass);
+        void gatherInstances();
+        void cullInstances(atlas::math::Matrix4 const& projection,
+            atlas::math::Matrix4 const& view);
+        void selectLevels(atlas::math::Matrix4 const& projection,
+            atlas::math::Matrix4 const& view);
+        void pointInstances(std::size_t first);
+        void renderTrails();
+
+        // Mesh levels of the sphere, finest first; everything below the
+        // last one is drawn as an impostor.
+        static constexpr std::size_t MeshLevels = 3;
+        static constexpr std::size_t ImpostorLevel = MeshLevels;
 
         atlas::gl::Buffer mVertexBuffer;
         atlas::gl::Buffer mIndexBuffer;
+        atlas::gl::Buffer mInstanceBuffer;
         atlas::gl::VertexArrayObject mVao;
+        atlas::gl::VertexArrayObject mImpostorVao;
+        SphereLod mSphereLod;
 
-        // Mass 1 details
-        atlas::math::Vector mPosition;
-        atlas::math::Vector mOffset;
-        atlas::math::Vector mVelocity;
-        atlas::math::Vector mOldPosition;
-        atlas::math::Vector mForce;
-
-        float mMass;
-
-        // Star Mass details
-        atlas::math::Vector s1Position;
-        atlas::math::Vector s1Velocity;
-        atlas::math::Vector s1Offset;
-        atlas::math::Vector s1OldPosition;
-        atlas::math::Vector s1Force;
-        float s1Mass;
-
-        atlas::math::Vector s2Position;
-        atlas::math::Vector s2Velocity;
-        atlas::math::Vector s2Offset;
-        atlas::math::Vector s2OldPosition;
-        atlas::math::Vector s2Force;
-        float s2Mass;
-
+        // The simulation runs on its own thread; this side only sees the
+        // latest state it published.
+        SimulationThread mSimulation;
         int mIntegrator;
+        int mForceMethod;
+        int mExpansionOrder;
+        float mOpeningAngle;
+        int mForceThreads;
+        int mSortInterval;
+        bool mPostNewtonian;
+        float mSpeedOfLight;
+        int mForceLaw;
+        float mSoftening;
+        bool mCollisions;
+        float mStepRate;
+        std::uint64_t mSeenSteps;
+        std::uint64_t mSeenResets;
+
+        UniformTable<BodyUniform> mUniformTable;
+        UniformTable<ImpostorUniform> mImpostorUniforms;
+        UniformTable<TrailUniform> mTrailUniforms;
+        CachedProgram mProgram;
+        CachedProgram mImpostorProgram;
+        CachedProgram mTrailProgram;
+        std::uint64_t mShaderGeneration;
+
+        // Instances are bucketed by level every frame so each level is one
+        // contiguous range of the instance buffer and one draw call. The
+        // bucketed copy, one per visible instance, lives in the arena.
+        FrameArena& mFrameArena;
+        std::vector<BodyInstance> mInstances;
+        std::vector<std::uint32_t> mVisible;
+        BodyInstance* mSortedInstances;
+        std::uint64_t mInstanceLayout;
+        std::array<std::size_t, MeshLevels + 1> mLevelFirst;
+        std::array<std::size_t, MeshLevels + 1> mLevelCount;
+        std::size_t mInstanceCapacity;
+
+        // Smallest projected radius, in pixels, drawn with each mesh level.
+        std::array<float, MeshLevels> mLevelPixels;
+        float mLodScale;
+        int mViewportHeight;
+
+        VisibilityGrid mVisibilityGrid;
+        bool mCulling;
 
-        GLsizei mIndexCount;
+        // Trails have no per-vertex attributes; the shader reads them from
+        // the buffer texture, but core profiles still need a VAO bound.
+        TrailBuffer mTrails;
+        atlas::gl::VertexArrayObject mTrailVao;
+        std::vector<atlas::math::Vector4> mTrailPoints;
+        bool mShowTrails;
+        int mTrailLength;
     };
 }
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <atlas/math/Math.hpp>
+
+namespace bstar
+{
+    // Per-instance data shared by the mesh and impostor paths: centre and
+    // radius in sphere, and the material colour.
+    struct BodyInstance
+    {
+        atlas::math::Vector4 sphere;
+        atlas::math::Vector4 colour;
+    };
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atlas/gl/Shader.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bstar
+{
+    // Links a shader program from a binary cached on disk when the shader
+    // sources and the driver are the ones it was built with, and compiles
+    // the sources through atlas otherwise, caching the result for the next
+    // start.
+    class CachedProgram
+    {
+    public:
+        CachedProgram();
+        ~CachedProgram();
+
+        CachedProgram(CachedProgram const&) = delete;
+        CachedProgram& operator=(CachedProgram const&) = delete;
+
+        // The shader must already hold the units and include directory;
+        // it is only compiled if the cache cannot be used.
+        void build(atlas::gl::Shader& shader,
+            std::vector<atlas::gl::ShaderUnit> const& units,
+            std::string const& includeDir);
+
+        // Recompiles after a source edit and refreshes the cached binary.
+        void reload(atlas::gl::Shader& shader);
+
+        bool programValid() const;
+        GLuint getProgram() const;
+
+        // Counts every successful build and reload. A relinked program may
+        // reuse the old name, so this is what tells state that depends on
+        // the link, such as uniform locations, to refresh.
+        std::uint64_t links() const;
+        void enableProgram() const;
+        void disableProgram() const;
+
+        static constexpr std::uint32_t Magic = 0x50435342; // "BSCP"
+        static constexpr std::uint32_t Version = 1;
+
+    private:
+        void compile(atlas::gl::Shader& shader);
+        bool loadBinary();
+        void storeBinary() const;
+        void releaseBinary();
+
+        std::uint64_t hashSources() const;
+        std::string expandSource(std::string const& file, int depth) const;
+
+        std::vector<atlas::gl::ShaderUnit> mUnits;
+        std::string mIncludeDir;
+        std::string mCachePath;
+        std::uint64_t mSourceHash;
+
+        GLuint mProgram;
+        GLuint mBinaryProgram;
+        std::uint64_t mLinks;
+        bool mCompiled;
+    };
+}
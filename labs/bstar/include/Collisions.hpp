@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Particles.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace bstar
+{
+    struct Contact
+    {
+        // Fraction of the step at which the spheres first touch.
+        double time;
+        std::uint32_t first;
+        std::uint32_t second;
+    };
+
+    // Finds bodies whose spheres touched at any point during a step and
+    // merges them. The broad phase is a spatial hash rebuilt from scratch
+    // every step; the narrow phase sweeps each candidate pair along its
+    // straight-line motion over the step, so fast bodies cannot tunnel
+    // through each other between samples.
+    class Collisions
+    {
+    public:
+        Collisions();
+
+        // x0, y0, z0 are the positions at the start of the step; the
+        // particles hold the positions at its end. Returns the number of
+        // merges.
+        std::size_t resolve(Particles& particles,
+            BodyArray const& x0, BodyArray const& y0, BodyArray const& z0);
+
+        std::vector<Contact> const& contacts() const;
+
+    private:
+        void buildHash(Particles const& particles,
+            BodyArray const& x0, BodyArray const& y0, BodyArray const& z0);
+        void findContacts(Particles const& particles,
+            BodyArray const& x0, BodyArray const& y0, BodyArray const& z0);
+        std::size_t merge(Particles& particles);
+
+        std::uint32_t bucketOf(std::int64_t cx, std::int64_t cy,
+            std::int64_t cz) const;
+
+        double mCellSize;
+        std::uint32_t mBucketMask;
+
+        std::vector<std::uint32_t> mBucketStart;
+        std::vector<std::uint32_t> mBucketCursor;
+        std::vector<std::uint32_t> mBucketItems;
+        std::vector<std::uint32_t> mItemBuckets;
+
+        std::vector<Contact> mContacts;
+        std::vector<char> mConsumed;
+        std::vector<std::uint32_t> mRemoved;
+    };
+}
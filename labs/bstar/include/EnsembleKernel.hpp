@@ -0,0 +1,530 @@
+#pragma once
+
+#include "BinaryEnsemble.hpp"
+#include "ForceBackend.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace bstar
+{
+    namespace ensemble
+    {
+        // The three body pairs of a system, each visited once.
+        const std::size_t pairFirst[] = { 0, 0, 1 };
+        const std::size_t pairSecond[] = { 1, 2, 2 };
+
+        // The tangent vector is renormalised this often; its growth is
+        // at most exponential in the Lyapunov time, so this keeps it far
+        // from overflow for any orbit worth integrating.
+        constexpr std::size_t RenormaliseInterval = 64;
+
+        // Fixed start direction for every tangent vector, so a system's
+        // indicators do not depend on which block it lands in.
+        const double tangentSeed[6] = { 0.42, -0.17, 0.31, 0.25, 0.53,
+            -0.38 };
+
+        inline std::uint64_t mixHash(std::uint64_t h, double value)
+        {
+            std::uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            h ^= bits;
+            h ^= h >> 30;
+            h *= 0xbf58476d1ce4e5b9ull;
+            h ^= h >> 27;
+            h *= 0x94d049bb133111ebull;
+            h ^= h >> 31;
+            return h;
+        }
+    }
+
+    // The numerical core of BinaryEnsemble, kept apart so it can be built
+    // twice: by BinaryEnsemble.cpp with the build's own floating-point
+    // flags, and by BinaryEnsembleStrict.cpp without contracting multiplies
+    // and adds into FMAs. The two instantiations are distinct types, so
+    // the linker can never fold one into the other.
+    //
+    // Each system's arithmetic stays in its own lane, in a fixed order, so
+    // neither the block it lands in nor the thread that runs it changes
+    // its result; with contraction off, neither does the vector width.
+    template <bool Strict>
+    struct BinaryEnsemble::Kernel
+    {
+        static constexpr double G = ForceBackend::G;
+
+        static void setup(Block& block, SystemParameters const* params,
+            std::size_t first, std::size_t count)
+        {
+            block.running = 0;
+            for (std::size_t w = 0; w < Width; ++w)
+            {
+                // Lanes past the end repeat the last system so they stay
+                // well defined, but start finished.
+                bool real = first + w < count;
+                SystemParameters const& p =
+                    params[std::min(first + w, count - 1)];
+                double total = p.firstStarMass + p.secondStarMass;
+
+                // Each star circles the centre of mass on the far side from
+                // the other, at a distance and speed in inverse ratio to
+                // its mass.
+                double relativeSpeed = std::sqrt(G * total / p.separation);
+                block.mass[FirstStar][w] = p.firstStarMass;
+                block.x[FirstStar][w] = p.separation * p.secondStarMass /
+                    total;
+                block.vz[FirstStar][w] = -relativeSpeed * p.secondStarMass /
+                    total;
+                block.mass[SecondStar][w] = p.secondStarMass;
+                block.x[SecondStar][w] = -p.separation * p.firstStarMass /
+                    total;
+                block.vz[SecondStar][w] = relativeSpeed * p.firstStarMass /
+                    total;
+
+                double r = std::sqrt(p.planetX * p.planetX +
+                    p.planetZ * p.planetZ);
+                block.mass[Planet][w] = p.planetMass;
+                block.x[Planet][w] = p.planetX;
+                block.z[Planet][w] = p.planetZ;
+                if (r > 0.0)
+                {
+                    double speed = p.speedScale * std::sqrt(G * total / r);
+                    block.vx[Planet][w] = speed * p.planetZ / r;
+                    block.vz[Planet][w] = -speed * p.planetX / r;
+                }
+
+                double norm2 = 0.0;
+                for (std::size_t i = 0; i < Bodies; ++i)
+                {
+                    for (double seed : ensemble::tangentSeed)
+                    {
+                        norm2 += seed * seed;
+                    }
+                }
+                double scale = 1.0 / std::sqrt(norm2);
+                for (std::size_t i = 0; i < Bodies; ++i)
+                {
+                    double sign = (i % 2 == 0) ? scale : -scale;
+                    block.dx[i][w] = sign * ensemble::tangentSeed[0];
+                    block.dy[i][w] = sign * ensemble::tangentSeed[1];
+                    block.dz[i][w] = sign * ensemble::tangentSeed[2];
+                    block.dvx[i][w] = sign * ensemble::tangentSeed[3];
+                    block.dvy[i][w] = sign * ensemble::tangentSeed[4];
+                    block.dvz[i][w] = sign * ensemble::tangentSeed[5];
+                }
+
+                block.megnoSum[w] = 0.0;
+                block.megnoMeanSum[w] = 0.0;
+                block.logGrowth[w] = 0.0;
+                block.active[w] = real ? 1.0 : 0.0;
+                block.finalDistance[w] = 0.0;
+                block.energyError[w] = 0.0;
+                block.megno[w] = 0.0;
+                block.lyapunov[w] = 0.0;
+                block.finishStep[w] = 0;
+                block.outcome[w] = real ? Outcome::Running :
+                    Outcome::Undecided;
+                block.running += real ? 1 : 0;
+            }
+
+            computeAccelerations(block);
+            energies(block, block.initialEnergy);
+
+            double distance[Width];
+            planetOffsets(block, distance);
+            for (std::size_t w = 0; w < Width; ++w)
+            {
+                block.minDistance[w] = distance[w];
+                block.maxDistance[w] = distance[w];
+            }
+        }
+
+        // Runs a block until all its lanes are decided or the steps run
+        // out. With hashes, adds a hash of each running lane's state to
+        // the entry for every step; addition makes the total independent
+        // of how systems were batched and which thread ran them.
+        static void run(Block& block, ClassifierSettings const& settings,
+            double dt, std::size_t steps, std::uint64_t* hashes)
+        {
+            for (std::size_t s = 1; s <= steps && block.running != 0; ++s)
+            {
+                double time = s * dt;
+                step(block, dt, time);
+                if (s % ensemble::RenormaliseInterval == 0)
+                {
+                    renormalise(block);
+                }
+                if (hashes != nullptr)
+                {
+                    hashes[s - 1] += hash(block);
+                }
+                classify(block, settings, s, time, s == steps);
+            }
+        }
+
+        static std::uint64_t hash(Block const& block)
+        {
+            std::uint64_t total = 0;
+            for (std::size_t w = 0; w < Width; ++w)
+            {
+                if (block.active[w] == 0.0)
+                {
+                    continue;
+                }
+
+                std::uint64_t h = 0x9e3779b97f4a7c15ull;
+                for (std::size_t i = 0; i < Bodies; ++i)
+                {
+                    h = ensemble::mixHash(h, block.x[i][w]);
+                    h = ensemble::mixHash(h, block.y[i][w]);
+                    h = ensemble::mixHash(h, block.z[i][w]);
+                    h = ensemble::mixHash(h, block.vx[i][w]);
+                    h = ensemble::mixHash(h, block.vy[i][w]);
+                    h = ensemble::mixHash(h, block.vz[i][w]);
+                }
+                total += h;
+            }
+            return total;
+        }
+
+        static void computeAccelerations(Block& block)
+        {
+            for (std::size_t i = 0; i < Bodies; ++i)
+            {
+                for (std::size_t w = 0; w < Width; ++w)
+                {
+                    block.ax[i][w] = 0.0;
+                    block.ay[i][w] = 0.0;
+                    block.az[i][w] = 0.0;
+                    block.dax[i][w] = 0.0;
+                    block.day[i][w] = 0.0;
+                    block.daz[i][w] = 0.0;
+                }
+            }
+
+            for (std::size_t k = 0; k < 3; ++k)
+            {
+                std::size_t i = ensemble::pairFirst[k];
+                std::size_t j = ensemble::pairSecond[k];
+                for (std::size_t w = 0; w < Width; ++w)
+                {
+                    double rx = block.x[j][w] - block.x[i][w];
+                    double ry = block.y[j][w] - block.y[i][w];
+                    double rz = block.z[j][w] - block.z[i][w];
+                    double r2 = rx * rx + ry * ry + rz * rz;
+                    double invR3 = G / (r2 * std::sqrt(r2));
+                    block.ax[i][w] += block.mass[j][w] * rx * invR3;
+                    block.ay[i][w] += block.mass[j][w] * ry * invR3;
+                    block.az[i][w] += block.mass[j][w] * rz * invR3;
+                    block.ax[j][w] -= block.mass[i][w] * rx * invR3;
+                    block.ay[j][w] -= block.mass[i][w] * ry * invR3;
+                    block.az[j][w] -= block.mass[i][w] * rz * invR3;
+
+                    // Linearised pull: (I - 3 r r^T / r^2) dr / r^3.
+                    double drx = block.dx[j][w] - block.dx[i][w];
+                    double dry = block.dy[j][w] - block.dy[i][w];
+                    double drz = block.dz[j][w] - block.dz[i][w];
+                    double f = 3.0 * (rx * drx + ry * dry + rz * drz) / r2;
+                    double tx = (drx - f * rx) * invR3;
+                    double ty = (dry - f * ry) * invR3;
+                    double tz = (drz - f * rz) * invR3;
+                    block.dax[i][w] += block.mass[j][w] * tx;
+                    block.day[i][w] += block.mass[j][w] * ty;
+                    block.daz[i][w] += block.mass[j][w] * tz;
+                    block.dax[j][w] -= block.mass[i][w] * tx;
+                    block.day[j][w] -= block.mass[i][w] * ty;
+                    block.daz[j][w] -= block.mass[i][w] * tz;
+                }
+            }
+        }
+
+        static void step(Block& block, double dt, double time)
+        {
+            double halfDt = 0.5 * dt;
+            for (std::size_t i = 0; i < Bodies; ++i)
+            {
+                for (std::size_t w = 0; w < Width; ++w)
+                {
+                    block.vx[i][w] += halfDt * block.ax[i][w];
+                    block.vy[i][w] += halfDt * block.ay[i][w];
+                    block.vz[i][w] += halfDt * block.az[i][w];
+                    block.x[i][w] += dt * block.vx[i][w];
+                    block.y[i][w] += dt * block.vy[i][w];
+                    block.z[i][w] += dt * block.vz[i][w];
+
+                    block.dvx[i][w] += halfDt * block.dax[i][w];
+                    block.dvy[i][w] += halfDt * block.day[i][w];
+                    block.dvz[i][w] += halfDt * block.daz[i][w];
+                    block.dx[i][w] += dt * block.dvx[i][w];
+                    block.dy[i][w] += dt * block.dvy[i][w];
+                    block.dz[i][w] += dt * block.dvz[i][w];
+                }
+            }
+
+            computeAccelerations(block);
+
+            double rate[Width];
+            double norm2[Width];
+            for (std::size_t w = 0; w < Width; ++w)
+            {
+                rate[w] = 0.0;
+                norm2[w] = 0.0;
+            }
+
+            for (std::size_t i = 0; i < Bodies; ++i)
+            {
+                for (std::size_t w = 0; w < Width; ++w)
+                {
+                    block.vx[i][w] += halfDt * block.ax[i][w];
+                    block.vy[i][w] += halfDt * block.ay[i][w];
+                    block.vz[i][w] += halfDt * block.az[i][w];
+
+                    block.dvx[i][w] += halfDt * block.dax[i][w];
+                    block.dvy[i][w] += halfDt * block.day[i][w];
+                    block.dvz[i][w] += halfDt * block.daz[i][w];
+
+                    // d/dt |delta|^2 / 2 and |delta|^2 over phase space.
+                    rate[w] += block.dx[i][w] * block.dvx[i][w] +
+                        block.dy[i][w] * block.dvy[i][w] +
+                        block.dz[i][w] * block.dvz[i][w] +
+                        block.dvx[i][w] * block.dax[i][w] +
+                        block.dvy[i][w] * block.day[i][w] +
+                        block.dvz[i][w] * block.daz[i][w];
+                    norm2[w] += block.dx[i][w] * block.dx[i][w] +
+                        block.dy[i][w] * block.dy[i][w] +
+                        block.dz[i][w] * block.dz[i][w] +
+                        block.dvx[i][w] * block.dvx[i][w] +
+                        block.dvy[i][w] * block.dvy[i][w] +
+                        block.dvz[i][w] * block.dvz[i][w];
+                }
+            }
+
+            // MEGNO: Y(t) = 2/t int s |delta|'/|delta| ds, and its running
+            // mean.
+            double distance[Width];
+            planetOffsets(block, distance);
+            for (std::size_t w = 0; w < Width; ++w)
+            {
+                block.megnoSum[w] += dt * time * rate[w] / norm2[w];
+                block.megnoMeanSum[w] += 2.0 * block.megnoSum[w] / time * dt;
+
+                bool active = block.active[w] != 0.0;
+                block.minDistance[w] = active ?
+                    std::min(block.minDistance[w], distance[w]) :
+                    block.minDistance[w];
+                block.maxDistance[w] = active ?
+                    std::max(block.maxDistance[w], distance[w]) :
+                    block.maxDistance[w];
+            }
+        }
+
+        static void renormalise(Block& block)
+        {
+            for (std::size_t w = 0; w < Width; ++w)
+            {
+                double norm2 = 0.0;
+                for (std::size_t i = 0; i < Bodies; ++i)
+                {
+                    norm2 += block.dx[i][w] * block.dx[i][w] +
+                        block.dy[i][w] * block.dy[i][w] +
+                        block.dz[i][w] * block.dz[i][w] +
+                        block.dvx[i][w] * block.dvx[i][w] +
+                        block.dvy[i][w] * block.dvy[i][w] +
+                        block.dvz[i][w] * block.dvz[i][w];
+                }
+
+                if (!(norm2 > 0.0) || !std::isfinite(norm2))
+                {
+                    continue;
+                }
+
+                double norm = std::sqrt(norm2);
+                double scale = 1.0 / norm;
+                block.logGrowth[w] += std::log(norm);
+                for (std::size_t i = 0; i < Bodies; ++i)
+                {
+                    block.dx[i][w] *= scale;
+                    block.dy[i][w] *= scale;
+                    block.dz[i][w] *= scale;
+                    block.dvx[i][w] *= scale;
+                    block.dvy[i][w] *= scale;
+                    block.dvz[i][w] *= scale;
+                    block.dax[i][w] *= scale;
+                    block.day[i][w] *= scale;
+                    block.daz[i][w] *= scale;
+                }
+            }
+        }
+
+        static void classify(Block& block, ClassifierSettings const& s,
+            std::size_t steps, double time, bool last)
+        {
+            double collision2 = s.collisionRadius * s.collisionRadius;
+
+            for (std::size_t w = 0; w < Width; ++w)
+            {
+                if (block.active[w] == 0.0)
+                {
+                    continue;
+                }
+
+                double px = block.x[Planet][w];
+                double py = block.y[Planet][w];
+                double pz = block.z[Planet][w];
+                bool collided = false;
+                for (std::size_t star = FirstStar; star <= SecondStar; ++star)
+                {
+                    double dx = block.x[star][w] - px;
+                    double dy = block.y[star][w] - py;
+                    double dz = block.z[star][w] - pz;
+                    collided = collided ||
+                        (dx * dx + dy * dy + dz * dz < collision2);
+                }
+                if (collided)
+                {
+                    finish(block, w, Outcome::Collided, steps, time);
+                    continue;
+                }
+
+                // Escape needs the planet both far out and unbound from the
+                // binary as a whole; far out alone is just an eccentric orbit.
+                double m1 = block.mass[FirstStar][w];
+                double m2 = block.mass[SecondStar][w];
+                double f = m1 / (m1 + m2);
+                double rx = px - (f * block.x[FirstStar][w] +
+                    (1.0 - f) * block.x[SecondStar][w]);
+                double ry = py - (f * block.y[FirstStar][w] +
+                    (1.0 - f) * block.y[SecondStar][w]);
+                double rz = pz - (f * block.z[FirstStar][w] +
+                    (1.0 - f) * block.z[SecondStar][w]);
+                double r = std::sqrt(rx * rx + ry * ry + rz * rz);
+                if (r > s.escapeRadius)
+                {
+                    double ux = block.vx[Planet][w] -
+                        (f * block.vx[FirstStar][w] +
+                        (1.0 - f) * block.vx[SecondStar][w]);
+                    double uy = block.vy[Planet][w] -
+                        (f * block.vy[FirstStar][w] +
+                        (1.0 - f) * block.vy[SecondStar][w]);
+                    double uz = block.vz[Planet][w] -
+                        (f * block.vz[FirstStar][w] +
+                        (1.0 - f) * block.vz[SecondStar][w]);
+                    double energy = 0.5 * (ux * ux + uy * uy + uz * uz) -
+                        G * (m1 + m2) / r;
+                    if (energy > 0.0)
+                    {
+                        finish(block, w, Outcome::Escaped, steps, time);
+                        continue;
+                    }
+                }
+
+                if (time < s.megnoTime)
+                {
+                    if (last)
+                    {
+                        finish(block, w, Outcome::Undecided, steps, time);
+                    }
+                    continue;
+                }
+
+                double megno = block.megnoMeanSum[w] / time;
+                if (megno > s.chaoticMegno)
+                {
+                    finish(block, w, Outcome::Chaotic, steps, time);
+                }
+                else if (megno < 2.0 + s.stableTolerance &&
+                    (last || (s.stableTime > 0.0 && time >= s.stableTime)))
+                {
+                    finish(block, w, Outcome::Stable, steps, time);
+                }
+                else if (last)
+                {
+                    finish(block, w, Outcome::Undecided, steps, time);
+                }
+            }
+        }
+
+        static void finish(Block& block, std::size_t lane,
+            Outcome outcome, std::size_t steps, double time)
+        {
+            double energy[Width];
+            double distance[Width];
+            energies(block, energy);
+            planetOffsets(block, distance);
+
+            double norm2 = 0.0;
+            for (std::size_t i = 0; i < Bodies; ++i)
+            {
+                norm2 += block.dx[i][lane] * block.dx[i][lane] +
+                    block.dy[i][lane] * block.dy[i][lane] +
+                    block.dz[i][lane] * block.dz[i][lane] +
+                    block.dvx[i][lane] * block.dvx[i][lane] +
+                    block.dvy[i][lane] * block.dvy[i][lane] +
+                    block.dvz[i][lane] * block.dvz[i][lane];
+            }
+
+            double e0 = block.initialEnergy[lane];
+            block.active[lane] = 0.0;
+            block.outcome[lane] = outcome;
+            block.finishStep[lane] = steps;
+            block.finalDistance[lane] = distance[lane];
+            block.energyError[lane] = (e0 != 0.0) ?
+                std::abs((energy[lane] - e0) / e0) : 0.0;
+            block.megno[lane] = block.megnoMeanSum[lane] / time;
+            block.lyapunov[lane] = (block.logGrowth[lane] +
+                0.5 * std::log(norm2)) / time;
+            --block.running;
+        }
+
+        static void energies(Block const& block, double* out)
+        {
+            for (std::size_t w = 0; w < Width; ++w)
+            {
+                out[w] = 0.0;
+            }
+
+            for (std::size_t i = 0; i < Bodies; ++i)
+            {
+                for (std::size_t w = 0; w < Width; ++w)
+                {
+                    double v2 = block.vx[i][w] * block.vx[i][w] +
+                        block.vy[i][w] * block.vy[i][w] +
+                        block.vz[i][w] * block.vz[i][w];
+                    out[w] += 0.5 * block.mass[i][w] * v2;
+                }
+            }
+
+            for (std::size_t k = 0; k < 3; ++k)
+            {
+                std::size_t i = ensemble::pairFirst[k];
+                std::size_t j = ensemble::pairSecond[k];
+                for (std::size_t w = 0; w < Width; ++w)
+                {
+                    double dx = block.x[j][w] - block.x[i][w];
+                    double dy = block.y[j][w] - block.y[i][w];
+                    double dz = block.z[j][w] - block.z[i][w];
+                    out[w] -= G * block.mass[i][w] * block.mass[j][w] /
+                        std::sqrt(dx * dx + dy * dy + dz * dz);
+                }
+            }
+        }
+
+        static void planetOffsets(Block const& block, double* distance)
+        {
+            for (std::size_t w = 0; w < Width; ++w)
+            {
+                double m1 = block.mass[FirstStar][w];
+                double m2 = block.mass[SecondStar][w];
+                double f = m1 / (m1 + m2);
+                double dx = block.x[Planet][w] - (f * block.x[FirstStar][w] +
+                    (1.0 - f) * block.x[SecondStar][w]);
+                double dy = block.y[Planet][w] - (f * block.y[FirstStar][w] +
+                    (1.0 - f) * block.y[SecondStar][w]);
+                double dz = block.z[Planet][w] - (f * block.z[FirstStar][w] +
+                    (1.0 - f) * block.z[SecondStar][w]);
+                distance[w] = std::sqrt(dx * dx + dy * dy + dz * dz);
+            }
+        }
+    };
+}
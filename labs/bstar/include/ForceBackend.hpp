@@ -0,0 +1,67 @@
+#pragma once
+
+#include "StableArray.hpp"
+#include "ForceLaws.hpp"
+#include "ForceTerms.hpp"
+
+#include <vector>
+
+namespace bstar
+{
+    // Evaluates the gravitational acceleration of every body due to every
+    // other. Positions and velocities are passed in rather than read from
+    // the particles so multi-stage integrators can probe intermediate
+    // states; velocities only matter to velocity-dependent force terms.
+    class ForceBackend
+    {
+    public:
+        static constexpr double G = 6.67e-11;
+
+        virtual ~ForceBackend() = default;
+
+        virtual void accelerations(BodyArray const& x, BodyArray const& y,
+            BodyArray const& z, BodyArray const& vx, BodyArray const& vy,
+            BodyArray const& vz, BodyArray const& mass, BodyArray& ax,
+            BodyArray& ay, BodyArray& az) = 0;
+
+        void setForceTerms(ForceTerms const& terms);
+        ForceTerms const& forceTerms() const;
+
+        void setForceLaw(ForceLaw const& law);
+        ForceLaw const& forceLaw() const;
+
+    protected:
+        // Calls kernel(law, term) with the functors for the current
+        // settings, so every combination is compiled into its own loop.
+        template <class Kernel>
+        void visitKernels(Kernel&& kernel) const
+        {
+            visitForceLaw(mForceLaw, [&](auto const& law)
+            {
+                if (mForceTerms.postNewtonian)
+                {
+                    kernel(law,
+                        PostNewtonianTerm(G, mForceTerms.speedOfLight));
+                }
+                else
+                {
+                    kernel(law, NoPairTerm());
+                }
+            });
+        }
+
+        ForceTerms mForceTerms;
+        ForceLaw mForceLaw;
+    };
+
+    // Exact pairwise sum; O(N^2), but the reference the others are measured
+    // against and the fastest for small systems.
+    class DirectForce : public ForceBackend
+    {
+    public:
+        void accelerations(BodyArray const& x, BodyArray const& y,
+            BodyArray const& z, BodyArray const& vx, BodyArray const& vy,
+            BodyArray const& vz, BodyArray const& mass, BodyArray& ax,
+            BodyArray& ay, BodyArray& az) override;
+    };
+}
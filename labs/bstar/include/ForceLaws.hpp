@@ -0,0 +1,171 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace bstar
+{
+    enum class ForceLawKind : int
+    {
+        Newtonian = 0,
+        Plummer,
+        Spline,
+        Tabulated
+    };
+
+    // How gravity falls off with distance. Softened laws keep close
+    // encounters from producing unbounded accelerations; a tabulated law
+    // replaces gravity inside its range with any pull sampled from a
+    // custom potential.
+    struct ForceLaw
+    {
+        ForceLawKind kind = ForceLawKind::Newtonian;
+
+        // Plummer epsilon. The spline kernel reaches Newtonian gravity at
+        // 2.8 epsilon, where the two give about the same pull at r = 0.
+        double softening = 0.05;
+
+        // Pull factors sampled at even steps of r^2 over [0, range^2];
+        // shared so settings copy cheaply. Without at least two samples
+        // the law falls back to Newtonian gravity.
+        std::shared_ptr<std::vector<double> const> table;
+        double tableRange = 0.0;
+    };
+
+    // A law functor maps the squared separation r2 of a pair to f, with
+    // the pull on each body G * m_other * f * d for the separation d;
+    // Newtonian gravity has f = 1 / r^3. Kernels take the law as a
+    // template argument, so the call inlines into the pair loop, and may
+    // pass any r2 for a pair at zero separation since d is then zero.
+    struct NewtonianLaw
+    {
+        double operator()(double r2) const
+        {
+            return 1.0 / (r2 * std::sqrt(r2));
+        }
+    };
+
+    struct PlummerLaw
+    {
+        double epsilon2;
+
+        explicit PlummerLaw(double softening) :
+            epsilon2(softening * softening)
+        { }
+
+        double operator()(double r2) const
+        {
+            double s2 = r2 + epsilon2;
+            return 1.0 / (s2 * std::sqrt(s2));
+        }
+    };
+
+    // The cubic spline kernel of Monaghan and Lattanzio, as used by
+    // GADGET: a smooth mass distribution that is exactly Newtonian beyond
+    // h. Every branch is evaluated and one selected, so the loop calling
+    // it still vectorizes.
+    struct SplineLaw
+    {
+        double invH;
+        double invH3;
+
+        explicit SplineLaw(double softening) :
+            invH(1.0 / (2.8 * softening)),
+            invH3(invH * invH * invH)
+        { }
+
+        double operator()(double r2) const
+        {
+            double r = std::sqrt(r2);
+            double u = r * invH;
+            double u2 = u * u;
+            double u3 = u2 * u;
+
+            double inner = 10.666666666667 + u2 * (32.0 * u - 38.4);
+            double outer = 21.333333333333 - 48.0 * u + 38.4 * u2 -
+                10.666666666667 * u3 - 0.066666666667 / u3;
+            double softened = invH3 * ((u < 0.5) ? inner : outer);
+            return (u < 1.0) ? softened : 1.0 / (r2 * r);
+        }
+    };
+
+    // Interpolates linearly in a table of pull factors over r^2, and is
+    // Newtonian beyond the table's range. Branch-free like SplineLaw.
+    struct TabulatedLaw
+    {
+        double const* samples;
+        int last;
+        double range2;
+        double invStep;
+
+        TabulatedLaw(std::vector<double> const& table, double range) :
+            samples(table.data()),
+            last(static_cast<int>(table.size()) - 1),
+            range2(range * range),
+            invStep((table.size() - 1) / (range * range))
+        { }
+
+        double operator()(double r2) const
+        {
+            double s = std::min(r2, range2) * invStep;
+            int k = std::min(static_cast<int>(s), last - 1);
+            double t = s - k;
+            double sampled = samples[k] + t * (samples[k + 1] - samples[k]);
+            return (r2 < range2) ? sampled : 1.0 / (r2 * std::sqrt(r2));
+        }
+    };
+
+    // A tabulated law from any pull factor f(r2), sampled out to range.
+    // Sampling another law gives a starting point to edit by hand.
+    template <class Pull>
+    ForceLaw tabulateForceLaw(Pull const& pull, double range,
+        std::size_t samples)
+    {
+        auto table = std::make_shared<std::vector<double>>(samples);
+        double step = range * range / static_cast<double>(samples - 1);
+        for (std::size_t k = 0; k < samples; ++k)
+        {
+            (*table)[k] = pull(step * static_cast<double>(k));
+        }
+
+        ForceLaw law;
+        law.kind = ForceLawKind::Tabulated;
+        law.table = table;
+        law.tableRange = range;
+        return law;
+    }
+
+    // Calls visit with the functor for the law's settings. Each law is a
+    // separate instantiation of whatever visit calls, so a new law costs
+    // a case here and nothing per pair.
+    template <class Visitor>
+    void visitForceLaw(ForceLaw const& law, Visitor&& visit)
+    {
+        switch (law.kind)
+        {
+        case ForceLawKind::Plummer:
+            visit(PlummerLaw(law.softening));
+            return;
+
+        case ForceLawKind::Spline:
+            visit(SplineLaw(law.softening));
+            return;
+
+        case ForceLawKind::Tabulated:
+            if (law.table && law.table->size() >= 2 && law.tableRange > 0.0)
+            {
+                visit(TabulatedLaw(*law.table, law.tableRange));
+                return;
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        visit(NewtonianLaw());
+    }
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+namespace bstar
+{
+    // Corrections added to Newtonian gravity, all evaluated in the same
+    // pass over pairs as the Newtonian pull.
+    struct ForceTerms
+    {
+        // First post-Newtonian order of general relativity, which gives
+        // close binaries their periastron precession.
+        bool postNewtonian = false;
+
+        // In simulation units. The binary moves at about 15 units a
+        // second, so the default makes the precession visible within a
+        // few orbits; the real value would make it vanish.
+        double speedOfLight = 200.0;
+    };
+
+    // The body arrays a pair kernel reads and accumulates into.
+    // Velocities are only read by velocity-dependent terms.
+    struct PairArrays
+    {
+        double const* x;
+        double const* y;
+        double const* z;
+        double const* vx;
+        double const* vy;
+        double const* vz;
+        double const* mass;
+        double* ax;
+        double* ay;
+        double* az;
+    };
+
+    // A pair term adds to the accelerations of both bodies of a pair,
+    // reusing the separation the gravity kernel has already worked out.
+    // Terms are passed to the kernel as template arguments, so they are
+    // inlined into the pair loop rather than making their own pass.
+    struct NoPairTerm
+    {
+        void add(PairArrays const&, std::size_t, std::size_t, double, double,
+            double, double, double) const
+        { }
+    };
+
+    // Two-body 1PN acceleration in harmonic coordinates, shared between
+    // the bodies of the pair in inverse ratio to their masses as in their
+    // centre-of-mass frame. Terms coupling three or more bodies are
+    // dropped; they matter far less than the pairwise ones in a binary.
+    struct PostNewtonianTerm
+    {
+        double G;
+        double invC2;
+
+        PostNewtonianTerm(double g, double speedOfLight) :
+            G(g),
+            invC2(1.0 / (speedOfLight * speedOfLight))
+        { }
+
+        void add(PairArrays const& b, std::size_t i, std::size_t j, double dx,
+            double dy, double dz, double r2, double r) const
+        {
+            // n points from j to i and v is i's velocity relative to j.
+            double invR = 1.0 / r;
+            double nx = -dx * invR;
+            double ny = -dy * invR;
+            double nz = -dz * invR;
+            double vx = b.vx[i] - b.vx[j];
+            double vy = b.vy[i] - b.vy[j];
+            double vz = b.vz[i] - b.vz[j];
+
+            double total = b.mass[i] + b.mass[j];
+            double eta = b.mass[i] * b.mass[j] / (total * total);
+            double gm = G * total;
+            double v2 = vx * vx + vy * vy + vz * vz;
+            double rDot = nx * vx + ny * vy + nz * vz;
+
+            double radial = (4.0 + 2.0 * eta) * gm * invR -
+                (1.0 + 3.0 * eta) * v2 + 1.5 * eta * rDot * rDot;
+            double along = (4.0 - 2.0 * eta) * rDot;
+            double scale = gm * invC2 / r2;
+
+            double relx = scale * (radial * nx + along * vx);
+            double rely = scale * (radial * ny + along * vy);
+            double relz = scale * (radial * nz + along * vz);
+            double shareI = b.mass[j] / total;
+            double shareJ = b.mass[i] / total;
+            b.ax[i] += shareI * relx;
+            b.ay[i] += shareI * rely;
+            b.az[i] += shareI * relz;
+            b.ax[j] -= shareJ * relx;
+            b.ay[j] -= shareJ * rely;
+            b.az[j] -= shareJ * relz;
+        }
+    };
+
+    // Pull between bodies i and j under the given law (see ForceLaws.hpp)
+    // plus the given term, pushing both bodies.
+    template <class Law, class Term>
+    inline void gravityPair(PairArrays const& b, std::size_t i,
+        std::size_t j, double G, Law const& law, Term const& term)
+    {
+        double dx = b.x[j] - b.x[i];
+        double dy = b.y[j] - b.y[i];
+        double dz = b.z[j] - b.z[i];
+        double r2 = dx * dx + dy * dy + dz * dz;
+        if (r2 == 0.0)
+        {
+            return;
+        }
+
+        double pull = G * law(r2);
+        b.ax[i] += b.mass[j] * dx * pull;
+        b.ay[i] += b.mass[j] * dy * pull;
+        b.az[i] += b.mass[j] * dz * pull;
+        b.ax[j] -= b.mass[i] * dx * pull;
+        b.ay[j] -= b.mass[i] * dy * pull;
+        b.az[j] -= b.mass[i] * dz * pull;
+
+        term.add(b, i, j, dx, dy, dz, r2, std::sqrt(r2));
+    }
+}
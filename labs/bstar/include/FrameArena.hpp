@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace bstar
+{
+    // Linear allocator for data that lives for one frame: GUI strings,
+    // draw and cull lists, tree nodes. Allocation bumps an offset and
+    // reset() at the end of the frame rewinds it, so nothing is ever freed
+    // on its own and no destructors run.
+    //
+    // A frame that outgrows the block falls back to the heap for the rest
+    // of the frame, and the next reset() regrows the block to that frame's
+    // high-water mark, so in steady state the arena never touches the heap.
+    class FrameArena
+    {
+    public:
+        explicit FrameArena(std::size_t capacity = 1 << 20);
+
+        FrameArena(FrameArena const&) = delete;
+        FrameArena& operator=(FrameArena const&) = delete;
+
+        void* allocate(std::size_t bytes, std::size_t alignment);
+
+        // Uninitialised storage for count values.
+        template <typename T>
+        T* allocate(std::size_t count)
+        {
+            static_assert(std::is_trivially_destructible<T>::value,
+                "the arena never runs destructors");
+            return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+        }
+
+        // printf into the arena; the string lasts until the next reset.
+        const char* format(const char* fmt, ...);
+
+        void reset();
+
+        std::size_t used() const;
+        std::size_t capacity() const;
+
+        // Most bytes any frame since construction has used.
+        std::size_t highWater() const;
+
+        // Blocks taken from the heap because a frame outgrew the arena.
+        std::size_t overflows() const;
+
+    private:
+        std::unique_ptr<unsigned char[]> mBlock;
+        std::size_t mCapacity;
+        std::size_t mOffset;
+        std::size_t mHighWater;
+        std::size_t mOverflows;
+
+        // Overflow blocks of the current frame, freed on reset, and bytes
+        // handed out from them.
+        std::vector<std::unique_ptr<unsigned char[]>> mSpill;
+        std::size_t mSpilled;
+    };
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <atlas/math/Math.hpp>
+#include <atlas/gl/GL.hpp>
+
+namespace bstar
+{
+    // Uniform buffer holding the matrices shared by every geometry in a
+    // frame. It mirrors the Matrices block in UniformMatrices.glsl and is
+    // uploaded once per frame instead of once per draw.
+    class FrameUniforms
+    {
+    public:
+        static constexpr GLuint BindingPoint = 0;
+
+        FrameUniforms();
+        ~FrameUniforms();
+
+        FrameUniforms(FrameUniforms const&) = delete;
+        FrameUniforms& operator=(FrameUniforms const&) = delete;
+
+        void update(atlas::math::Matrix4 const& projection,
+            atlas::math::Matrix4 const& view);
+
+        // Points a freshly linked program's Matrices block at the buffer.
+        static void bindProgram(GLuint program);
+
+    private:
+        GLuint mBuffer;
+    };
+}
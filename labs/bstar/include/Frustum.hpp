@@ -0,0 +1,32 @@
+#pragma once
+
+#include <atlas/math/Math.hpp>
+
+#include <array>
+
+namespace bstar
+{
+    enum class Containment : int
+    {
+        Outside = 0,
+        Intersecting,
+        Inside
+    };
+
+    // The six clip planes of a projection * view * model matrix, in the
+    // space that matrix maps from. Planes are normalized, so distances are
+    // in model units and can be compared against radii directly.
+    class Frustum
+    {
+    public:
+        Frustum(atlas::math::Matrix4 const& clipFromModel);
+
+        bool intersectsSphere(atlas::math::Point const& centre,
+            float radius) const;
+        Containment classifyBox(atlas::math::Point const& min,
+            atlas::math::Point const& max) const;
+
+    private:
+        std::array<atlas::math::Vector4, 6> mPlanes;
+    };
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "ForceLaws.hpp"
+#include "Particles.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace bstar
+{
+    // Kick-drift-kick leapfrog with the direct-sum force folded into the
+    // integration. Targets are taken a block at a time; each block's
+    // accelerations are summed over every source and used straight away
+    // for the closing kick of this step and the opening kick and drift of
+    // the next, while the block is still in registers, so accelerations
+    // are never written out and read back.
+    //
+    // The next positions and half-step velocities are kept ahead of the
+    // particles, so the particles always hold a synchronised state. Any
+    // edit to the bodies invalidates that look-ahead; the next step then
+    // rebuilds it with one extra force evaluation.
+    class FusedLeapfrog
+    {
+    public:
+        // Targets per block; one AVX-512 or two AVX2 vectors of doubles.
+        static constexpr std::size_t Width = 8;
+
+        FusedLeapfrog();
+
+        void invalidate();
+        void step(Particles& particles, double dt, ForceLaw const& law);
+
+        // Follows a reorder of the particles so the look-ahead survives it.
+        void permute(std::vector<std::uint32_t> const& order);
+
+    private:
+        // With synchronise, closes the current step before opening the
+        // next; without, only opens one from the particles' state.
+        template <class Law>
+        void pass(Particles& particles, double dt, bool synchronise,
+            Law const& law);
+
+        bool mValid;
+        double mDt;
+        BodyArray mNextX, mNextY, mNextZ;
+        BodyArray mHalfVx, mHalfVy, mHalfVz;
+        BodyArray mScratch;
+    };
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atlas/gl/GL.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bstar
+{
+    // On-disk layout: this header, then vertexCount interleaved vertices of
+    // floatsPerVertex floats (position, normal, texture coordinate), then
+    // indexCount GLuint indices. Everything is 4-byte aligned, so the
+    // mapped file can be handed to bufferData as-is.
+    struct MeshBlobHeader
+    {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint32_t vertexCount;
+        std::uint32_t indexCount;
+        std::uint32_t floatsPerVertex;
+        std::uint32_t reserved[3];
+    };
+
+    class MeshBlob
+    {
+    public:
+        MeshBlob();
+        ~MeshBlob();
+
+        MeshBlob(MeshBlob const&) = delete;
+        MeshBlob& operator=(MeshBlob const&) = delete;
+
+        // Maps <objPath>.bin, converting the OBJ once if the blob is missing
+        // or older than the source.
+        bool load(std::string const& objPath);
+        void release();
+
+        float const* vertices() const;
+        GLuint const* indices() const;
+
+        std::size_t vertexCount() const;
+        std::size_t indexCount() const;
+        std::size_t vertexBytes() const;
+        std::size_t indexBytes() const;
+
+        static constexpr std::uint32_t Magic = 0x424d5342; // "BSMB"
+        static constexpr std::uint32_t Version = 1;
+        static constexpr std::uint32_t FloatsPerVertex = 8;
+
+    private:
+        bool map(std::string const& blobPath);
+        bool convert(std::string const& objPath, std::string const& blobPath);
+
+        MeshBlobHeader const* header() const;
+
+        void* mMapping;
+        std::size_t mMappingSize;
+
+        // Used instead of the mapping when the blob cannot be written out.
+        std::vector<char> mOwned;
+    };
+}
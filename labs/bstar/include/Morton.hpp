@@ -0,0 +1,165 @@
+#pragma once
+
+#include "StableArray.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bstar
+{
+    // 3D Morton (Z-order) codes with 21 bits per axis. Sorting by code puts
+    // the bodies of every octree cell in one contiguous range, with the
+    // cell's octant at each level given by successive 3-bit groups.
+    namespace morton
+    {
+        constexpr unsigned BitsPerAxis = 21;
+        constexpr std::uint32_t MaxCoordinate = (1u << BitsPerAxis) - 1;
+
+        // Spreads the low 21 bits of v so two zero bits follow each one.
+        inline std::uint64_t expandBits(std::uint32_t v)
+        {
+            std::uint64_t x = v & MaxCoordinate;
+            x = (x | (x << 32)) & 0x1f00000000ffffull;
+            x = (x | (x << 16)) & 0x1f0000ff0000ffull;
+            x = (x | (x << 8)) & 0x100f00f00f00f00full;
+            x = (x | (x << 4)) & 0x10c30c30c30c30c3ull;
+            x = (x | (x << 2)) & 0x1249249249249249ull;
+            return x;
+        }
+
+        inline std::uint64_t encode(std::uint32_t x, std::uint32_t y,
+            std::uint32_t z)
+        {
+            return expandBits(x) | (expandBits(y) << 1) |
+                (expandBits(z) << 2);
+        }
+
+        // Octant of a code at the given depth below the root, 0 to 7, with
+        // bit 0 for x, bit 1 for y and bit 2 for z.
+        inline unsigned octant(std::uint64_t code, unsigned depth)
+        {
+            return static_cast<unsigned>(
+                (code >> (3 * (BitsPerAxis - 1 - depth))) & 7);
+        }
+
+        // Quantises a coordinate inside [origin, origin + size] to the
+        // code grid.
+        inline std::uint32_t quantise(double value, double origin,
+            double size)
+        {
+            double t = (value - origin) / size;
+            if (!(t > 0.0))
+            {
+                return 0;
+            }
+
+            double scaled = t * static_cast<double>(MaxCoordinate + 1u);
+            return (scaled >= MaxCoordinate) ? MaxCoordinate :
+                static_cast<std::uint32_t>(scaled);
+        }
+
+        // Smallest cube around a set of points, slightly enlarged so the
+        // furthest point does not sit on its boundary.
+        struct Cube
+        {
+            double origin[3];
+            double size;
+        };
+
+        inline Cube boundingCube(BodyArray const& x, BodyArray const& y,
+            BodyArray const& z)
+        {
+            Cube cube = { { 0.0, 0.0, 0.0 }, 1.0 };
+            if (x.empty())
+            {
+                return cube;
+            }
+
+            double lo[3] = { x[0], y[0], z[0] };
+            double hi[3] = { x[0], y[0], z[0] };
+            for (std::size_t i = 1; i < x.size(); ++i)
+            {
+                lo[0] = std::min(lo[0], x[i]);
+                lo[1] = std::min(lo[1], y[i]);
+                lo[2] = std::min(lo[2], z[i]);
+                hi[0] = std::max(hi[0], x[i]);
+                hi[1] = std::max(hi[1], y[i]);
+                hi[2] = std::max(hi[2], z[i]);
+            }
+
+            double size = std::max(std::max(hi[0] - lo[0], hi[1] - lo[1]),
+                hi[2] - lo[2]);
+            cube.origin[0] = lo[0];
+            cube.origin[1] = lo[1];
+            cube.origin[2] = lo[2];
+            cube.size = std::max(size * (1.0 + 1e-9), 1e-12);
+            return cube;
+        }
+
+        inline void encodeAll(BodyArray const& x, BodyArray const& y,
+            BodyArray const& z, Cube const& cube,
+            std::vector<std::uint64_t>& codes)
+        {
+            codes.resize(x.size());
+            for (std::size_t i = 0; i < x.size(); ++i)
+            {
+                codes[i] = encode(
+                    quantise(x[i], cube.origin[0], cube.size),
+                    quantise(y[i], cube.origin[1], cube.size),
+                    quantise(z[i], cube.origin[2], cube.size));
+            }
+        }
+
+        // Stable LSD radix sort of codes, 8 bits per pass, carrying the
+        // original index of each code in order. Passes whose digit is the
+        // same for every code are skipped.
+        inline void radixSort(std::vector<std::uint64_t>& codes,
+            std::vector<std::uint32_t>& order,
+            std::vector<std::uint64_t>& codeScratch,
+            std::vector<std::uint32_t>& orderScratch)
+        {
+            std::size_t count = codes.size();
+            order.resize(count);
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                order[i] = static_cast<std::uint32_t>(i);
+            }
+            codeScratch.resize(count);
+            orderScratch.resize(count);
+
+            for (unsigned shift = 0; shift < 3 * BitsPerAxis; shift += 8)
+            {
+                std::array<std::size_t, 257> offsets;
+                offsets.fill(0);
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    ++offsets[((codes[i] >> shift) & 0xff) + 1];
+                }
+
+                if (count == 0 || offsets[((codes[0] >> shift) & 0xff) + 1] ==
+                    count)
+                {
+                    continue;
+                }
+
+                for (std::size_t d = 0; d < 256; ++d)
+                {
+                    offsets[d + 1] += offsets[d];
+                }
+
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    std::size_t to = offsets[(codes[i] >> shift) & 0xff]++;
+                    codeScratch[to] = codes[i];
+                    orderScratch[to] = order[i];
+                }
+
+                codes.swap(codeScratch);
+                order.swap(orderScratch);
+            }
+        }
+    }
+}
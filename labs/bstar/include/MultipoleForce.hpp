@@ -0,0 +1,120 @@
+#pragma once
+
+#include "ForceBackend.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace bstar
+{
+    // Fast multipole method on an octree built in Morton order. Each cell
+    // carries a Cartesian Taylor expansion of its bodies' potential up to
+    // the expansion order; well-separated pairs of cells interact through
+    // those expansions in both directions at once (cell-cell, Dehnen-style
+    // dual tree walk), everything closer falls back to the direct sum.
+    //
+    // The relative force error falls roughly as openingAngle^(order + 1),
+    // so order trades cost per interaction against accuracy while the
+    // total work stays O(N).
+    //
+    // Force terms and the force law apply in the direct near-field sums
+    // only. Terms fall off faster than the Newtonian pull and softened
+    // laws all but match it a few softening lengths out, so well-separated
+    // cells do without them.
+    class MultipoleForce : public ForceBackend
+    {
+    public:
+        static constexpr int MinOrder = 1;
+        static constexpr int MaxOrder = 8;
+        static constexpr std::size_t MaxTerms =
+            (MaxOrder + 1) * (MaxOrder + 2) * (MaxOrder + 3) / 6;
+
+        MultipoleForce();
+
+        void accelerations(BodyArray const& x, BodyArray const& y,
+            BodyArray const& z, BodyArray const& vx, BodyArray const& vy,
+            BodyArray const& vz, BodyArray const& mass, BodyArray& ax,
+            BodyArray& ay, BodyArray& az) override;
+
+        void setOrder(int order);
+        int order() const;
+
+        // Two cells interact through their expansions when the sum of their
+        // radii is below this fraction of the distance between centres.
+        void setOpeningAngle(double theta);
+        double openingAngle() const;
+
+        // Bodies per leaf before a cell is split.
+        void setLeafSize(std::size_t size);
+
+    private:
+        struct Cell
+        {
+            double centre[3];
+            double halfSize;
+            // Distance from the centre to the furthest body inside.
+            double radius;
+            std::uint32_t first;
+            std::uint32_t count;
+            std::uint32_t firstChild;
+            std::uint32_t childCount;
+        };
+
+        // One product term of an expansion operator:
+        // out[target] += sign * in[source] * factor[weight].
+        struct Term
+        {
+            std::uint16_t target;
+            std::uint16_t source;
+            std::uint16_t weight;
+            double sign;
+        };
+
+        void buildTables();
+        void sortBodies(BodyArray const& x, BodyArray const& y,
+            BodyArray const& z, BodyArray const& vx, BodyArray const& vy,
+            BodyArray const& vz, BodyArray const& mass);
+        void buildCell(std::uint32_t cell, unsigned depth);
+        void upwardPass(std::uint32_t cell);
+        void interact(std::uint32_t a, std::uint32_t b);
+        void interactSelf(std::uint32_t a);
+        void directPair(std::uint32_t a, std::uint32_t b);
+        void directSelf(std::uint32_t a);
+        PairArrays pairArrays();
+        void multipoleToLocal(std::uint32_t a, std::uint32_t b);
+        void downwardPass(std::uint32_t cell);
+
+        // Taylor monomials d^n / n! for every multi-index up to the order.
+        void monomials(double dx, double dy, double dz, double* out) const;
+        // Derivatives of 1/|r| for every multi-index up to the order.
+        void derivatives(double rx, double ry, double rz, double* out) const;
+
+        int mOrder;
+        double mOpeningAngle;
+        std::size_t mLeafSize;
+
+        // Multi-indices (nx, ny, nz) in order of total degree, and the
+        // operator tables built from them.
+        std::size_t mTerms;
+        std::vector<int> mPowers;
+        std::vector<int> mIndex;
+        std::vector<double> mParity;
+        std::vector<Term> mM2M;
+        std::vector<Term> mM2L;
+        std::vector<Term> mL2L;
+        std::vector<std::uint16_t> mGradient;
+
+        // Bodies in Morton order and the map back to the caller's order.
+        std::vector<std::uint64_t> mCodes;
+        std::vector<std::uint32_t> mOrderOf;
+        std::vector<std::uint64_t> mCodeScratch;
+        std::vector<std::uint32_t> mOrderScratch;
+        std::vector<double> mX, mY, mZ, mMass;
+        std::vector<double> mVx, mVy, mVz;
+        std::vector<double> mAx, mAy, mAz;
+
+        std::vector<Cell> mCells;
+        std::vector<double> mMultipoles;
+        std::vector<double> mLocals;
+    };
+}
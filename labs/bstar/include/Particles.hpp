@@ -0,0 +1,92 @@
+#pragma once
+
+#include "StableArray.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace bstar
+{
+    // Structure-of-arrays body storage. Live bodies are always packed at
+    // [0, size()), so every pass is a dense loop over contiguous arrays.
+    // Removal swaps the last body into the hole; bodies are addressed
+    // across removals by an id, and freed ids are recycled from a free
+    // list so the id table never grows past the peak body count.
+    //
+    // An id is a slot in that table plus the slot's generation, which
+    // moves on every time the slot is freed, so a handle kept past its
+    // body's removal is refused rather than finding whichever body took
+    // the slot over.
+    //
+    // Every array is a StableArray. reserve() takes address space for the
+    // largest expected run, and adding bodies up to it never moves or
+    // copies the arrays; past it they move, as vectors would.
+    class Particles
+    {
+    public:
+        using Id = std::uint32_t;
+        static constexpr Id InvalidId = std::numeric_limits<Id>::max();
+        static constexpr std::size_t InvalidIndex =
+            std::numeric_limits<std::size_t>::max();
+
+        // Up to SlotMask bodies, so no id is ever InvalidId; a slot's
+        // generation wraps after 256 reuses.
+        static constexpr unsigned SlotBits = 24;
+        static constexpr Id SlotMask = (Id(1) << SlotBits) - 1;
+
+        Particles();
+
+        // Reserves address space, not memory, so a generous capacity
+        // costs nothing until bodies are added.
+        void reserve(std::size_t capacity);
+        void clear();
+
+        // InvalidId, adding nothing, once SlotMask bodies are live.
+        Id add(double px, double py, double pz, double pvx, double pvy,
+            double pvz, double pmass, double pradius,
+            std::uint32_t pcolour);
+        void remove(std::size_t index);
+
+        // Reorders every array so the body at order[i] moves to index i.
+        // Ids follow their bodies.
+        void permute(std::vector<std::uint32_t> const& order);
+
+        std::size_t size() const;
+        std::size_t capacity() const;
+
+        Id id(std::size_t index) const;
+
+        // InvalidIndex for ids whose body has been removed.
+        std::size_t indexOf(Id id) const;
+
+        // Dense from 0 up to the peak body count, for tables keyed by id.
+        static std::size_t slotOf(Id id);
+
+        // Changes whenever bodies are added, removed or reordered, so
+        // copies of per-body data indexed like the arrays, such as the
+        // render instances, only need rebuilding when it moves.
+        std::uint64_t layoutVersion() const;
+
+        BodyArray x, y, z;
+        BodyArray vx, vy, vz;
+        BodyArray ax, ay, az;
+        BodyArray mass;
+        BodyArray radius;
+
+        // Packed 0xRRGGBBAA, only used for drawing.
+        StableArray<std::uint32_t> colour;
+
+    private:
+        StableArray<Id> mIds;
+        StableArray<std::size_t> mIndexOfSlot;
+        StableArray<Id> mSlotIds;
+        StableArray<Id> mFreeIds;
+        std::uint64_t mLayoutVersion;
+
+        BodyArray mScratch;
+        StableArray<std::uint32_t> mColourScratch;
+        StableArray<Id> mIdScratch;
+    };
+}
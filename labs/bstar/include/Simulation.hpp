@@ -0,0 +1,135 @@
+#pragma once
+
+#include "Particles.hpp"
+#include "Collisions.hpp"
+#include "ForceBackend.hpp"
+#include "MultipoleForce.hpp"
+#include "TiledForce.hpp"
+#include "FusedLeapfrog.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace bstar
+{
+    enum class Integrator : int
+    {
+        Euler = 0,
+        ImplicitEuler,
+        Verlet,
+        RungeKutta,
+        // Verlet with the force sum fused in; direct sum without force
+        // terms only, otherwise it runs as plain Verlet.
+        FusedVerlet
+    };
+
+    enum class ForceMethod : int
+    {
+        Direct = 0,
+        Multipole,
+        // The direct sum in cache-sized tiles, spread over threads.
+        Tiled
+    };
+
+    // Newtonian gravity over a set of bodies, advanced by one of the
+    // integrators and optionally merging bodies that collide.
+    class Simulation
+    {
+    public:
+        // Ids of the bodies created by reset(). Ids are handed out in
+        // order on an empty set and survive removals of other bodies.
+        static constexpr Particles::Id PlanetId = 0;
+        static constexpr Particles::Id FirstStarId = 1;
+        static constexpr Particles::Id SecondStarId = 2;
+
+        static constexpr double G = ForceBackend::G;
+
+        Simulation();
+
+        // Two equal stars on a circular orbit and a planet on a circular
+        // orbit around their centre of mass.
+        void reset();
+        void step(double dt);
+
+        Particles const& particles() const;
+        Particles& particles();
+
+        void setIntegrator(Integrator integrator);
+        Integrator integrator() const;
+
+        void setCollisions(bool enabled);
+        bool collisions() const;
+
+        // Changes a body's mass in place; its velocity is left alone.
+        void setMass(Particles::Id id, double mass);
+        double mass(Particles::Id id) const;
+
+        std::size_t merges() const;
+
+        // Gravity is evaluated by one of the force backends; the multipole
+        // one is approximate, with its accuracy set by the expansion order
+        // and opening angle.
+        void setForceMethod(ForceMethod method);
+        ForceMethod forceMethod() const;
+        MultipoleForce& multipoleForce();
+        TiledForce& tiledForce();
+
+        // Corrections to Newtonian gravity, applied by every backend.
+        void setForceTerms(ForceTerms const& terms);
+        ForceTerms const& forceTerms() const;
+
+        // How gravity falls off with distance, applied by every backend
+        // and the fused integrator.
+        void setForceLaw(ForceLaw const& law);
+        ForceLaw const& forceLaw() const;
+
+        // Every this many steps the bodies are reordered along a Morton
+        // curve so bodies close in space are close in memory; 0 disables
+        // it. Ids are unaffected, indices are not.
+        void setSortInterval(std::size_t steps);
+        std::size_t sortInterval() const;
+
+        // Acceleration of every body due to every other, evaluated at the
+        // given positions and velocities rather than the stored ones so
+        // multi-stage integrators can probe intermediate states.
+        void computeAccelerations(BodyArray const& x, BodyArray const& y,
+            BodyArray const& z, BodyArray const& vx, BodyArray const& vy,
+            BodyArray const& vz, BodyArray& ax, BodyArray& ay, BodyArray& az);
+
+    private:
+        void eulerStep(double dt);
+        void implicitEulerStep(double dt);
+        void verletStep(double dt);
+        void rk4Step(double dt);
+        void fusedVerletStep(double dt);
+
+        void updateAccelerations();
+        void sortBodies();
+
+        Particles mParticles;
+        Collisions mCollisions;
+        DirectForce mDirectForce;
+        MultipoleForce mMultipoleForce;
+        TiledForce mTiledForce;
+        FusedLeapfrog mFusedLeapfrog;
+        ForceMethod mForceMethod;
+        Integrator mIntegrator;
+        bool mCollisionsEnabled;
+        bool mAccelerationsValid;
+        std::size_t mMerges;
+        std::size_t mSortInterval;
+        std::size_t mStepsSinceSort;
+
+        // Start-of-step positions for the collision sweep, and stage
+        // storage for RK4.
+        BodyArray mX0, mY0, mZ0;
+        BodyArray mVx0, mVy0, mVz0;
+        BodyArray mSx, mSy, mSz;
+        BodyArray mSvx, mSvy, mSvz;
+        BodyArray mKx, mKy, mKz;
+        BodyArray mKvx, mKvy, mKvz;
+
+        std::vector<std::uint64_t> mSortCodes, mSortCodeScratch;
+        std::vector<std::uint32_t> mSortOrder, mSortOrderScratch;
+    };
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "Simulation.hpp"
+#include "SpscQueue.hpp"
+#include "TripleBuffer.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace bstar
+{
+    // What the render thread sees of the simulation after a step. Only the
+    // fields drawing and the GUI need are copied, in single precision.
+    struct SimulationState
+    {
+        SimulationState() :
+            layout(0),
+            namedMasses(),
+            steps(0),
+            resets(0),
+            merges(0)
+        { }
+
+        std::vector<float> x, y, z;
+        std::vector<float> radius;
+        std::vector<std::uint32_t> colour;
+
+        // Bodies are published in memory order, which changes whenever the
+        // simulation re-sorts them; ids identify them across states.
+        std::vector<Particles::Id> ids;
+
+        // The particles' layout version. Radii, colours and ids only change
+        // with it, so they are copied, and read, only when it moves.
+        std::uint64_t layout;
+
+        // Masses of the bodies reset() creates, or 0 once merged away.
+        std::array<double, 3> namedMasses;
+
+        // Steps since the last reset, and how many resets there have been,
+        // so the reader can tell a new run from an old one.
+        std::uint64_t steps;
+        std::uint64_t resets;
+        std::size_t merges;
+    };
+
+    enum class SimulationCommand : int
+    {
+        SetPlaying = 0,
+        SetRate,
+        SetIntegrator,
+        SetCollisions,
+        SetMass,
+        SetForceMethod,
+        SetExpansionOrder,
+        SetOpeningAngle,
+        SetForceThreads,
+        SetSortInterval,
+        SetPostNewtonian,
+        SetSpeedOfLight,
+        SetForceLaw,
+        SetSoftening,
+        Reset
+    };
+
+    struct SimulationMessage
+    {
+        SimulationCommand command;
+        Particles::Id id;
+        double value;
+    };
+
+    // Runs a Simulation on its own thread at a fixed step rate. The render
+    // thread sends edits through a command queue and picks up finished
+    // states from a triple buffer, so neither thread ever waits on the
+    // other.
+    class SimulationThread
+    {
+    public:
+        SimulationThread();
+        ~SimulationThread();
+
+        SimulationThread(SimulationThread const&) = delete;
+        SimulationThread& operator=(SimulationThread const&) = delete;
+
+        // Render thread only. Never drops a command. While the simulation
+        // thread is busy in a long step and the queue is full, commands
+        // wait in a backlog that keeps only the latest value of each
+        // setting, and go out from later sends and acquires.
+        void send(SimulationCommand command, double value = 0.0,
+            Particles::Id id = Particles::InvalidId);
+
+        // Render thread only. Returns true if a newer state is available
+        // through state().
+        bool acquire();
+        SimulationState const& state() const;
+
+    private:
+        void run();
+        void apply(SimulationMessage const& message);
+        void publish();
+        void flushBacklog();
+
+        Simulation mSimulation;
+        bool mPlaying;
+        double mRate;
+        std::uint64_t mSteps;
+        std::uint64_t mResets;
+
+        SpscQueue<SimulationMessage, 256> mCommands;
+        std::vector<SimulationMessage> mBacklog;
+        TripleBuffer<SimulationState> mStates;
+
+        std::atomic<bool> mRunning;
+        std::thread mThread;
+    };
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atlas/gl/GL.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace bstar
+{
+    // Several tessellations of the unit sphere packed into one vertex and
+    // one index array, finest first. Vertices use the same interleaved
+    // position, normal, texture coordinate layout as the mesh blobs.
+    class SphereLod
+    {
+    public:
+        struct Level
+        {
+            GLsizei indexCount;
+            std::size_t firstIndex;
+            GLint baseVertex;
+        };
+
+        void addMesh(float const* vertices, std::size_t vertexCount,
+            GLuint const* indices, std::size_t indexCount);
+        void addUvSphere(int slices, int stacks);
+
+        std::size_t levelCount() const;
+        Level const& level(std::size_t index) const;
+
+        std::vector<float> const& vertices() const;
+        std::vector<GLuint> const& indices() const;
+
+        static constexpr std::size_t FloatsPerVertex = 8;
+
+    private:
+        std::vector<float> mVertices;
+        std::vector<GLuint> mIndices;
+        std::vector<Level> mLevels;
+    };
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace bstar
+{
+    // Fixed-size single-producer, single-consumer ring. Neither side
+    // blocks: push fails when the ring is full and pop when it is empty.
+    template <typename T, std::size_t Capacity>
+    class SpscQueue
+    {
+    public:
+        static_assert((Capacity & (Capacity - 1)) == 0,
+            "capacity must be a power of two");
+
+        SpscQueue() :
+            mHead(0),
+            mTail(0)
+        { }
+
+        SpscQueue(SpscQueue const&) = delete;
+        SpscQueue& operator=(SpscQueue const&) = delete;
+
+        bool push(T const& item)
+        {
+            std::size_t tail = mTail.load(std::memory_order_relaxed);
+            if (tail - mHead.load(std::memory_order_acquire) == Capacity)
+            {
+                return false;
+            }
+
+            mItems[tail & (Capacity - 1)] = item;
+            mTail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(T& item)
+        {
+            std::size_t head = mHead.load(std::memory_order_relaxed);
+            if (head == mTail.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+
+            item = mItems[head & (Capacity - 1)];
+            mHead.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        std::array<T, Capacity> mItems;
+
+        // Padded apart so the two threads do not contend for one cache
+        // line. Padding rather than alignas keeps the queue safe to embed
+        // in heap-allocated objects before C++17's aligned new.
+        std::atomic<std::size_t> mHead;
+        char mPadding[64 - sizeof(std::atomic<std::size_t>)];
+        std::atomic<std::size_t> mTail;
+    };
+}
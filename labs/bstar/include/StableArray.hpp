@@ -0,0 +1,320 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+namespace bstar
+{
+    // Page-granular virtual memory, for arrays that grow in place.
+    namespace addressspace
+    {
+        std::size_t pageSize();
+
+        // Reserves bytes of address space with nothing behind it. Throws
+        // std::bad_alloc when the reservation fails.
+        void* reserve(std::size_t bytes);
+
+        // Backs a page-aligned range of a reservation with zeroed memory.
+        void commit(void* start, std::size_t bytes);
+
+        void release(void* start, std::size_t bytes);
+    }
+
+    // A contiguous array that only moves when it outgrows its reservation
+    // of address space. Growing within the reservation commits more of it
+    // in place, so nothing is copied and pointers into the array stay
+    // valid; outgrowing it moves the array to a reservation twice the
+    // size, as a vector would. reserveStable() sets the reservation up
+    // front without committing memory, so long-lived arrays can be made
+    // stable for a whole run at the cost of address space alone, while
+    // scratch arrays only ever reserve what they use.
+    //
+    // Pages are committed whole, which keeps every array page-aligned and
+    // its capacity whole cache lines.
+    template <typename T>
+    class StableArray
+    {
+    public:
+        static_assert(std::is_trivially_copyable<T>::value,
+            "elements are copied as raw memory");
+
+        using value_type = T;
+        using size_type = std::size_t;
+        using iterator = T*;
+        using const_iterator = T const*;
+
+        StableArray() :
+            mData(nullptr),
+            mSize(0),
+            mCommitted(0),
+            mReserved(0)
+        { }
+
+        StableArray(StableArray const& other) :
+            StableArray()
+        {
+            assign(other.begin(), other.end());
+        }
+
+        StableArray(StableArray&& other) noexcept :
+            StableArray()
+        {
+            swap(other);
+        }
+
+        ~StableArray()
+        {
+            if (mData != nullptr)
+            {
+                addressspace::release(mData, mReserved);
+            }
+        }
+
+        StableArray& operator=(StableArray const& other)
+        {
+            if (this != &other)
+            {
+                assign(other.begin(), other.end());
+            }
+            return *this;
+        }
+
+        StableArray& operator=(StableArray&& other) noexcept
+        {
+            swap(other);
+            return *this;
+        }
+
+        // Takes address space for count elements without committing any
+        // of it, so growing to count never moves the array. Moves it now
+        // if its reservation is smaller.
+        void reserveStable(std::size_t count)
+        {
+            if (count > reservation())
+            {
+                relocate(count);
+            }
+        }
+
+        void reserve(std::size_t count)
+        {
+            if (count <= capacity())
+            {
+                return;
+            }
+
+            if (count > reservation())
+            {
+                relocate(std::max(count, 2 * reservation()));
+            }
+
+            std::size_t bytes = pageBytes(count);
+            addressspace::commit(
+                reinterpret_cast<char*>(mData) + mCommitted,
+                bytes - mCommitted);
+            mCommitted = bytes;
+        }
+
+        void resize(std::size_t count, T const& value = T())
+        {
+            reserve(count);
+            if (count > mSize)
+            {
+                std::fill(mData + mSize, mData + count, value);
+            }
+            mSize = count;
+        }
+
+        void assign(std::size_t count, T const& value)
+        {
+            reserve(count);
+            std::fill(mData, mData + count, value);
+            mSize = count;
+        }
+
+        template <typename Iterator>
+        void assign(Iterator first, Iterator last)
+        {
+            auto count = static_cast<std::size_t>(std::distance(first, last));
+            reserve(count);
+            std::copy(first, last, mData);
+            mSize = count;
+        }
+
+        void push_back(T const& value)
+        {
+            if (mSize == capacity())
+            {
+                // Committing is cheap but still a system call, so take
+                // more than one element's worth at a time, without
+                // leaving the reservation while it still has room.
+                std::size_t count = std::max<std::size_t>(2 * mSize, 1);
+                if (mSize < reservation())
+                {
+                    count = std::min(count, reservation());
+                }
+                reserve(count);
+            }
+            mData[mSize++] = value;
+        }
+
+        void pop_back()
+        {
+            --mSize;
+        }
+
+        // Keeps the committed memory for the next growth.
+        void clear()
+        {
+            mSize = 0;
+        }
+
+        void swap(StableArray& other) noexcept
+        {
+            std::swap(mData, other.mData);
+            std::swap(mSize, other.mSize);
+            std::swap(mCommitted, other.mCommitted);
+            std::swap(mReserved, other.mReserved);
+        }
+
+        std::size_t size() const
+        {
+            return mSize;
+        }
+
+        std::size_t capacity() const
+        {
+            return mCommitted / sizeof(T);
+        }
+
+        // Elements the array can grow to without moving.
+        std::size_t reservation() const
+        {
+            return mReserved / sizeof(T);
+        }
+
+        bool empty() const
+        {
+            return mSize == 0;
+        }
+
+        T* data()
+        {
+            return mData;
+        }
+
+        T const* data() const
+        {
+            return mData;
+        }
+
+        T& operator[](std::size_t index)
+        {
+            return mData[index];
+        }
+
+        T const& operator[](std::size_t index) const
+        {
+            return mData[index];
+        }
+
+        T& front()
+        {
+            return mData[0];
+        }
+
+        T const& front() const
+        {
+            return mData[0];
+        }
+
+        T& back()
+        {
+            return mData[mSize - 1];
+        }
+
+        T const& back() const
+        {
+            return mData[mSize - 1];
+        }
+
+        iterator begin()
+        {
+            return mData;
+        }
+
+        const_iterator begin() const
+        {
+            return mData;
+        }
+
+        iterator end()
+        {
+            return mData + mSize;
+        }
+
+        const_iterator end() const
+        {
+            return mData + mSize;
+        }
+
+    private:
+        static std::size_t pageBytes(std::size_t count)
+        {
+            if (count > std::numeric_limits<std::size_t>::max() /
+                (2 * sizeof(T)))
+            {
+                throw std::length_error("StableArray is too large");
+            }
+
+            std::size_t page = addressspace::pageSize();
+            return (count * sizeof(T) + page - 1) / page * page;
+        }
+
+        // Moves the array, and what it has committed, into a new
+        // reservation of at least count elements.
+        void relocate(std::size_t count)
+        {
+            std::size_t reserved = pageBytes(count);
+            T* data = static_cast<T*>(addressspace::reserve(reserved));
+            try
+            {
+                addressspace::commit(data, mCommitted);
+            }
+            catch (...)
+            {
+                addressspace::release(data, reserved);
+                throw;
+            }
+
+            if (mData != nullptr)
+            {
+                std::copy(mData, mData + mSize, data);
+                addressspace::release(mData, mReserved);
+            }
+            mData = data;
+            mReserved = reserved;
+        }
+
+        T* mData;
+        std::size_t mSize;
+        std::size_t mCommitted;
+        std::size_t mReserved;
+    };
+
+    template <typename T>
+    void swap(StableArray<T>& a, StableArray<T>& b) noexcept
+    {
+        a.swap(b);
+    }
+
+    // Per-body values, as stored by Particles and passed to the force
+    // backends.
+    using BodyArray = StableArray<double>;
+}
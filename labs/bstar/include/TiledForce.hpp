@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ForceBackend.hpp"
+#include "WorkerPool.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace bstar
+{
+    // The exact pairwise sum, cut into tiles of bodies. Each pair of tiles
+    // is summed with both tiles' positions, masses and accelerations held
+    // in L1, and every pair pushes both of its bodies, so each pair is
+    // visited once. The inner loop runs over a source tile and vectorizes.
+    //
+    // Tile pairs are handed out to threads as they become free. Each
+    // thread accumulates into its own buffers, which are added up once
+    // every pair is done, so no two threads ever write the same body.
+    class TiledForce : public ForceBackend
+    {
+    public:
+        // Two tiles' bodies and sums take 14 KiB.
+        static constexpr std::size_t TileSize = 128;
+
+        // Below this many bodies waking the workers costs more than they
+        // save, and the sum stays on the calling thread.
+        static constexpr std::size_t MinParallelBodies = 1024;
+
+        TiledForce();
+
+        void accelerations(BodyArray const& x, BodyArray const& y,
+            BodyArray const& z, BodyArray const& vx, BodyArray const& vy,
+            BodyArray const& vz, BodyArray const& mass, BodyArray& ax,
+            BodyArray& ay, BodyArray& az) override;
+
+        // Threads to sum with, the calling one included; 0 uses one per
+        // hardware thread.
+        void setThreads(std::size_t threads);
+        std::size_t threads() const;
+
+    private:
+        template <class Law, class Term>
+        void sumTiles(PairArrays const& bodies, std::size_t count,
+            Law const& law, Term const& term);
+
+        std::size_t mThreads;
+        std::unique_ptr<WorkerPool> mPool;
+
+        // Every (target, source) tile pair with target <= source.
+        std::vector<std::uint32_t> mTileFirst;
+        std::vector<std::uint32_t> mTileSecond;
+        std::atomic<std::size_t> mNextPair;
+
+        // Accumulators for threads other than the calling one, which sums
+        // straight into the output.
+        std::vector<BodyArray> mSumX, mSumY, mSumZ;
+    };
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atlas/math/Math.hpp>
+#include <atlas/gl/GL.hpp>
+
+#include <vector>
+
+namespace bstar
+{
+    // Fixed-length position history for every body, kept in one GPU ring
+    // buffer read through a buffer texture. Rows are time steps, so the
+    // positions recorded in one step are contiguous and a step uploads N
+    // points regardless of the trail length.
+    //
+    // A point's w tags the body it belongs to within its column. The trail
+    // shader only joins points tagged like the column's newest one, so a
+    // column taken over by another body starts a new trail without the
+    // old history being erased, and a tag of 0 marks an empty column.
+    class TrailBuffer
+    {
+    public:
+        TrailBuffer();
+        ~TrailBuffer();
+
+        TrailBuffer(TrailBuffer const&) = delete;
+        TrailBuffer& operator=(TrailBuffer const&) = delete;
+
+        // Both drop the recorded history.
+        void setCapacity(std::size_t capacity);
+        void clear();
+
+        // A change in the number of columns also starts the trails over.
+        void push(std::vector<atlas::math::Vector4> const& points);
+
+        // Sends the rows pushed since the last upload.
+        void upload();
+        void bindTexture(GLenum unit) const;
+
+        std::size_t bodies() const;
+        std::size_t capacity() const;
+        std::size_t count() const;
+        std::size_t oldest() const;
+
+    private:
+        void reset(std::size_t bodies);
+
+        GLuint mBuffer;
+        GLuint mTexture;
+
+        std::size_t mBodies;
+        std::size_t mRequested;
+        std::size_t mCapacity;
+        std::size_t mHead;
+        std::size_t mCount;
+
+        std::vector<atlas::math::Vector4> mPending;
+        std::size_t mPendingRows;
+    };
+}
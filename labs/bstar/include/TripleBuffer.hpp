@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+namespace bstar
+{
+    // Hands complete values from one writer thread to one reader thread
+    // without either ever waiting. The writer fills its private slot and
+    // swaps it with the shared middle slot; the reader swaps the middle
+    // slot with its own only when the writer has published since. Slots
+    // are reused, so values holding vectors stop allocating once they
+    // have grown.
+    template <typename T>
+    class TripleBuffer
+    {
+    public:
+        TripleBuffer() :
+            mMiddle(1),
+            mWrite(0),
+            mRead(2)
+        { }
+
+        TripleBuffer(TripleBuffer const&) = delete;
+        TripleBuffer& operator=(TripleBuffer const&) = delete;
+
+        // Writer side.
+        T& writeBuffer()
+        {
+            return mSlots[mWrite];
+        }
+
+        void publish()
+        {
+            mWrite = mMiddle.exchange(mWrite | FreshBit,
+                std::memory_order_acq_rel) & IndexMask;
+        }
+
+        // Reader side. Returns true if a newer value is now readable.
+        bool acquire()
+        {
+            if ((mMiddle.load(std::memory_order_relaxed) & FreshBit) == 0)
+            {
+                return false;
+            }
+
+            mRead = mMiddle.exchange(mRead, std::memory_order_acq_rel) &
+                IndexMask;
+            return true;
+        }
+
+        T const& readBuffer() const
+        {
+            return mSlots[mRead];
+        }
+
+    private:
+        static constexpr unsigned IndexMask = 3;
+        static constexpr unsigned FreshBit = 4;
+
+        std::array<T, 3> mSlots;
+        std::atomic<unsigned> mMiddle;
+        unsigned mWrite;
+        unsigned mRead;
+    };
+}
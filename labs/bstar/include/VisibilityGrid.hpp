@@ -0,0 +1,51 @@
+#pragma once
+
+#include "BodyInstance.hpp"
+#include "Frustum.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace bstar
+{
+    // Uniform grid over the instance centres, rebuilt every frame since
+    // bodies move. Whole cells are accepted or rejected against the
+    // frustum, so only cells cut by a frustum plane test their bodies one
+    // by one.
+    class VisibilityGrid
+    {
+    public:
+        VisibilityGrid();
+
+        void build(std::vector<BodyInstance> const& instances);
+
+        // Appends the indices of every instance whose bounding sphere
+        // touches the frustum.
+        void query(Frustum const& frustum,
+            std::vector<std::uint32_t>& visible) const;
+
+        std::size_t occupiedCells() const;
+
+        // Aim for roughly this many bodies in every occupied cell.
+        static constexpr std::size_t BodiesPerCell = 16;
+        static constexpr int MaxResolution = 64;
+
+    private:
+        std::vector<BodyInstance> const* mInstances;
+
+        int mResolution;
+        atlas::math::Point mMin;
+        float mInvCellSize;
+
+        // Bodies sorted by cell, with mCellStart[c] .. mCellStart[c + 1]
+        // the range of cell c. Occupied cells also keep the bounds of
+        // their bodies' spheres, which can spill past the cell itself.
+        std::vector<std::uint32_t> mCellStart;
+        std::vector<std::uint32_t> mCursor;
+        std::vector<std::uint32_t> mItems;
+        std::vector<std::uint32_t> mItemCells;
+        std::vector<std::uint32_t> mOccupied;
+        std::vector<atlas::math::Point> mCellMin;
+        std::vector<atlas::math::Point> mCellMax;
+    };
+}
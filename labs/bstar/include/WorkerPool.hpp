@@ -0,0 +1,56 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bstar
+{
+    // A fixed set of threads that run one job at a time, all of them at
+    // once. The calling thread takes part as thread 0, so a pool of one
+    // spawns nothing. Workers sleep between jobs rather than spinning, so
+    // an idle pool costs nothing but its stacks.
+    class WorkerPool
+    {
+    public:
+        explicit WorkerPool(std::size_t threads);
+        ~WorkerPool();
+
+        WorkerPool(WorkerPool const&) = delete;
+        WorkerPool& operator=(WorkerPool const&) = delete;
+
+        std::size_t size() const;
+
+        // Calls job(thread) once on every thread, thread in [0, size()),
+        // and returns once all of them have finished. The job is passed
+        // by pointer rather than wrapped in a std::function, which would
+        // allocate for any lambda capturing more than a pointer or two.
+        template <class Job>
+        void run(Job const& job)
+        {
+            runErased(&job, [](void const* erased, std::size_t thread)
+            {
+                (*static_cast<Job const*>(erased))(thread);
+            });
+        }
+
+    private:
+        using Call = void (*)(void const*, std::size_t);
+
+        void runErased(void const* job, Call call);
+        void work(std::size_t thread);
+
+        std::vector<std::thread> mThreads;
+
+        std::mutex mMutex;
+        std::condition_variable mStart;
+        std::condition_variable mDone;
+        void const* mJob;
+        Call mCall;
+        std::uint64_t mGeneration;
+        std::size_t mPending;
+        bool mStopping;
+    };
+}
@@ -7,10 +7,9 @@ in VertexData
     vec3 eyeDirection;
     vec3 lightDirection;
     vec3 lightPosition;
+    vec3 colour;
 } inData;
 
-uniform vec3 materialColour;
-
 out vec4 fragColour;
 
 vec3 shadedColour()
@@ -18,7 +17,7 @@ vec3 shadedColour()
     vec3 lightColour = vec3(1, 1, 1);
     float lightPower = 100.0;
 
-    vec3 materialDiffuseColour = materialColour;
+    vec3 materialDiffuseColour = inData.colour;
     vec3 materialAmbientColour = vec3(0.5, 0.5, 0.5) * materialDiffuseColour;
     vec3 materialSpecularColour = vec3(0.3, 0.3, 0.3);
 
@@ -5,6 +5,10 @@ layout(location = VERTICES_LAYOUT_LOCATION) in vec3 position;
 layout(location = NORMALS_LAYOUT_LOCATION) in vec3 normal;
 layout(location = TEXTURES_LAYOUT_LOCATION) in vec2 tex;
 
+// Per instance: centre in xyz and radius in w.
+layout(location = INSTANCE_SPHERE_LAYOUT_LOCATION) in vec4 sphere;
+layout(location = INSTANCE_COLOUR_LAYOUT_LOCATION) in vec4 colour;
+
 out VertexData
 {
     vec3 position;
@@ -12,17 +16,19 @@ out VertexData
     vec3 eyeDirection;
     vec3 lightDirection;
     vec3 lightPosition;
+    vec3 colour;
 } outData;
 
 #include "UniformMatrices.glsl"
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(position, 1.0);
+    vec4 worldPos = model * vec4(sphere.xyz + sphere.w * position, 1.0);
+    gl_Position = projection * view * worldPos;
 
-    outData.position = (model * vec4(position, 1.0)).xyz;
+    outData.position = worldPos.xyz;
 
-    vec3 vertexPos = (view * model * vec4(position, 1.0)).xyz;
+    vec3 vertexPos = (view * worldPos).xyz;
     outData.eyeDirection = vec3(0, 0, 0) - vertexPos;
 
     outData.lightPosition = vec3(0, 5, 0);
@@ -30,5 +36,5 @@ void main()
     outData.lightDirection = lightPos + outData.eyeDirection;
 
     outData.normal = (inverse(transpose(view * model)) * vec4(normal, 0)).xyz;
+    outData.colour = colour.rgb;
 }
-
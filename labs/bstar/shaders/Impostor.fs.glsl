@@ -0,0 +1,63 @@
+#version 330 core
+
+in ImpostorData
+{
+    vec3 centre;
+    float radius;
+    vec3 lightPosition;
+    vec3 colour;
+} inData;
+
+#include "UniformMatrices.glsl"
+
+out vec4 fragColour;
+
+// Same lighting as Body.fs.glsl, evaluated in view space on the ray-cast
+// surface point instead of an interpolated vertex.
+vec3 shadedColour(vec3 position, vec3 n)
+{
+    vec3 lightColour = vec3(1, 1, 1);
+    float lightPower = 100.0;
+
+    vec3 materialDiffuseColour = inData.colour;
+    vec3 materialAmbientColour = vec3(0.5, 0.5, 0.5) * materialDiffuseColour;
+    vec3 materialSpecularColour = vec3(0.3, 0.3, 0.3);
+
+    float dist = length(inData.lightPosition - position);
+
+    vec3 E = normalize(-position);
+    vec3 l = normalize(inData.lightPosition - position);
+    float cosTheta = clamp(dot(n, l), 0, 1);
+
+    vec3 R = reflect(-l, n);
+    float cosAlpha = clamp(dot(E, R), 0, 1);
+
+    return materialAmbientColour +
+        materialDiffuseColour * lightColour * lightPower *
+        cosTheta / (dist * dist) +
+        materialSpecularColour * lightColour * lightPower * pow(cosAlpha, 5) /
+        (dist * dist);
+}
+
+void main()
+{
+    // Point coordinates run top to bottom.
+    vec2 p = gl_PointCoord * 2.0 - 1.0;
+    p.y = -p.y;
+
+    float r2 = dot(p, p);
+    if (r2 > 1.0)
+    {
+        discard;
+    }
+
+    // The sprites are only a few pixels across, so treating the projection
+    // as orthographic over one of them is not visible.
+    vec3 n = vec3(p, sqrt(1.0 - r2));
+    vec3 position = inData.centre + inData.radius * n;
+
+    vec4 clip = projection * vec4(position, 1.0);
+    gl_FragDepth = 0.5 * (clip.z / clip.w) + 0.5;
+
+    fragColour = vec4(shadedColour(position, n), 1.0);
+}
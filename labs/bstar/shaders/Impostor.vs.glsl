@@ -0,0 +1,37 @@
+#version 330 core
+
+#include "LayoutLocations.glsl"
+// Impostors are drawn as points, one vertex per body.
+layout(location = INSTANCE_SPHERE_LAYOUT_LOCATION) in vec4 sphere;
+layout(location = INSTANCE_COLOUR_LAYOUT_LOCATION) in vec4 colour;
+
+out ImpostorData
+{
+    vec3 centre;
+    float radius;
+    vec3 lightPosition;
+    vec3 colour;
+} outData;
+
+#include "UniformMatrices.glsl"
+
+uniform float viewportHeight;
+
+void main()
+{
+    vec4 centre = view * model * vec4(sphere.xyz, 1.0);
+    float radius = sphere.w * length(model[0].xyz);
+
+    gl_Position = projection * centre;
+
+    // Cover the sphere's projected diameter, plus a pixel so the silhouette
+    // is not clipped by rounding.
+    float pixels = radius * projection[1][1] * viewportHeight /
+        max(-centre.z, radius);
+    gl_PointSize = pixels + 1.0;
+
+    outData.centre = centre.xyz;
+    outData.radius = radius;
+    outData.lightPosition = (view * vec4(0, 5, 0, 1)).xyz;
+    outData.colour = colour.rgb;
+}
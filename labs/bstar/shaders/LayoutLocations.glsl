@@ -4,5 +4,7 @@
 #define VERTICES_LAYOUT_LOCATION 0
 #define NORMALS_LAYOUT_LOCATION 1
 #define TEXTURES_LAYOUT_LOCATION 2
+#define INSTANCE_SPHERE_LAYOUT_LOCATION 3
+#define INSTANCE_COLOUR_LAYOUT_LOCATION 4
 
 #endif
@@ -0,0 +1,19 @@
+#version 330 core
+
+in float fade;
+in float current;
+
+uniform vec3 colour;
+
+out vec4 fragColour;
+
+void main()
+{
+    // Interpolating between two 1s need not give exactly 1.
+    if (current < 0.99)
+    {
+        discard;
+    }
+
+    fragColour = vec4(colour, fade);
+}
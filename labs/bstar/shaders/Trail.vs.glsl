@@ -0,0 +1,31 @@
+#version 330 core
+
+// One instance per id slot, one vertex per recorded step. Rows of the trail
+// buffer are time steps, so a slot's history is strided by the slot count.
+uniform samplerBuffer trail;
+uniform int bodies;
+uniform int capacity;
+uniform int oldest;
+uniform int points;
+
+out float fade;
+out float current;
+
+#include "UniformMatrices.glsl"
+
+void main()
+{
+    int row = (oldest + gl_VertexID) % capacity;
+    int newest = (oldest + points - 1) % capacity;
+    vec4 position = texelFetch(trail, row * bodies + gl_InstanceID);
+    float tag = texelFetch(trail, newest * bodies + gl_InstanceID).w;
+
+    gl_Position = projection * view * model * vec4(position.xyz, 1.0);
+
+    // Oldest points fade out completely.
+    fade = float(gl_VertexID + 1) / float(points);
+
+    // Points left by an earlier body in this column, or by none, are not
+    // part of the trail; a segment touching one is dropped whole.
+    current = (tag != 0.0 && position.w == tag) ? 1.0 : 0.0;
+}
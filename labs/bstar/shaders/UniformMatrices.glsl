@@ -1,8 +1,12 @@
 #ifndef UNIFORM_MATRICES_GLSL
 #define UNIFORM_MATRICES_GLSL
 
-uniform mat4 projection;
-uniform mat4 view;
+layout(std140) uniform Matrices
+{
+    mat4 projection;
+    mat4 view;
+};
+
 uniform mat4 model;
 
 #endif
@@ -0,0 +1,128 @@
+#include "AllocationCounter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace bstar
+{
+    namespace
+    {
+        // Constant-initialised, so they count allocations made during
+        // static initialisation too.
+        std::atomic<std::uint64_t> allocationCount(0);
+        std::atomic<std::uint64_t> allocationBytes(0);
+        thread_local std::uint64_t threadAllocationCount = 0;
+    }
+
+    namespace allocations
+    {
+        std::uint64_t thisThread()
+        {
+            return threadAllocationCount;
+        }
+
+        std::uint64_t total()
+        {
+            return allocationCount.load(std::memory_order_relaxed);
+        }
+
+        std::uint64_t totalBytes()
+        {
+            return allocationBytes.load(std::memory_order_relaxed);
+        }
+    }
+
+    namespace
+    {
+        void* countedAllocate(std::size_t size)
+        {
+            ++threadAllocationCount;
+            allocationCount.fetch_add(1, std::memory_order_relaxed);
+            allocationBytes.fetch_add(size, std::memory_order_relaxed);
+
+            if (size == 0)
+            {
+                size = 1;
+            }
+
+            for (;;)
+            {
+                void* memory = std::malloc(size);
+                if (memory != nullptr)
+                {
+                    return memory;
+                }
+
+                std::new_handler handler = std::get_new_handler();
+                if (handler == nullptr)
+                {
+                    throw std::bad_alloc();
+                }
+                handler();
+            }
+        }
+
+        void* countedAllocate(std::size_t size, std::nothrow_t const&)
+        {
+            try
+            {
+                return countedAllocate(size);
+            }
+            catch (std::bad_alloc const&)
+            {
+                return nullptr;
+            }
+        }
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    return bstar::countedAllocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return bstar::countedAllocate(size);
+}
+
+void* operator new(std::size_t size, std::nothrow_t const& tag) noexcept
+{
+    return bstar::countedAllocate(size, tag);
+}
+
+void* operator new[](std::size_t size, std::nothrow_t const& tag) noexcept
+{
+    return bstar::countedAllocate(size, tag);
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::nothrow_t const&) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::nothrow_t const&) noexcept
+{
+    std::free(memory);
+}
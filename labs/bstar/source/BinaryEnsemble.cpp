@@ -0,0 +1,104 @@
+#include "BinaryEnsemble.hpp"
+#include "EnsembleKernel.hpp"
+
+#include <algorithm>
+
+namespace bstar
+{
+    // Bound by reference in std::min, so it needs a definition.
+    constexpr std::size_t BinaryEnsemble::Width;
+
+    BinaryEnsemble::BinaryEnsemble() :
+        mDeterministic(false),
+        mCount(0),
+        mDt(0.0)
+    { }
+
+    void BinaryEnsemble::setClassifier(ClassifierSettings const& settings)
+    {
+        mSettings = settings;
+    }
+
+    void BinaryEnsemble::setDeterministic(bool deterministic)
+    {
+        mDeterministic = deterministic;
+    }
+
+    void BinaryEnsemble::setup(SystemParameters const* params,
+        std::size_t count)
+    {
+        mCount = count;
+        mBlocks.assign((count + Width - 1) / Width, Block());
+        for (std::size_t b = 0; b < mBlocks.size(); ++b)
+        {
+            if (mDeterministic)
+            {
+                setupBlockStrict(mBlocks[b], params, b * Width, count);
+            }
+            else
+            {
+                setupBlock(mBlocks[b], params, b * Width, count);
+            }
+        }
+    }
+
+    void BinaryEnsemble::run(double dt, std::size_t steps,
+        std::uint64_t* stepHashes)
+    {
+        mDt = dt;
+
+        // A block is a few kilobytes, so running all its steps before
+        // moving on keeps it in L1 throughout.
+        for (auto& block : mBlocks)
+        {
+            if (mDeterministic)
+            {
+                runBlockStrict(block, mSettings, dt, steps, stepHashes);
+            }
+            else
+            {
+                runBlock(block, mSettings, dt, steps, stepHashes);
+            }
+        }
+    }
+
+    std::size_t BinaryEnsemble::size() const
+    {
+        return mCount;
+    }
+
+    void BinaryEnsemble::results(SystemResult* out) const
+    {
+        for (std::size_t b = 0; b < mBlocks.size(); ++b)
+        {
+            Block const& block = mBlocks[b];
+            std::size_t lanes = std::min(Width, mCount - b * Width);
+            for (std::size_t w = 0; w < lanes; ++w)
+            {
+                SystemResult& r = out[b * Width + w];
+                r.outcome = block.outcome[w];
+                r.steps = block.finishStep[w];
+                r.time = block.finishStep[w] * mDt;
+                r.minDistance = block.minDistance[w];
+                r.maxDistance = block.maxDistance[w];
+                r.finalDistance = block.finalDistance[w];
+                r.energyError = block.energyError[w];
+                r.megno = block.megno[w];
+                r.lyapunov = block.lyapunov[w];
+            }
+        }
+    }
+
+    void BinaryEnsemble::setupBlock(Block& block,
+        SystemParameters const* params, std::size_t first, std::size_t count)
+    {
+        Kernel<false>::setup(block, params, first, count);
+    }
+
+    void BinaryEnsemble::runBlock(Block& block,
+        ClassifierSettings const& settings, double dt, std::size_t steps,
+        std::uint64_t* stepHashes)
+    {
+        Kernel<false>::run(block, settings, dt, steps, stepHashes);
+    }
+}
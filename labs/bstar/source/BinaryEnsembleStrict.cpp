@@ -0,0 +1,20 @@
+// Built with floating-point contraction off; see EnsembleKernel.hpp.
+
+#include "BinaryEnsemble.hpp"
+#include "EnsembleKernel.hpp"
+
+namespace bstar
+{
+    void BinaryEnsemble::setupBlockStrict(Block& block,
+        SystemParameters const* params, std::size_t first, std::size_t count)
+    {
+        Kernel<true>::setup(block, params, first, count);
+    }
+
+    void BinaryEnsemble::runBlockStrict(Block& block,
+        ClassifierSettings const& settings, double dt, std::size_t steps,
+        std::uint64_t* stepHashes)
+    {
+        Kernel<true>::run(block, settings, dt, steps, stepHashes);
+    }
+}
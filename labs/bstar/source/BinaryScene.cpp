@@ -1,4 +1,5 @@
 #include "BinaryScene.hpp"
+#include "AllocationCounter.hpp"
 
 #include <atlas/utils/GUI.hpp>
 #include <atlas/gl/GL.hpp>
@@ -10,23 +11,21 @@ namespace bstar
         mPlay(false),
         mFPSOption(0),
         mFPS(60.0f),
-        mCounter(mFPS)
+        mThreadAllocations(allocations::thisThread()),
+        mTotalAllocations(allocations::total()),
+        mFrameThreadAllocations(0),
+        mFrameTotalAllocations(0),
+        mCleanFrames(0),
+        mBall(mFrameArena)
     { }
 
     void BinaryScene::updateScene(double time)
     {
-        using atlas::core::Time;
-
         ModellingScene::updateScene(time);
-        if (mPlay && mCounter.isFPS(mTime))
-        {
-            const float delta = 1.0f / mFPS;
-            mAnimTime.currentTime += delta;
-            mAnimTime.deltaTime = delta;
-            mAnimTime.totalTime = mAnimTime.currentTime;
 
-            mBall.updateGeometry(mAnimTime);
-        }
+        // Stepping happens on the simulation thread; this only picks up
+        // whatever it has finished since the last frame.
+        mBall.updateGeometry(mTime);
     }
 
     void BinaryScene::renderScene()
@@ -42,6 +41,8 @@ namespace bstar
             glm::radians(mCamera.getCameraFOV()),
             (float)mWidth / mHeight, 1.0f, 100000000.0f);
         mView = mCamera.getCameraMatrix();
+        mFrameUniforms.update(mProjection, mView);
+        mBall.setViewport(mWidth, mHeight);
 
         mGrid.renderGeometry(mProjection, mView);
         mBall.renderGeometry(mProjection, mView);
@@ -59,6 +60,7 @@ namespace bstar
             if (ImGui::Button("Pause"))
             {
                 mPlay = !mPlay;
+                mBall.setPlaying(mPlay);
             }
         }
         else
@@ -66,24 +68,24 @@ namespace bstar
             if (ImGui::Button("Play"))
             {
                 mPlay = !mPlay;
+                mBall.setPlaying(mPlay);
             }
         }
 
         if (ImGui::Button("Reset"))
         {
-            mBall.resetGeometry();
-            mAnimTime.currentTime = 0.0f;
-            mAnimTime.totalTime = 0.0f;
             mPlay = false;
+            mBall.setPlaying(mPlay);
+            mBall.resetGeometry();
         }
 
         ImGui::Text("Application average %.3f ms/frame (%.1FPS)",
             1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 
-        std::vector<const char*> options = { "60 FPS", "30 FPS", "20 FPS",
-        "10 FPS", "5 FPS", "1 FPS" };
-        ImGui::Combo("Choose FPS: ", &mFPSOption, options.data(),
-            ((int)options.size()));
+        static const char* options[] = { "60 FPS", "30 FPS", "20 FPS",
+            "10 FPS", "5 FPS", "1 FPS" };
+        ImGui::Combo("Choose FPS: ", &mFPSOption, options,
+            IM_ARRAYSIZE(options));
         ImGui::End();
 
         switch (mFPSOption)
@@ -116,9 +118,46 @@ namespace bstar
             break;
         }
 
-        mCounter.setFPS(mFPS);
+        mBall.setStepRate(mFPS);
 
         mBall.drawGui();
+        drawInstrumentation();
         ImGui::Render();
+
+        endFrame();
+    }
+
+    void BinaryScene::drawInstrumentation()
+    {
+        // Counts are for the last complete frame, since this one is not
+        // over yet.
+        ImGui::SetNextWindowSize(ImVec2(350, 120), ImGuiSetCond_FirstUseEver);
+        ImGui::Begin("Instrumentation");
+        ImGui::Text("Heap allocations: %llu this thread, %llu all threads",
+            static_cast<unsigned long long>(mFrameThreadAllocations),
+            static_cast<unsigned long long>(mFrameTotalAllocations));
+        ImGui::Text("Frames without allocating: %llu",
+            static_cast<unsigned long long>(mCleanFrames));
+        ImGui::Text("Frame arena: %zu of %zu KiB, peak %zu KiB",
+            mFrameArena.used() / 1024, mFrameArena.capacity() / 1024,
+            mFrameArena.highWater() / 1024);
+        ImGui::Text("Arena overflows: %zu", mFrameArena.overflows());
+        ImGui::End();
+    }
+
+    void BinaryScene::endFrame()
+    {
+        mFrameArena.reset();
+
+        // A frame runs from here to here, so it includes updateScene and
+        // whatever the simulation thread did meanwhile.
+        std::uint64_t thread = allocations::thisThread();
+        std::uint64_t total = allocations::total();
+        mFrameThreadAllocations = thread - mThreadAllocations;
+        mFrameTotalAllocations = total - mTotalAllocations;
+        mThreadAllocations = thread;
+        mTotalAllocations = total;
+
+        mCleanFrames = (mFrameThreadAllocations == 0) ? mCleanFrames + 1 : 0;
     }
 }
@@ -0,0 +1,460 @@
+// Headless parameter sweep over planet-and-binary systems.
+//
+// Every combination of the given parameter ranges is run as an independent
+// system. Systems are integrated in batches, one system per SIMD lane, and
+// the batches are spread over a thread pool. Each system is classified as
+// it runs (escaped, collided, chaotic by MEGNO, stable) and stops at the
+// first step that decides it. Each row of the output table records a
+// system's parameters, its outcome and when it was reached, the planet's
+// closest, furthest and final distance from the binary, the relative
+// energy drift, and the MEGNO and Lyapunov indicators.
+//
+// Ranges are a single value LO, or LO:HI:N for N evenly spaced values.
+//
+// With --deterministic the systems run on a kernel built without FMA
+// contraction, so the table is bit for bit the same on any machine, and a
+// hash of the state of every running system is printed for each step to
+// stderr; diffing two such logs finds the first step at which runs part.
+// Results never depend on --threads or --batch.
+//
+// Usage: bstar_sweep [--planet-mass R] [--star1-mass R] [--star2-mass R]
+//        [--separation R] [--planet-x R] [--planet-z R] [--speed-scale R]
+//        [--dt DT] [--steps N] [--batch N] [--threads N]
+//        [--escape-radius R] [--collision-radius R] [--megno-time T]
+//        [--chaotic-megno Y] [--stable-tolerance D] [--stable-time T]
+//        [--deterministic] [--format csv|json] [--out FILE]
+
+#include "BinaryEnsemble.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using namespace bstar;
+
+    struct Range
+    {
+        double lo;
+        double hi;
+        std::size_t count;
+
+        double value(std::size_t i) const
+        {
+            return (count < 2) ? lo :
+                lo + (hi - lo) * static_cast<double>(i) / (count - 1);
+        }
+    };
+
+    // Axes in the order the table lists them; the last axis varies fastest.
+    enum Axis
+    {
+        PlanetMass = 0,
+        FirstStarMass,
+        SecondStarMass,
+        Separation,
+        PlanetX,
+        PlanetZ,
+        SpeedScale,
+        AxisCount
+    };
+
+    const char* axisOptions[] = { "--planet-mass", "--star1-mass",
+        "--star2-mass", "--separation", "--planet-x", "--planet-z",
+        "--speed-scale" };
+
+    const char* axisColumns[] = { "planet_mass", "star1_mass", "star2_mass",
+        "separation", "planet_x", "planet_z", "speed_scale" };
+
+    // Indexed by Outcome.
+    const char* outcomeNames[] = { "running", "escaped", "collided",
+        "chaotic", "stable", "undecided" };
+    constexpr int OutcomeCount = 6;
+
+    struct SweepOptions
+    {
+        // Defaults are the viewer's starting system.
+        Range axes[AxisCount] = {
+            { 1.0e11, 1.0e11, 1 },
+            { 1.0e13, 1.0e13, 1 },
+            { 1.0e13, 1.0e13, 1 },
+            { 6.0, 6.0, 1 },
+            { 0.0, 0.0, 1 },
+            { 10.0, 10.0, 1 },
+            { 1.0, 1.0, 1 } };
+        double dt = 1.0 / 60.0;
+        std::size_t steps = 36000;
+        std::size_t batch = 64;
+        unsigned int threads = 0;
+        ClassifierSettings classifier;
+        bool deterministic = false;
+        std::string format = "csv";
+        std::string out;
+    };
+
+    bool parseRange(const char* text, Range& range)
+    {
+        char* end = nullptr;
+        range.lo = std::strtod(text, &end);
+        range.hi = range.lo;
+        range.count = 1;
+        if (end == text)
+        {
+            return false;
+        }
+
+        if (*end == ':')
+        {
+            const char* hiText = end + 1;
+            range.hi = std::strtod(hiText, &end);
+            if (end == hiText || *end != ':')
+            {
+                return false;
+            }
+
+            range.count = std::strtoul(end + 1, &end, 10);
+        }
+
+        return *end == '\0' && range.count > 0;
+    }
+
+    bool parseOptions(int argc, char** argv, SweepOptions& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "--deterministic")
+            {
+                options.deterministic = true;
+                continue;
+            }
+
+            if (i + 1 >= argc)
+            {
+                std::fprintf(stderr, "missing value for %s\n", arg.c_str());
+                return false;
+            }
+
+            const char* value = argv[++i];
+            auto axis = std::find_if(std::begin(axisOptions),
+                std::end(axisOptions), [&arg](const char* name)
+            {
+                return arg == name;
+            });
+
+            if (axis != std::end(axisOptions))
+            {
+                if (!parseRange(value,
+                    options.axes[axis - std::begin(axisOptions)]))
+                {
+                    std::fprintf(stderr, "bad range %s for %s\n", value,
+                        arg.c_str());
+                    return false;
+                }
+            }
+            else if (arg == "--dt")
+            {
+                options.dt = std::strtod(value, nullptr);
+            }
+            else if (arg == "--steps")
+            {
+                options.steps = std::strtoul(value, nullptr, 10);
+            }
+            else if (arg == "--batch")
+            {
+                options.batch = std::strtoul(value, nullptr, 10);
+            }
+            else if (arg == "--threads")
+            {
+                options.threads = std::strtoul(value, nullptr, 10);
+            }
+            else if (arg == "--escape-radius")
+            {
+                options.classifier.escapeRadius = std::strtod(value, nullptr);
+            }
+            else if (arg == "--collision-radius")
+            {
+                options.classifier.collisionRadius =
+                    std::strtod(value, nullptr);
+            }
+            else if (arg == "--megno-time")
+            {
+                options.classifier.megnoTime = std::strtod(value, nullptr);
+            }
+            else if (arg == "--chaotic-megno")
+            {
+                options.classifier.chaoticMegno = std::strtod(value, nullptr);
+            }
+            else if (arg == "--stable-tolerance")
+            {
+                options.classifier.stableTolerance =
+                    std::strtod(value, nullptr);
+            }
+            else if (arg == "--stable-time")
+            {
+                options.classifier.stableTime = std::strtod(value, nullptr);
+            }
+            else if (arg == "--format")
+            {
+                options.format = value;
+            }
+            else if (arg == "--out")
+            {
+                options.out = value;
+            }
+            else
+            {
+                std::fprintf(stderr, "unknown option %s\n", arg.c_str());
+                return false;
+            }
+        }
+
+        return options.dt > 0.0 && options.steps > 0 && options.batch > 0 &&
+            (options.format == "csv" || options.format == "json");
+    }
+
+    std::size_t gridSize(SweepOptions const& options)
+    {
+        std::size_t size = 1;
+        for (auto const& range : options.axes)
+        {
+            size *= range.count;
+        }
+        return size;
+    }
+
+    SystemParameters parametersOf(SweepOptions const& options,
+        std::size_t run, double* values)
+    {
+        for (int a = AxisCount - 1; a >= 0; --a)
+        {
+            Range const& range = options.axes[a];
+            values[a] = range.value(run % range.count);
+            run /= range.count;
+        }
+
+        SystemParameters params;
+        params.planetMass = values[PlanetMass];
+        params.firstStarMass = values[FirstStarMass];
+        params.secondStarMass = values[SecondStarMass];
+        params.separation = values[Separation];
+        params.planetX = values[PlanetX];
+        params.planetZ = values[PlanetZ];
+        params.speedScale = values[SpeedScale];
+        return params;
+    }
+
+    void runBatch(SweepOptions const& options, std::size_t first,
+        std::size_t count, std::vector<SystemResult>& results,
+        std::uint64_t* stepHashes)
+    {
+        double values[AxisCount];
+        std::vector<SystemParameters> params(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            params[i] = parametersOf(options, first + i, values);
+        }
+
+        BinaryEnsemble ensemble;
+        ensemble.setClassifier(options.classifier);
+        ensemble.setDeterministic(options.deterministic);
+        ensemble.setup(params.data(), count);
+        ensemble.run(options.dt, options.steps, stepHashes);
+        ensemble.results(results.data() + first);
+    }
+
+    void writeCsv(std::FILE* out, SweepOptions const& options,
+        std::vector<SystemResult> const& results)
+    {
+        std::fprintf(out, "run");
+        for (auto column : axisColumns)
+        {
+            std::fprintf(out, ",%s", column);
+        }
+        std::fprintf(out, ",outcome,steps,time,min_distance,max_distance,"
+            "final_distance,energy_error,megno,lyapunov\n");
+
+        double values[AxisCount];
+        for (std::size_t run = 0; run < results.size(); ++run)
+        {
+            parametersOf(options, run, values);
+            std::fprintf(out, "%zu", run);
+            for (double value : values)
+            {
+                std::fprintf(out, ",%.9g", value);
+            }
+
+            auto const& r = results[run];
+            std::fprintf(out, ",%s,%zu,%.9g,%.9g,%.9g,%.9g,%.3e,%.6g,%.6g\n",
+                outcomeNames[static_cast<int>(r.outcome)], r.steps, r.time,
+                r.minDistance, r.maxDistance, r.finalDistance, r.energyError,
+                r.megno, r.lyapunov);
+        }
+    }
+
+    void writeJson(std::FILE* out, SweepOptions const& options,
+        std::vector<SystemResult> const& results)
+    {
+        std::fprintf(out, "{\n  \"dt\": %.9g,\n  \"steps\": %zu,\n"
+            "  \"results\": [\n", options.dt, options.steps);
+
+        double values[AxisCount];
+        for (std::size_t run = 0; run < results.size(); ++run)
+        {
+            parametersOf(options, run, values);
+            std::fprintf(out, "    {\"run\": %zu", run);
+            for (int a = 0; a < AxisCount; ++a)
+            {
+                std::fprintf(out, ", \"%s\": %.9g", axisColumns[a],
+                    values[a]);
+            }
+
+            auto const& r = results[run];
+            std::fprintf(out, ", \"outcome\": \"%s\", \"steps\": %zu, "
+                "\"time\": %.9g, \"min_distance\": %.9g, "
+                "\"max_distance\": %.9g, \"final_distance\": %.9g, "
+                "\"energy_error\": %.3e, \"megno\": %.6g, "
+                "\"lyapunov\": %.6g}%s\n",
+                outcomeNames[static_cast<int>(r.outcome)], r.steps, r.time,
+                r.minDistance, r.maxDistance, r.finalDistance, r.energyError,
+                r.megno, r.lyapunov, (run + 1 < results.size()) ? "," : "");
+        }
+        std::fprintf(out, "  ]\n}\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    using Clock = std::chrono::steady_clock;
+
+    SweepOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        std::fprintf(stderr, "usage: %s [--planet-mass R] [--star1-mass R] "
+            "[--star2-mass R] [--separation R] [--planet-x R] "
+            "[--planet-z R] [--speed-scale R] [--dt DT] [--steps N] "
+            "[--batch N] [--threads N] [--escape-radius R] "
+            "[--collision-radius R] [--megno-time T] [--chaotic-megno Y] "
+            "[--stable-tolerance D] [--stable-time T] [--deterministic] "
+            "[--format csv|json] [--out FILE]\n"
+            "ranges are LO or LO:HI:N\n", argv[0]);
+        return 1;
+    }
+
+    std::size_t runs = gridSize(options);
+    std::size_t batches = (runs + options.batch - 1) / options.batch;
+    std::vector<SystemResult> results(runs);
+
+    unsigned int threads = options.threads;
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Each worker sums its own step hashes; the sums are combined after.
+    std::vector<std::vector<std::uint64_t>> hashes(threads);
+    if (options.deterministic)
+    {
+        for (auto& h : hashes)
+        {
+            h.assign(options.steps, 0);
+        }
+    }
+
+    // Every batch costs about the same, but handing them out from a shared
+    // counter keeps the workers balanced on a loaded machine too.
+    auto start = Clock::now();
+    std::atomic<std::size_t> next(0);
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]()
+        {
+            std::uint64_t* stepHashes = options.deterministic ?
+                hashes[t].data() : nullptr;
+            std::size_t batch;
+            while ((batch = next.fetch_add(1)) < batches)
+            {
+                std::size_t first = batch * options.batch;
+                runBatch(options, first,
+                    std::min(options.batch, runs - first), results,
+                    stepHashes);
+            }
+        });
+    }
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(
+        Clock::now() - start).count();
+
+    std::FILE* out = stdout;
+    if (!options.out.empty())
+    {
+        out = std::fopen(options.out.c_str(), "w");
+        if (out == nullptr)
+        {
+            std::fprintf(stderr, "could not open %s\n", options.out.c_str());
+            return 1;
+        }
+    }
+
+    if (options.format == "json")
+    {
+        writeJson(out, options, results);
+    }
+    else
+    {
+        writeCsv(out, options, results);
+    }
+
+    if (out != stdout)
+    {
+        std::fclose(out);
+    }
+
+    if (options.deterministic)
+    {
+        for (std::size_t s = 0; s < options.steps; ++s)
+        {
+            std::uint64_t hash = 0;
+            for (auto const& h : hashes)
+            {
+                hash += h[s];
+            }
+            std::fprintf(stderr, "step %zu %016llx\n", s + 1,
+                static_cast<unsigned long long>(hash));
+        }
+    }
+
+    std::size_t counts[OutcomeCount] = {};
+    double taken = 0.0;
+    for (auto const& r : results)
+    {
+        ++counts[static_cast<int>(r.outcome)];
+        taken += static_cast<double>(r.steps);
+    }
+
+    double budget = static_cast<double>(runs) * options.steps;
+    std::fprintf(stderr, "%zu systems, up to %zu steps each, in %.3f s on %u "
+        "threads (%.1f ns per system-step taken)\n", runs, options.steps,
+        seconds, threads, 1e9 * seconds / std::max(taken, 1.0));
+    for (int o = 1; o < OutcomeCount; ++o)
+    {
+        std::fprintf(stderr, "%s%s %zu", (o == 1) ? "" : ", ",
+            outcomeNames[o], counts[o]);
+    }
+    std::fprintf(stderr, "; early termination skipped %.1f%% of steps\n",
+        100.0 * (1.0 - taken / budget));
+    return 0;
+}
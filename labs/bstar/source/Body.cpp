@@ -1,72 +1,83 @@
 #include "Body.hpp"
+#include "MeshBlob.hpp"
+#include "FrameUniforms.hpp"
 #include "Paths.hpp"
+#include "ShaderWatcher.hpp"
 #include "LayoutLocations.glsl"
 
-#include <atlas/utils/Mesh.hpp>
 #include <atlas/core/STB.hpp>
 #include <atlas/core/Float.hpp>
 #include <atlas/utils/GUI.hpp>
+#include <atlas/core/Macros.hpp>
 
-const float g = 6.67e-11;
+#include <algorithm>
+#include <thread>
 
 namespace bstar
 {
-    Body::Body() :
+    Body::Body(FrameArena& frameArena) :
         mVertexBuffer(GL_ARRAY_BUFFER),
         mIndexBuffer(GL_ELEMENT_ARRAY_BUFFER),
-        mPosition(0,0,10),
-        mOffset(0,0,10),
-        mVelocity(0,0,0),
-        mOldPosition(2,0,10),
-        mForce(0, 0, 0),
-        mMass(1.0e11),
-
-        s1Position(3,0,0),
-        s1Offset(3,0,0),
-        s1Velocity(0,0,0),
-        s1OldPosition(3,0,1),
-        s1Force(0, 0, 0),
-        s1Mass(1.0e13),
-
-        s2Position(-3,0,0),
-        s2Offset(-3,0,0),
-        s2Velocity(0,0,0),
-        s2OldPosition(-3,0,-1),
-        s2Force(0, 0, 0),
-        s2Mass(1.0e13),
-
-        mIntegrator(0)
+        mInstanceBuffer(GL_ARRAY_BUFFER),
+        mIntegrator(0),
+        mForceMethod(0),
+        mExpansionOrder(4),
+        mOpeningAngle(0.5f),
+        mForceThreads(static_cast<int>(
+            std::max(1u, std::thread::hardware_concurrency()))),
+        mSortInterval(32),
+        mPostNewtonian(false),
+        mSpeedOfLight(static_cast<float>(ForceTerms().speedOfLight)),
+        mForceLaw(0),
+        mSoftening(static_cast<float>(ForceLaw().softening)),
+        mCollisions(true),
+        mStepRate(60.0f),
+        mSeenSteps(0),
+        mSeenResets(0),
+        mUniformTable({ "model" }),
+        mImpostorUniforms({ "model", "viewportHeight" }),
+        mTrailUniforms({ "model", "trail", "bodies", "capacity", "oldest",
+            "points", "colour" }),
+        mShaderGeneration(0),
+        mFrameArena(frameArena),
+        mSortedInstances(nullptr),
+        mInstanceLayout(0),
+        mInstanceCapacity(0),
+        mLevelPixels({ 48.0f, 16.0f, 6.0f }),
+        mLodScale(1.0f),
+        mViewportHeight(1),
+        mCulling(true),
+        mShowTrails(true),
+        mTrailLength(256)
     {
-        using atlas::utils::Mesh;
         namespace gl = atlas::gl;
-        namespace math = atlas::math;
 
-        Mesh sphere;
+        mLevelFirst.fill(0);
+        mLevelCount.fill(0);
+
+        MeshBlob sphere;
         std::string path{ DataDirectory };
         path = path + "sphere.obj";
-        Mesh::fromFile(path, sphere);
-
-        mIndexCount = static_cast<GLsizei>(sphere.indices().size());
 
-        std::vector<float> data;
-        for (std::size_t i = 0; i < sphere.vertices().size(); ++i)
+        // The authored mesh stays the closest level; the coarser ones are
+        // cheap enough to build on every start. Without it, load() has
+        // logged why and a fine UV sphere takes its place.
+        if (sphere.load(path))
         {
-            data.push_back(sphere.vertices()[i].x);
-            data.push_back(sphere.vertices()[i].y);
-            data.push_back(sphere.vertices()[i].z);
-
-            data.push_back(sphere.normals()[i].x);
-            data.push_back(sphere.normals()[i].y);
-            data.push_back(sphere.normals()[i].z);
-
-            data.push_back(sphere.texCoords()[i].x);
-            data.push_back(sphere.texCoords()[i].y);
+            mSphereLod.addMesh(sphere.vertices(), sphere.vertexCount(),
+                sphere.indices(), sphere.indexCount());
         }
+        else
+        {
+            mSphereLod.addUvSphere(48, 24);
+        }
+        mSphereLod.addUvSphere(24, 12);
+        mSphereLod.addUvSphere(10, 6);
 
         mVao.bindVertexArray();
         mVertexBuffer.bindBuffer();
-        mVertexBuffer.bufferData(gl::size<float>(data.size()), data.data(),
-            GL_STATIC_DRAW);
+        mVertexBuffer.bufferData(gl::size<float>(mSphereLod.vertices().size()),
+            mSphereLod.vertices().data(), GL_STATIC_DRAW);
         mVertexBuffer.vertexAttribPointer(VERTICES_LAYOUT_LOCATION, 3, GL_FLOAT,
             GL_FALSE, gl::stride<float>(8), gl::bufferOffset<float>(0));
         mVertexBuffer.vertexAttribPointer(NORMALS_LAYOUT_LOCATION, 3, GL_FLOAT,
@@ -79,79 +90,148 @@ namespace bstar
         mVao.enableVertexAttribArray(TEXTURES_LAYOUT_LOCATION);
 
         mIndexBuffer.bindBuffer();
-        mIndexBuffer.bufferData(gl::size<GLuint>(sphere.indices().size()),
-            sphere.indices().data(), GL_STATIC_DRAW);
+        mIndexBuffer.bufferData(gl::size<GLuint>(mSphereLod.indices().size()),
+            mSphereLod.indices().data(), GL_STATIC_DRAW);
+
+        // The mesh path steps through the instance buffer once per
+        // instance; the pointers are moved to each level's range at draw
+        // time.
+        mInstanceBuffer.bindBuffer();
+        pointInstances(0);
+        glVertexAttribDivisor(INSTANCE_SPHERE_LAYOUT_LOCATION, 1);
+        glVertexAttribDivisor(INSTANCE_COLOUR_LAYOUT_LOCATION, 1);
+        mVao.enableVertexAttribArray(INSTANCE_SPHERE_LAYOUT_LOCATION);
+        mVao.enableVertexAttribArray(INSTANCE_COLOUR_LAYOUT_LOCATION);
 
         mIndexBuffer.unBindBuffer();
-        mVertexBuffer.unBindBuffer();
         mVao.unBindVertexArray();
 
+        // The impostor path reads the same buffer one vertex per body.
+        mImpostorVao.bindVertexArray();
+        mInstanceBuffer.vertexAttribPointer(INSTANCE_SPHERE_LAYOUT_LOCATION, 4,
+            GL_FLOAT, GL_FALSE, gl::stride<BodyInstance>(1),
+            gl::bufferOffset<float>(0));
+        mInstanceBuffer.vertexAttribPointer(INSTANCE_COLOUR_LAYOUT_LOCATION, 4,
+            GL_FLOAT, GL_FALSE, gl::stride<BodyInstance>(1),
+            gl::bufferOffset<float>(4));
+        mImpostorVao.enableVertexAttribArray(INSTANCE_SPHERE_LAYOUT_LOCATION);
+        mImpostorVao.enableVertexAttribArray(INSTANCE_COLOUR_LAYOUT_LOCATION);
+
+        mInstanceBuffer.unBindBuffer();
+        mImpostorVao.unBindVertexArray();
+
         std::vector<gl::ShaderUnit> shaders
         {
             {std::string(ShaderDirectory) + "Body.vs.glsl", GL_VERTEX_SHADER},
             {std::string(ShaderDirectory) + "Body.fs.glsl", GL_FRAGMENT_SHADER}
         };
 
+        std::vector<gl::ShaderUnit> impostorShaders
+        {
+            {std::string(ShaderDirectory) + "Impostor.vs.glsl",
+                GL_VERTEX_SHADER},
+            {std::string(ShaderDirectory) + "Impostor.fs.glsl",
+                GL_FRAGMENT_SHADER}
+        };
+
+        std::vector<gl::ShaderUnit> trailShaders
+        {
+            {std::string(ShaderDirectory) + "Trail.vs.glsl", GL_VERTEX_SHADER},
+            {std::string(ShaderDirectory) + "Trail.fs.glsl", GL_FRAGMENT_SHADER}
+        };
+
         mShaders.emplace_back(shaders);
+        mShaders.emplace_back(impostorShaders);
+        mShaders.emplace_back(trailShaders);
+
+#if defined(SHADER_HOT_RELOAD)
+        for (auto const& unit : shaders)
+        {
+            ShaderWatcher::getInstance().watch(unit.filename);
+        }
+        for (auto const& unit : impostorShaders)
+        {
+            ShaderWatcher::getInstance().watch(unit.filename);
+        }
+        for (auto const& unit : trailShaders)
+        {
+            ShaderWatcher::getInstance().watch(unit.filename);
+        }
+        mShaderGeneration = ShaderWatcher::getInstance().generation();
+#endif
+
         mShaders[0].setShaderIncludeDir(ShaderDirectory);
-        mShaders[0].compileShaders();
-        mShaders[0].linkShaders();
-
-        auto var = mShaders[0].getUniformVariable("model");
-        mUniforms.insert(UniformKey("model", var));
-        var = mShaders[0].getUniformVariable("projection");
-        mUniforms.insert(UniformKey("projection", var));
-        var = mShaders[0].getUniformVariable("view");
-        mUniforms.insert(UniformKey("view", var));
-        var = mShaders[0].getUniformVariable("materialColour");
-        mUniforms.insert(UniformKey("materialColour", var));
-
-        mShaders[0].disableShaders();
-    }
+        mProgram.build(mShaders[0], shaders, ShaderDirectory);
 
-    void Body::updateGeometry(atlas::core::Time<> const& t)
-    {
+        GLuint program = mProgram.getProgram();
+        mUniformTable.resolve(mProgram);
+        FrameUniforms::bindProgram(program);
 
-        //determine forces at current state
-        //Gravitational for Mass 1 (accounts for both stars)
-        float mgForce1 = gravity(mPosition, s1Position, mMass, s1Mass);
-        atlas::math::Vector mgDir1 = normalize(s1Position - mPosition);
-        float mgForce2 = gravity(mPosition, -s2Position, mMass, s2Mass);
-        atlas::math::Vector mgDir2 = normalize(s2Position - mPosition);
+        mShaders[1].setShaderIncludeDir(ShaderDirectory);
+        mImpostorProgram.build(mShaders[1], impostorShaders,
+            ShaderDirectory);
 
-        //Gravitational for Star 1 (accounts only for star 2's mass)
-        float s1gForce = gravity(s1Position, s2Position, s1Mass, s2Mass);
-        atlas::math::Vector s1gDir = normalize(s2Position - s1Position);
+        program = mImpostorProgram.getProgram();
+        mImpostorUniforms.resolve(mImpostorProgram);
+        FrameUniforms::bindProgram(program);
 
-        //Gravitational for Star 2 (accounts only for star 1's mass)
-        float s2gForce = gravity(s2Position, s1Position, s2Mass, s1Mass);
-        atlas::math::Vector s2gDir = normalize(s1Position - s2Position);
+        mShaders[2].setShaderIncludeDir(ShaderDirectory);
+        mTrailProgram.build(mShaders[2], trailShaders, ShaderDirectory);
 
-        //Total
-        mForce = (mgForce1 * mgDir1) + (mgForce2 * mgDir2);
-        s1Force = s1gForce * s1gDir;
-        s2Force = s2gForce * s2gDir;
+        program = mTrailProgram.getProgram();
+        mTrailUniforms.resolve(mTrailProgram);
+        FrameUniforms::bindProgram(program);
 
-        switch (mIntegrator)
-        {
-        case 0:
-            eulerIntegrator(t);
-            break;
+        mTrails.setCapacity(mTrailLength);
 
-        case 1:
-            implicitEulerIntegrator(t);
-            break;
+        mProgram.disableProgram();
+    }
 
-        case 2:
-            verletIntegrator(t);
-            break;
+    void Body::updateGeometry(atlas::core::Time<> const& t)
+    {
+        UNUSED(t);
 
-        case 3:
-            rk4Integrator(t);
-            break;
+        if (!mSimulation.acquire())
+        {
+            return;
+        }
 
-        default:
-            break;
+        auto const& state = mSimulation.state();
+        if (state.resets != mSeenResets)
+        {
+            mTrails.clear();
+            mSeenResets = state.resets;
+            mSeenSteps = 0;
+        }
+
+        // Only states from new steps extend the trails. If rendering falls
+        // behind, the steps in between are not recorded.
+        if (state.steps > mSeenSteps)
+        {
+            // Trail columns are id slots rather than memory order, which
+            // the simulation's Morton sort reshuffles, and a merge frees a
+            // slot without moving the others, so other trails carry on.
+            // Columns only grow within a run, since a narrower buffer
+            // would start every trail over.
+            std::size_t columns = (mSeenSteps == 0) ? 0 : mTrails.bodies();
+            for (auto id : state.ids)
+            {
+                columns = std::max(columns, Particles::slotOf(id) + 1);
+            }
+            mSeenSteps = state.steps;
+
+            // Tags are the slot's generation plus one, so a body that
+            // reuses a slot gets a trail of its own; freed slots stay 0.
+            mTrailPoints.assign(columns, atlas::math::Vector4(0.0f));
+            for (std::size_t i = 0; i < state.ids.size(); ++i)
+            {
+                Particles::Id id = state.ids[i];
+                float tag = static_cast<float>(
+                    (id >> Particles::SlotBits) + 1);
+                mTrailPoints[Particles::slotOf(id)] = atlas::math::Vector4(
+                    state.x[i], state.y[i], state.z[i], tag);
+            }
+            mTrails.push(mTrailPoints);
         }
     }
 
@@ -160,182 +240,418 @@ namespace bstar
         ImGui::SetNextWindowSize(ImVec2(300, 200), ImGuiSetCond_FirstUseEver);
         ImGui::Begin("Integration Controls");
 
-        std::vector<const char*> integratorNames = { "Euler Integrator",
-        "Implicit Euler Integrator", "Verlet Integrator", "Runge-Kutta Integrator" };
-        ImGui::Combo("Integrator", &mIntegrator, integratorNames.data(),
-            ((int)integratorNames.size()));
-        ImGui::InputFloat("Set planet mass", &mMass, 1.0e11, 5.0f, 1);
-        ImGui::InputFloat("Set star 1 mass", &s1Mass, 1.0e11, 5.0f, 1);
-        ImGui::InputFloat("Set star 2 mass", &s2Mass, 1.0e11, 5.0f, 1);
+        static const char* integratorNames[] = { "Euler Integrator",
+            "Implicit Euler Integrator", "Verlet Integrator",
+            "Runge-Kutta Integrator", "Fused Verlet Integrator" };
+        if (ImGui::Combo("Integrator", &mIntegrator, integratorNames,
+            IM_ARRAYSIZE(integratorNames)))
+        {
+            mSimulation.send(SimulationCommand::SetIntegrator, mIntegrator);
+        }
+
+        static const char* forceNames[] = { "Direct sum",
+            "Fast multipole", "Tiled direct sum" };
+        if (ImGui::Combo("Gravity", &mForceMethod, forceNames,
+            IM_ARRAYSIZE(forceNames)))
+        {
+            mSimulation.send(SimulationCommand::SetForceMethod, mForceMethod);
+        }
+        if (mForceMethod == static_cast<int>(ForceMethod::Multipole))
+        {
+            if (ImGui::SliderInt("Expansion order", &mExpansionOrder,
+                MultipoleForce::MinOrder, MultipoleForce::MaxOrder))
+            {
+                mSimulation.send(SimulationCommand::SetExpansionOrder,
+                    mExpansionOrder);
+            }
+            if (ImGui::SliderFloat("Opening angle", &mOpeningAngle, 0.1f,
+                0.9f))
+            {
+                mSimulation.send(SimulationCommand::SetOpeningAngle,
+                    mOpeningAngle);
+            }
+        }
+        if (mForceMethod == static_cast<int>(ForceMethod::Tiled))
+        {
+            int maxThreads = static_cast<int>(
+                std::max(1u, std::thread::hardware_concurrency()));
+            if (ImGui::SliderInt("Threads", &mForceThreads, 1, maxThreads))
+            {
+                mSimulation.send(SimulationCommand::SetForceThreads,
+                    mForceThreads);
+            }
+        }
+
+        // Tabulated laws need a table, so they are set from code only.
+        static const char* lawNames[] = { "Newtonian",
+            "Plummer softened", "Spline softened" };
+        if (ImGui::Combo("Force law", &mForceLaw, lawNames,
+            IM_ARRAYSIZE(lawNames)))
+        {
+            mSimulation.send(SimulationCommand::SetForceLaw, mForceLaw);
+        }
+        if (mForceLaw != static_cast<int>(ForceLawKind::Newtonian) &&
+            ImGui::SliderFloat("Softening", &mSoftening, 0.01f, 1.0f,
+                "%.3f", 2.0f))
+        {
+            mSimulation.send(SimulationCommand::SetSoftening, mSoftening);
+        }
+
+        if (ImGui::Checkbox("Post-Newtonian (1PN)", &mPostNewtonian))
+        {
+            mSimulation.send(SimulationCommand::SetPostNewtonian,
+                mPostNewtonian);
+        }
+        if (mPostNewtonian && ImGui::SliderFloat("Speed of light",
+            &mSpeedOfLight, 50.0f, 2000.0f, "%.0f", 2.0f))
+        {
+            mSimulation.send(SimulationCommand::SetSpeedOfLight,
+                mSpeedOfLight);
+        }
+
+        // Bodies that have been merged away no longer have a mass to set.
+        auto const& state = mSimulation.state();
+        const char* massLabels[] = { "Set planet mass", "Set star 1 mass",
+            "Set star 2 mass" };
+        const Particles::Id massIds[] = { Simulation::PlanetId,
+            Simulation::FirstStarId, Simulation::SecondStarId };
+        for (int i = 0; i < 3; ++i)
+        {
+            if (state.namedMasses[i] == 0.0)
+            {
+                continue;
+            }
+
+            float mass = static_cast<float>(state.namedMasses[i]);
+            if (ImGui::InputFloat(massLabels[i], &mass, 1.0e11f, 5.0f, 1))
+            {
+                mSimulation.send(SimulationCommand::SetMass, mass,
+                    massIds[i]);
+            }
+        }
+
+        if (ImGui::SliderInt("Morton sort interval", &mSortInterval, 0, 256))
+        {
+            mSimulation.send(SimulationCommand::SetSortInterval,
+                mSortInterval);
+        }
+
+        if (ImGui::Checkbox("Merge on collision", &mCollisions))
+        {
+            mSimulation.send(SimulationCommand::SetCollisions, mCollisions);
+        }
+        ImGui::Text("Bodies %zu, merges %zu", state.x.size(), state.merges);
+
+        ImGui::Checkbox("Frustum culling", &mCulling);
+        ImGui::Checkbox("Show trails", &mShowTrails);
+        if (ImGui::SliderInt("Trail length", &mTrailLength, 16, 1024))
+        {
+            mTrails.setCapacity(mTrailLength);
+        }
+        ImGui::SliderFloat("LOD scale", &mLodScale, 0.25f, 4.0f);
+        std::size_t vertices = mLevelCount[ImpostorLevel];
+        for (std::size_t level = 0; level < MeshLevels; ++level)
+        {
+            vertices += mLevelCount[level] * mSphereLod.level(level).indexCount;
+        }
+        ImGui::Text("Meshes %zu / %zu / %zu, impostors %zu", mLevelCount[0],
+            mLevelCount[1], mLevelCount[2], mLevelCount[ImpostorLevel]);
+        ImGui::Text("Visible %zu of %zu bodies", mVisible.size(),
+            mInstances.size());
+        ImGui::Text("Vertices submitted: %zu", vertices);
         ImGui::End();
     }
 
     void Body::renderGeometry(atlas::math::Matrix4 const& projection,
         atlas::math::Matrix4 const& view)
     {
-        namespace math = atlas::math;
+        namespace gl = atlas::gl;
+
+#if defined(SHADER_HOT_RELOAD)
+        auto generation = ShaderWatcher::getInstance().generation();
+        if (generation != mShaderGeneration)
+        {
+            mShaderGeneration = generation;
+            mProgram.reload(mShaders[0]);
+            mImpostorProgram.reload(mShaders[1]);
+            mTrailProgram.reload(mShaders[2]);
+        }
+#endif
 
-        mShaders[0].hotReloadShaders();
-        if (!mShaders[0].shaderProgramValid())
+        if (!mProgram.programValid() || !mImpostorProgram.programValid() ||
+            !mTrailProgram.programValid())
         {
             return;
         }
 
-        mShaders[0].enableShaders();
+        GLuint program = mProgram.getProgram();
+        if (mUniformTable.resolve(mProgram))
+        {
+            FrameUniforms::bindProgram(program);
+        }
+
+        program = mImpostorProgram.getProgram();
+        if (mImpostorUniforms.resolve(mImpostorProgram))
+        {
+            FrameUniforms::bindProgram(program);
+        }
+
+        program = mTrailProgram.getProgram();
+        if (mTrailUniforms.resolve(mTrailProgram))
+        {
+            FrameUniforms::bindProgram(program);
+        }
+
+        gatherInstances();
+        cullInstances(projection, view);
+        selectLevels(projection, view);
+
+        // Orphan the previous frame's instances instead of waiting on the
+        // draws that still read them.
+        mInstanceBuffer.bindBuffer();
+        mInstanceCapacity = std::max(mInstanceCapacity, mVisible.size());
+        mInstanceBuffer.bufferData(gl::size<BodyInstance>(mInstanceCapacity),
+            nullptr, GL_STREAM_DRAW);
+        mInstanceBuffer.bufferSubData(0,
+            gl::size<BodyInstance>(mVisible.size()), mSortedInstances);
+        mInstanceBuffer.unBindBuffer();
+
+        mProgram.enableProgram();
+        glUniformMatrix4fv(mUniformTable.get<BodyUniform::Model>(), 1,
+            GL_FALSE, &mModel[0][0]);
 
         mVao.bindVertexArray();
         mIndexBuffer.bindBuffer();
+        mInstanceBuffer.bindBuffer();
 
-        glUniformMatrix4fv(mUniforms["projection"], 1, GL_FALSE,
-            &projection[0][0]);
-        glUniformMatrix4fv(mUniforms["view"], 1, GL_FALSE, &view[0][0]);
-
-        // Render star A
+        for (std::size_t level = 0; level < MeshLevels; ++level)
         {
-            const math::Vector white{ 1.0f, 1.0f, 1.0f };
-            auto model = glm::translate(math::Matrix4(1.0f), s1Position) * glm::scale(math::Matrix4(1.0f), math::Vector(0.25f));
-            glUniformMatrix4fv(mUniforms["model"], 1, GL_FALSE, &model[0][0]);
-            glUniform3fv(mUniforms["materialColour"], 1, &white[0]);
-            glDrawElements(GL_TRIANGLES, mIndexCount, GL_UNSIGNED_INT, 0);
+            if (mLevelCount[level] == 0)
+            {
+                continue;
+            }
+
+            auto const& lod = mSphereLod.level(level);
+            pointInstances(mLevelFirst[level]);
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lod.indexCount,
+                GL_UNSIGNED_INT, gl::bufferOffset<GLuint>(lod.firstIndex),
+                static_cast<GLsizei>(mLevelCount[level]), lod.baseVertex);
         }
 
-        // Render star B
+        mInstanceBuffer.unBindBuffer();
+        mIndexBuffer.unBindBuffer();
+        mVao.unBindVertexArray();
+
+        if (mLevelCount[ImpostorLevel] != 0)
         {
-            const math::Vector white{ 1.0f, 1.0f, 1.0f };
-            auto model = glm::translate(math::Matrix4(1.0f), s2Position) * glm::scale(math::Matrix4(1.0f), math::Vector(0.25f));
-            glUniformMatrix4fv(mUniforms["model"], 1, GL_FALSE, &model[0][0]);
-            glUniform3fv(mUniforms["materialColour"], 1, &white[0]);
-            glDrawElements(GL_TRIANGLES, mIndexCount, GL_UNSIGNED_INT, 0);
+            mImpostorProgram.enableProgram();
+            glUniformMatrix4fv(
+                mImpostorUniforms.get<ImpostorUniform::Model>(), 1,
+                GL_FALSE, &mModel[0][0]);
+            glUniform1f(
+                mImpostorUniforms.get<ImpostorUniform::ViewportHeight>(),
+                static_cast<float>(mViewportHeight));
+
+            glEnable(GL_PROGRAM_POINT_SIZE);
+            mImpostorVao.bindVertexArray();
+            glDrawArrays(GL_POINTS,
+                static_cast<GLint>(mLevelFirst[ImpostorLevel]),
+                static_cast<GLsizei>(mLevelCount[ImpostorLevel]));
+            mImpostorVao.unBindVertexArray();
+            glDisable(GL_PROGRAM_POINT_SIZE);
         }
 
-        // Render planet
+        if (mShowTrails)
         {
-            const math::Vector black{ 0.0f, 0.0f, 0.0f };
-            auto model = glm::translate(math::Matrix4(1.0f), mPosition) * glm::scale(math::Matrix4(1.0f), math::Vector(0.1f));
-            glUniformMatrix4fv(mUniforms["model"], 1, GL_FALSE, &model[0][0]);
-            glUniform3fv(mUniforms["materialColour"], 1, &black[0]);
-            glDrawElements(GL_TRIANGLES, mIndexCount, GL_UNSIGNED_INT, 0);
+            renderTrails();
         }
 
-        mIndexBuffer.unBindBuffer();
-        mVao.unBindVertexArray();
-        mShaders[0].disableShaders();
+        mProgram.disableProgram();
     }
 
-    void Body::resetGeometry()
+    void Body::renderTrails()
     {
-        mPosition = { 0, 0, 10 };
-        mOldPosition = {2, 0, 10};
-        mVelocity = { 0, 0, 0 };
-
-        s1Position = { 3, 0, 0 };
-        s1OldPosition = {3, 0, 1};
-        s1Velocity = { 0, 0, 0 };
+        mTrails.upload();
+        if (mTrails.count() < 2)
+        {
+            return;
+        }
 
-        s2Position = { -3, 0, 0 };
-        s2OldPosition = {-3, 0, -1};
-        s2Velocity = { 0, 0, 0 };
+        const atlas::math::Vector colour{ 1.0f, 0.85f, 0.4f };
+
+        mTrailProgram.enableProgram();
+        mTrails.bindTexture(GL_TEXTURE0);
+        glUniformMatrix4fv(mTrailUniforms.get<TrailUniform::Model>(), 1,
+            GL_FALSE, &mModel[0][0]);
+        glUniform1i(mTrailUniforms.get<TrailUniform::Trail>(), 0);
+        glUniform1i(mTrailUniforms.get<TrailUniform::Bodies>(),
+            static_cast<GLint>(mTrails.bodies()));
+        glUniform1i(mTrailUniforms.get<TrailUniform::Capacity>(),
+            static_cast<GLint>(mTrails.capacity()));
+        glUniform1i(mTrailUniforms.get<TrailUniform::Oldest>(),
+            static_cast<GLint>(mTrails.oldest()));
+        glUniform1i(mTrailUniforms.get<TrailUniform::Points>(),
+            static_cast<GLint>(mTrails.count()));
+        glUniform3fv(mTrailUniforms.get<TrailUniform::Colour>(), 1,
+            &colour[0]);
+
+        // Instanced line strips are separate primitives, so one call draws
+        // every body's trail.
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+
+        mTrailVao.bindVertexArray();
+        glDrawArraysInstanced(GL_LINE_STRIP, 0,
+            static_cast<GLsizei>(mTrails.count()),
+            static_cast<GLsizei>(mTrails.bodies()));
+        mTrailVao.unBindVertexArray();
+
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
     }
 
-    void Body::eulerIntegrator(atlas::core::Time<> const& t)
+    void Body::setViewport(int width, int height)
     {
-        //mass 1
-        mPosition += mOldPosition + t.deltaTime * mVelocity;
-        mVelocity += mVelocity + t.deltaTime * (mForce / mMass);
+        UNUSED(width);
+        mViewportHeight = std::max(height, 1);
+    }
 
-        //star 1
-        s1Position += s1OldPosition + t.deltaTime * s1Velocity;
-        s1Velocity += s1Velocity + t.deltaTime * (s1Force / s1Mass);
+    void Body::setPlaying(bool playing)
+    {
+        mSimulation.send(SimulationCommand::SetPlaying, playing);
+    }
 
-        //star 2
-        s2Position += s2OldPosition + t.deltaTime * s2Velocity;
-        s2Velocity += s2Velocity + t.deltaTime * (s2Force / s2Mass);
+    void Body::setStepRate(float rate)
+    {
+        if (rate != mStepRate)
+        {
+            mStepRate = rate;
+            mSimulation.send(SimulationCommand::SetRate, rate);
+        }
     }
 
-    void Body::implicitEulerIntegrator(atlas::core::Time<> const& t)
+    void Body::gatherInstances()
     {
-        //mass 1
-        mVelocity += mVelocity + t.deltaTime * (mForce / mMass);
-        mPosition += mOldPosition + t.deltaTime * mVelocity;
+        namespace math = atlas::math;
 
-        //star 1
-        s1Velocity += s1Velocity + t.deltaTime * (s1Force / s1Mass);
-        s1Position += s1OldPosition + t.deltaTime * s1Velocity;
+        // The instances mirror the simulation's layout: radii and colours
+        // are only refreshed when bodies were added, removed or reordered.
+        auto const& state = mSimulation.state();
+        if (state.layout != mInstanceLayout)
+        {
+            mInstanceLayout = state.layout;
+            mInstances.resize(state.x.size());
+            for (std::size_t i = 0; i < state.x.size(); ++i)
+            {
+                std::uint32_t c = state.colour[i];
+                mInstances[i].sphere.w = state.radius[i];
+                mInstances[i].colour = math::Vector4((c >> 24) & 0xff,
+                    (c >> 16) & 0xff, (c >> 8) & 0xff, c & 0xff) / 255.0f;
+            }
+        }
 
-        //star 2
-        s2Velocity += s2Velocity + t.deltaTime * (s2Force / s2Mass);
-        s2Position += s2OldPosition + t.deltaTime * s2Velocity;
+        for (std::size_t i = 0; i < state.x.size(); ++i)
+        {
+            mInstances[i].sphere.x = state.x[i];
+            mInstances[i].sphere.y = state.y[i];
+            mInstances[i].sphere.z = state.z[i];
+        }
     }
 
-    void Body::verletIntegrator(atlas::core::Time<> const& t)
+    void Body::cullInstances(atlas::math::Matrix4 const& projection,
+        atlas::math::Matrix4 const& view)
     {
-        //mass 1
-        atlas::math::Vector mtmp = mPosition;
-        mPosition += mPosition - mOldPosition + t.deltaTime * t.deltaTime * (mForce / mMass);
-        mOldPosition = mtmp;
-
-        //star 1
-        atlas::math::Vector s1tmp = s1Position;
-        s1Position += s1Position - s1OldPosition + t.deltaTime * t.deltaTime * (s1Force / s1Mass);
-        s1OldPosition = s1tmp;
-
-        //star 2
-        atlas::math::Vector s2tmp = s2Position;
-        s2Position += s2Position - s2OldPosition + t.deltaTime * t.deltaTime * (s2Force / s2Mass);
-        s2OldPosition = s2tmp;
+        mVisible.clear();
+        if (!mCulling)
+        {
+            for (std::size_t i = 0; i < mInstances.size(); ++i)
+            {
+                mVisible.push_back(static_cast<std::uint32_t>(i));
+            }
+            return;
+        }
+
+        // Instances are in model space, so the frustum is too.
+        mVisibilityGrid.build(mInstances);
+        mVisibilityGrid.query(Frustum(projection * view * mModel), mVisible);
     }
 
-    void Body::rk4Integrator(atlas::core::Time<> const& t)
+    void Body::selectLevels(atlas::math::Matrix4 const& projection,
+        atlas::math::Matrix4 const& view)
     {
         namespace math = atlas::math;
 
-        //Mass 1 Position
-        math::Vector pk1 = mVelocity;
-        math::Vector pk2 = mVelocity + 0.5f * t.deltaTime * pk1;
-        math::Vector pk3 = mVelocity + 0.5f * t.deltaTime * pk2;
-        math::Vector pk4 = mVelocity + t.deltaTime * pk3;
-        mPosition += mOldPosition + t.deltaTime * (pk1 + 2.0f * pk2 + 2.0f * pk3 + pk4) / 6.0f;
-
-        //Mass 1 Velocity
-        math::Vector vk1 = (mForce / mMass);
-        math::Vector vk2 = (mForce / mMass) + 0.5f * t.deltaTime * vk1;
-        math::Vector vk3 = (mForce / mMass) + 0.5f * t.deltaTime * vk2;
-        math::Vector vk4 = (mForce / mMass) + t.deltaTime * vk3;
-        mVelocity += mVelocity + t.deltaTime * (vk1 + 2.0f * vk2 + 2.0f * vk3 + vk4) / 6.0f;
-
-        //Star 1 Position
-        pk1 = s1Velocity;
-        pk2 = s1Velocity + 0.5f * t.deltaTime * pk1;
-        pk3 = s1Velocity + 0.5f * t.deltaTime * pk2;
-        pk4 = s1Velocity + t.deltaTime * pk3;
-        s1Position += s1OldPosition + t.deltaTime * (pk1 + 2.0f * pk2 + 2.0f * pk3 + pk4) / 6.0f;
-
-        //Star 1 Velocity
-        vk1 = (s1Force / s1Mass);
-        vk2 = (s1Force / s1Mass) + 0.5f * t.deltaTime * vk1;
-        vk3 = (s1Force / s1Mass) + 0.5f * t.deltaTime * vk2;
-        vk4 = (s1Force / s1Mass) + t.deltaTime * vk3;
-        s1Velocity += s1Velocity + t.deltaTime * (vk1 + 2.0f * vk2 + 2.0f * vk3 + vk4) / 6.0f;
-
-        //Star 2 Position
-        pk1 = s2Velocity;
-        pk2 = s2Velocity + 0.5f * t.deltaTime * pk1;
-        pk3 = s2Velocity + 0.5f * t.deltaTime * pk2;
-        pk4 = s2Velocity + t.deltaTime * pk3;
-        s2Position += s2OldPosition + t.deltaTime * (pk1 + 2.0f * pk2 + 2.0f * pk3 + pk4) / 6.0f;
-
-        //Star 2 Velocity
-        vk1 = (s2Force / s2Mass);
-        vk2 = (s2Force / s2Mass) + 0.5f * t.deltaTime * vk1;
-        vk3 = (s2Force / s2Mass) + 0.5f * t.deltaTime * vk2;
-        vk4 = (s2Force / s2Mass) + t.deltaTime * vk3;
-        s2Velocity += s2Velocity + t.deltaTime * (vk1 + 2.0f * vk2 + 2.0f * vk3 + vk4) / 6.0f;
+        math::Matrix4 modelView = view * mModel;
+        float modelScale = glm::length(math::Vector(mModel[0]));
+        float pixelsPerUnit = 0.5f * projection[1][1] * mViewportHeight;
+
+        // Both lists last only until the frame's draws are issued.
+        mLevelCount.fill(0);
+        auto levels = mFrameArena.allocate<unsigned char>(mVisible.size());
+
+        for (std::size_t i = 0; i < mVisible.size(); ++i)
+        {
+            auto const& sphere = mInstances[mVisible[i]].sphere;
+            float depth = -(modelView * math::Vector4(
+                sphere.x, sphere.y, sphere.z, 1.0f)).z;
+            float radius = sphere.w * modelScale;
+
+            // Bodies behind the camera are clipped anyway, so they take the
+            // cheapest path; the camera inside a body takes the finest.
+            std::size_t level = 0;
+            if (depth <= -radius)
+            {
+                level = ImpostorLevel;
+            }
+            else if (depth > radius)
+            {
+                float pixels = radius * pixelsPerUnit / depth;
+                while (level < MeshLevels &&
+                    pixels < mLevelPixels[level] * mLodScale)
+                {
+                    ++level;
+                }
+            }
+
+            levels[i] = static_cast<unsigned char>(level);
+            ++mLevelCount[level];
+        }
+
+        std::size_t first = 0;
+        for (std::size_t level = 0; level <= MeshLevels; ++level)
+        {
+            mLevelFirst[level] = first;
+            first += mLevelCount[level];
+        }
+
+        auto cursor = mLevelFirst;
+        mSortedInstances = mFrameArena.allocate<BodyInstance>(
+            mVisible.size());
+        for (std::size_t i = 0; i < mVisible.size(); ++i)
+        {
+            mSortedInstances[cursor[levels[i]]++] =
+                mInstances[mVisible[i]];
+        }
     }
 
-    float Body::gravity(atlas::math::Vector m1_pos, atlas::math::Vector m2_pos, float m1_mass, float m2_mass)
+    void Body::pointInstances(std::size_t first)
     {
-        float distance = (m1_pos - m2_pos).length();
-        return g * m1_mass * m2_mass / distance * distance;
+        namespace gl = atlas::gl;
+
+        const std::size_t floats = sizeof(BodyInstance) / sizeof(float);
+        mInstanceBuffer.vertexAttribPointer(INSTANCE_SPHERE_LAYOUT_LOCATION, 4,
+            GL_FLOAT, GL_FALSE, gl::stride<BodyInstance>(1),
+            gl::bufferOffset<float>(first * floats));
+        mInstanceBuffer.vertexAttribPointer(INSTANCE_COLOUR_LAYOUT_LOCATION, 4,
+            GL_FLOAT, GL_FALSE, gl::stride<BodyInstance>(1),
+            gl::bufferOffset<float>(first * floats + 4));
     }
 
+    void Body::resetGeometry()
+    {
+        // The trails are cleared when the reset state comes back.
+        mSimulation.send(SimulationCommand::Reset);
+    }
 }
@@ -0,0 +1,259 @@
+#include "Collisions.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace bstar
+{
+    namespace
+    {
+        std::int64_t cellOf(double coordinate, double cellSize)
+        {
+            return static_cast<std::int64_t>(std::floor(coordinate / cellSize));
+        }
+
+        // First time in [0, 1] at which two spheres moving in straight
+        // lines touch, or a negative value if they do not.
+        double sweptContact(double sx, double sy, double sz, double dx,
+            double dy, double dz, double reach)
+        {
+            double c = sx * sx + sy * sy + sz * sz - reach * reach;
+            if (c <= 0.0)
+            {
+                return 0.0;
+            }
+
+            double a = dx * dx + dy * dy + dz * dz;
+            double b = 2.0 * (sx * dx + sy * dy + sz * dz);
+            if (a == 0.0 || b >= 0.0)
+            {
+                return -1.0;
+            }
+
+            double discriminant = b * b - 4.0 * a * c;
+            if (discriminant < 0.0)
+            {
+                return -1.0;
+            }
+
+            double t = (-b - std::sqrt(discriminant)) / (2.0 * a);
+            return (t <= 1.0) ? t : -1.0;
+        }
+    }
+
+    Collisions::Collisions() :
+        mCellSize(1.0),
+        mBucketMask(0)
+    { }
+
+    std::size_t Collisions::resolve(Particles& particles,
+        BodyArray const& x0, BodyArray const& y0, BodyArray const& z0)
+    {
+        mContacts.clear();
+        if (particles.size() < 2)
+        {
+            return 0;
+        }
+
+        buildHash(particles, x0, y0, z0);
+        findContacts(particles, x0, y0, z0);
+        return merge(particles);
+    }
+
+    std::vector<Contact> const& Collisions::contacts() const
+    {
+        return mContacts;
+    }
+
+    void Collisions::buildHash(Particles const& particles,
+        BodyArray const& x0, BodyArray const& y0, BodyArray const& z0)
+    {
+        std::size_t count = particles.size();
+
+        // A pair can only touch if their start positions are within the
+        // sum of their radii and displacements, so cells that wide make
+        // the 27 neighbouring cells sufficient.
+        double maxRadius = 0.0;
+        double maxMove2 = 0.0;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            double dx = particles.x[i] - x0[i];
+            double dy = particles.y[i] - y0[i];
+            double dz = particles.z[i] - z0[i];
+            maxRadius = std::max(maxRadius, particles.radius[i]);
+            maxMove2 = std::max(maxMove2, dx * dx + dy * dy + dz * dz);
+        }
+        mCellSize = std::max(2.0 * (maxRadius + std::sqrt(maxMove2)), 1e-9);
+
+        std::uint32_t buckets = 1;
+        while (buckets < 2 * count)
+        {
+            buckets <<= 1;
+        }
+        mBucketMask = buckets - 1;
+
+        mBucketStart.assign(buckets + 1, 0);
+        mItemBuckets.resize(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            std::uint32_t bucket = bucketOf(cellOf(x0[i], mCellSize),
+                cellOf(y0[i], mCellSize), cellOf(z0[i], mCellSize));
+            mItemBuckets[i] = bucket;
+            ++mBucketStart[bucket + 1];
+        }
+
+        for (std::uint32_t b = 0; b < buckets; ++b)
+        {
+            mBucketStart[b + 1] += mBucketStart[b];
+        }
+
+        mBucketItems.resize(count);
+        mBucketCursor.assign(mBucketStart.begin(), mBucketStart.end() - 1);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            mBucketItems[mBucketCursor[mItemBuckets[i]]++] =
+                static_cast<std::uint32_t>(i);
+        }
+    }
+
+    void Collisions::findContacts(Particles const& particles,
+        BodyArray const& x0, BodyArray const& y0, BodyArray const& z0)
+    {
+        std::size_t count = particles.size();
+        std::uint32_t visited[27];
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            std::int64_t cx = cellOf(x0[i], mCellSize);
+            std::int64_t cy = cellOf(y0[i], mCellSize);
+            std::int64_t cz = cellOf(z0[i], mCellSize);
+
+            double dxi = particles.x[i] - x0[i];
+            double dyi = particles.y[i] - y0[i];
+            double dzi = particles.z[i] - z0[i];
+
+            // Different cells can hash to the same bucket; visiting it
+            // twice would report the same pair twice.
+            int visitedCount = 0;
+            for (int oz = -1; oz <= 1; ++oz)
+            {
+                for (int oy = -1; oy <= 1; ++oy)
+                {
+                    for (int ox = -1; ox <= 1; ++ox)
+                    {
+                        std::uint32_t bucket = bucketOf(cx + ox, cy + oy,
+                            cz + oz);
+                        if (std::find(visited, visited + visitedCount,
+                            bucket) != visited + visitedCount)
+                        {
+                            continue;
+                        }
+                        visited[visitedCount++] = bucket;
+
+                        for (std::uint32_t k = mBucketStart[bucket];
+                            k < mBucketStart[bucket + 1]; ++k)
+                        {
+                            std::uint32_t j = mBucketItems[k];
+                            if (j <= i)
+                            {
+                                continue;
+                            }
+
+                            double t = sweptContact(
+                                x0[j] - x0[i], y0[j] - y0[i], z0[j] - z0[i],
+                                (particles.x[j] - x0[j]) - dxi,
+                                (particles.y[j] - y0[j]) - dyi,
+                                (particles.z[j] - z0[j]) - dzi,
+                                particles.radius[i] + particles.radius[j]);
+                            if (t >= 0.0)
+                            {
+                                mContacts.push_back({ t,
+                                    static_cast<std::uint32_t>(i), j });
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    std::size_t Collisions::merge(Particles& particles)
+    {
+        // Earliest contacts first; a body merges at most once per step and
+        // any later contact it had is found again next step.
+        std::sort(mContacts.begin(), mContacts.end(),
+            [](Contact const& a, Contact const& b)
+        {
+            return a.time < b.time;
+        });
+
+        mConsumed.assign(particles.size(), 0);
+        mRemoved.clear();
+
+        for (auto const& contact : mContacts)
+        {
+            std::uint32_t keep = contact.first;
+            std::uint32_t gone = contact.second;
+            if (mConsumed[keep] || mConsumed[gone])
+            {
+                continue;
+            }
+
+            // The heavier body survives and keeps its id and colour.
+            if (particles.mass[gone] > particles.mass[keep])
+            {
+                std::swap(keep, gone);
+            }
+
+            // Perfectly inelastic: momentum and mass are conserved, the
+            // merged body sits at the centre of mass and keeps the total
+            // volume.
+            double m1 = particles.mass[keep];
+            double m2 = particles.mass[gone];
+            double m = m1 + m2;
+            double w1 = (m > 0.0) ? m1 / m : 0.5;
+            double w2 = 1.0 - w1;
+
+            particles.x[keep] = w1 * particles.x[keep] + w2 * particles.x[gone];
+            particles.y[keep] = w1 * particles.y[keep] + w2 * particles.y[gone];
+            particles.z[keep] = w1 * particles.z[keep] + w2 * particles.z[gone];
+            particles.vx[keep] = w1 * particles.vx[keep] +
+                w2 * particles.vx[gone];
+            particles.vy[keep] = w1 * particles.vy[keep] +
+                w2 * particles.vy[gone];
+            particles.vz[keep] = w1 * particles.vz[keep] +
+                w2 * particles.vz[gone];
+            particles.mass[keep] = m;
+            particles.radius[keep] = std::cbrt(
+                std::pow(particles.radius[keep], 3.0) +
+                std::pow(particles.radius[gone], 3.0));
+
+            mConsumed[keep] = 1;
+            mConsumed[gone] = 1;
+            mRemoved.push_back(gone);
+        }
+
+        // Removing from the back keeps the indices still to be removed
+        // valid, since a swap-remove only moves the last body.
+        std::sort(mRemoved.begin(), mRemoved.end(),
+            [](std::uint32_t a, std::uint32_t b)
+        {
+            return a > b;
+        });
+        for (std::uint32_t index : mRemoved)
+        {
+            particles.remove(index);
+        }
+
+        return mRemoved.size();
+    }
+
+    std::uint32_t Collisions::bucketOf(std::int64_t cx, std::int64_t cy,
+        std::int64_t cz) const
+    {
+        std::uint64_t h = static_cast<std::uint64_t>(cx) * 73856093ull ^
+            static_cast<std::uint64_t>(cy) * 19349663ull ^
+            static_cast<std::uint64_t>(cz) * 83492791ull;
+        return static_cast<std::uint32_t>(h) & mBucketMask;
+    }
+}
@@ -0,0 +1,61 @@
+#include "ForceBackend.hpp"
+
+namespace bstar
+{
+    namespace
+    {
+        template <class Law, class Term>
+        void sumPairs(PairArrays const& bodies, std::size_t count,
+            Law const& law, Term const& term)
+        {
+            // Each pair is visited once and pushes both bodies.
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                for (std::size_t j = i + 1; j < count; ++j)
+                {
+                    gravityPair(bodies, i, j, ForceBackend::G, law, term);
+                }
+            }
+        }
+    }
+
+    void ForceBackend::setForceTerms(ForceTerms const& terms)
+    {
+        mForceTerms = terms;
+    }
+
+    ForceTerms const& ForceBackend::forceTerms() const
+    {
+        return mForceTerms;
+    }
+
+    void ForceBackend::setForceLaw(ForceLaw const& law)
+    {
+        mForceLaw = law;
+    }
+
+    ForceLaw const& ForceBackend::forceLaw() const
+    {
+        return mForceLaw;
+    }
+
+    void DirectForce::accelerations(BodyArray const& x, BodyArray const& y,
+        BodyArray const& z, BodyArray const& vx, BodyArray const& vy,
+        BodyArray const& vz, BodyArray const& mass, BodyArray& ax,
+        BodyArray& ay, BodyArray& az)
+    {
+        std::size_t count = mass.size();
+
+        ax.assign(count, 0.0);
+        ay.assign(count, 0.0);
+        az.assign(count, 0.0);
+
+        PairArrays bodies = { x.data(), y.data(), z.data(), vx.data(),
+            vy.data(), vz.data(), mass.data(), ax.data(), ay.data(),
+            az.data() };
+        visitKernels([&](auto const& law, auto const& term)
+        {
+            sumPairs(bodies, count, law, term);
+        });
+    }
+}
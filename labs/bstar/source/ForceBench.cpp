@@ -0,0 +1,374 @@
+// Headless benchmark of the Verlet integrators on a cloud of bodies.
+//
+// Each body count is run with plain Verlet, where the direct sum writes
+// accelerations out and the kicks read them back; with plain Verlet over
+// the tiled, threaded direct sum; and with fused Verlet, where each block
+// of targets is kicked and drifted as soon as its accelerations are
+// summed. All start from the same cloud, so the final states should agree
+// with plain Verlet's to rounding; the default step moves the bodies by a
+// fair fraction of their spacing, so that agreement means something.
+// Traffic is a model of the bytes each integrator streams through memory
+// outside the pair loop per body-step.
+//
+// Rates count useful interactions, n(n - 1) / 2 per step, whichever way a
+// kernel gets them; the fused kernel evaluates every ordered pair, and
+// the work that repeats is reported on its own.
+//
+// Usage: bstar_bench [--bodies N[,N...]] [--steps N] [--dt DT]
+//        [--threads N] [--law newtonian|plummer|spline|table]
+//        [--softening EPS] [--format csv|json] [--out FILE]
+//
+// The table law samples the Plummer law, to time the interpolation.
+
+#include "Simulation.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using namespace bstar;
+
+    struct BenchOptions
+    {
+        std::vector<std::size_t> bodies = { 256, 1024, 4096 };
+        std::size_t steps = 20;
+        double dt = 0.1;
+        // For the tiled sum; 0 uses one per hardware thread.
+        std::size_t threads = 0;
+        std::string law = "newtonian";
+        double softening = ForceLaw().softening;
+        std::string format = "csv";
+        std::string out;
+    };
+
+    struct BenchResult
+    {
+        std::size_t bodies;
+        const char* integrator;
+        double nsPerStep;
+        double pairsPerSecond;
+        double gflops;
+        double redundantGflops;
+        double bytesPerBodyStep;
+        double flopsPerByte;
+        double maxDisplacement;
+        double maxDeviation;
+    };
+
+    // Doubles streamed per body-step outside the pair loop, including the
+    // start-of-step position copy both make for the collision sweep.
+    // Plain: kick-drift reads x, v, a and writes x, v; the force clears,
+    // loads and stores a and loads x and mass; the closing kick reads v, a
+    // and writes v. Fused: reads x and the half-step v, writes v, the
+    // half-step v and the next x.
+    constexpr double PlainDoubles = 6.0 + 15.0 + 13.0 + 9.0;
+    constexpr double FusedDoubles = 6.0 + 15.0;
+
+    // Rough flop counts per pair evaluated: the symmetric kernels push
+    // both bodies, the fused one only its target but visits every ordered
+    // pair. One useful interaction is what the symmetric kernels spend.
+    constexpr double PlainPairFlops = 26.0;
+    constexpr double FusedPairFlops = 20.0;
+    constexpr double UsefulPairFlops = PlainPairFlops;
+
+    bool parseOptions(int argc, char** argv, BenchOptions& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (i + 1 >= argc)
+            {
+                std::fprintf(stderr, "missing value for %s\n", arg.c_str());
+                return false;
+            }
+
+            const char* value = argv[++i];
+            if (arg == "--bodies")
+            {
+                options.bodies.clear();
+                char* end = const_cast<char*>(value);
+                do
+                {
+                    const char* start = (*end == ',') ? end + 1 : end;
+                    std::size_t count = std::strtoul(start, &end, 10);
+                    if (end == start || count < 2)
+                    {
+                        return false;
+                    }
+                    options.bodies.push_back(count);
+                } while (*end == ',');
+
+                if (*end != '\0')
+                {
+                    return false;
+                }
+            }
+            else if (arg == "--steps")
+            {
+                options.steps = std::strtoul(value, nullptr, 10);
+            }
+            else if (arg == "--dt")
+            {
+                options.dt = std::strtod(value, nullptr);
+            }
+            else if (arg == "--threads")
+            {
+                options.threads = std::strtoul(value, nullptr, 10);
+            }
+            else if (arg == "--law")
+            {
+                options.law = value;
+            }
+            else if (arg == "--softening")
+            {
+                options.softening = std::strtod(value, nullptr);
+            }
+            else if (arg == "--format")
+            {
+                options.format = value;
+            }
+            else if (arg == "--out")
+            {
+                options.out = value;
+            }
+            else
+            {
+                std::fprintf(stderr, "unknown option %s\n", arg.c_str());
+                return false;
+            }
+        }
+
+        return options.steps > 0 && options.dt > 0.0 &&
+            options.softening > 0.0 &&
+            (options.law == "newtonian" || options.law == "plummer" ||
+                options.law == "spline" || options.law == "table") &&
+            (options.format == "csv" || options.format == "json");
+    }
+
+    ForceLaw makeForceLaw(BenchOptions const& options)
+    {
+        ForceLaw law;
+        law.softening = options.softening;
+        if (options.law == "plummer")
+        {
+            law.kind = ForceLawKind::Plummer;
+        }
+        else if (options.law == "spline")
+        {
+            law.kind = ForceLawKind::Spline;
+        }
+        else if (options.law == "table")
+        {
+            law = tabulateForceLaw(PlummerLaw(options.softening),
+                20.0 * options.softening, 4096);
+        }
+        return law;
+    }
+
+    // A Gaussian cloud of equal masses at rest, the same for every run.
+    void fillCloud(Simulation& simulation, std::size_t count)
+    {
+        std::mt19937 rng(1);
+        std::normal_distribution<double> offset(0.0, 10.0);
+
+        auto& particles = simulation.particles();
+        particles.clear();
+        particles.reserve(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            particles.add(offset(rng), offset(rng), offset(rng), 0.0, 0.0,
+                0.0, 1.0e10, 0.01, 0xffffffff);
+        }
+    }
+
+    double timeSteps(Simulation& simulation, BenchOptions const& options)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        // One untimed step so both start with their accelerations ready.
+        simulation.step(options.dt);
+        auto start = Clock::now();
+        for (std::size_t s = 0; s < options.steps; ++s)
+        {
+            simulation.step(options.dt);
+        }
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    struct BenchCase
+    {
+        const char* name;
+        Integrator integrator;
+        ForceMethod method;
+        double doubles;
+        double pairFlops;
+        bool symmetric;
+    };
+
+    void runBodies(BenchOptions const& options, std::size_t count,
+        std::vector<BenchResult>& results)
+    {
+        const BenchCase cases[] = {
+            { "verlet", Integrator::Verlet, ForceMethod::Direct,
+                PlainDoubles, PlainPairFlops, true },
+            { "verlet_tiled", Integrator::Verlet, ForceMethod::Tiled,
+                PlainDoubles, PlainPairFlops, true },
+            { "fused_verlet", Integrator::FusedVerlet, ForceMethod::Direct,
+                FusedDoubles, FusedPairFlops, false }
+        };
+
+        // Starting positions, and final positions of the first case, which
+        // the others are measured against.
+        BodyArray startX, startY, startZ;
+        BodyArray referenceX, referenceY, referenceZ;
+        ForceLaw law = makeForceLaw(options);
+        for (auto const& c : cases)
+        {
+            Simulation simulation;
+            simulation.setCollisions(false);
+            simulation.setSortInterval(0);
+            simulation.setIntegrator(c.integrator);
+            simulation.setForceMethod(c.method);
+            simulation.setForceLaw(law);
+            simulation.tiledForce().setThreads(options.threads);
+            fillCloud(simulation, count);
+            auto const& p = simulation.particles();
+            if (&c == cases)
+            {
+                startX = p.x;
+                startY = p.y;
+                startZ = p.z;
+            }
+
+            double seconds = timeSteps(simulation, options);
+            if (&c == cases)
+            {
+                referenceX = p.x;
+                referenceY = p.y;
+                referenceZ = p.z;
+            }
+
+            double displacement = 0.0;
+            double deviation = 0.0;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                displacement = std::max({ displacement,
+                    std::abs(startX[i] - p.x[i]),
+                    std::abs(startY[i] - p.y[i]),
+                    std::abs(startZ[i] - p.z[i]) });
+                deviation = std::max({ deviation,
+                    std::abs(referenceX[i] - p.x[i]),
+                    std::abs(referenceY[i] - p.y[i]),
+                    std::abs(referenceZ[i] - p.z[i]) });
+            }
+
+            double n = static_cast<double>(count);
+            double steps = static_cast<double>(options.steps);
+            double pairs = 0.5 * n * (n - 1.0);
+            double evaluated = c.symmetric ? pairs : n * (n - 1.0);
+            double usefulFlops = UsefulPairFlops * pairs;
+            double redundantFlops = c.pairFlops * evaluated - usefulFlops;
+
+            BenchResult r;
+            r.bodies = count;
+            r.integrator = c.name;
+            r.nsPerStep = 1e9 * seconds / steps;
+            r.pairsPerSecond = pairs * steps / seconds;
+            r.gflops = 1e-9 * usefulFlops * steps / seconds;
+            r.redundantGflops = 1e-9 * redundantFlops * steps / seconds;
+            r.bytesPerBodyStep = 8.0 * c.doubles;
+            r.flopsPerByte = usefulFlops / (r.bytesPerBodyStep * n);
+            r.maxDisplacement = displacement;
+            r.maxDeviation = deviation;
+            results.push_back(r);
+        }
+    }
+
+    void writeCsv(std::FILE* out, std::vector<BenchResult> const& results)
+    {
+        std::fprintf(out, "bodies,integrator,ns_per_step,pairs_per_second,"
+            "gflops,redundant_gflops,bytes_per_body_step,flops_per_byte,"
+            "max_displacement,max_deviation\n");
+        for (auto const& r : results)
+        {
+            std::fprintf(out, "%zu,%s,%.1f,%.4g,%.2f,%.2f,%.0f,%.4g,%.3g,"
+                "%.3e\n", r.bodies, r.integrator, r.nsPerStep,
+                r.pairsPerSecond, r.gflops, r.redundantGflops,
+                r.bytesPerBodyStep, r.flopsPerByte, r.maxDisplacement,
+                r.maxDeviation);
+        }
+    }
+
+    void writeJson(std::FILE* out, BenchOptions const& options,
+        std::vector<BenchResult> const& results)
+    {
+        std::fprintf(out, "{\n  \"steps\": %zu,\n  \"dt\": %.9g,\n"
+            "  \"results\": [\n", options.steps, options.dt);
+        for (std::size_t i = 0; i < results.size(); ++i)
+        {
+            auto const& r = results[i];
+            std::fprintf(out, "    {\"bodies\": %zu, \"integrator\": \"%s\", "
+                "\"ns_per_step\": %.1f, \"pairs_per_second\": %.4g, "
+                "\"gflops\": %.2f, \"redundant_gflops\": %.2f, "
+                "\"bytes_per_body_step\": %.0f, \"flops_per_byte\": %.4g, "
+                "\"max_displacement\": %.3g, "
+                "\"max_deviation\": %.3e}%s\n", r.bodies, r.integrator,
+                r.nsPerStep, r.pairsPerSecond, r.gflops, r.redundantGflops,
+                r.bytesPerBodyStep, r.flopsPerByte, r.maxDisplacement,
+                r.maxDeviation,
+                (i + 1 < results.size()) ? "," : "");
+        }
+        std::fprintf(out, "  ]\n}\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        std::fprintf(stderr, "usage: %s [--bodies N[,N...]] [--steps N] "
+            "[--dt DT] [--threads N] [--law newtonian|plummer|spline|table] "
+            "[--softening EPS] [--format csv|json] [--out FILE]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<BenchResult> results;
+    for (std::size_t count : options.bodies)
+    {
+        runBodies(options, count, results);
+    }
+
+    std::FILE* out = stdout;
+    if (!options.out.empty())
+    {
+        out = std::fopen(options.out.c_str(), "w");
+        if (out == nullptr)
+        {
+            std::fprintf(stderr, "could not open %s\n", options.out.c_str());
+            return 1;
+        }
+    }
+
+    if (options.format == "json")
+    {
+        writeJson(out, options, results);
+    }
+    else
+    {
+        writeCsv(out, results);
+    }
+
+    if (out != stdout)
+    {
+        std::fclose(out);
+    }
+    return 0;
+}
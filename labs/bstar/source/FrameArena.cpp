@@ -0,0 +1,112 @@
+#include "FrameArena.hpp"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+
+namespace bstar
+{
+    namespace
+    {
+        std::size_t paddingFor(std::uintptr_t address, std::size_t alignment)
+        {
+            return static_cast<std::size_t>(
+                (alignment - address % alignment) % alignment);
+        }
+    }
+
+    FrameArena::FrameArena(std::size_t capacity) :
+        mBlock(new unsigned char[capacity]),
+        mCapacity(capacity),
+        mOffset(0),
+        mHighWater(0),
+        mOverflows(0),
+        mSpilled(0)
+    {
+        // Room for a few overflows, so taking one does not also grow this.
+        mSpill.reserve(16);
+    }
+
+    void* FrameArena::allocate(std::size_t bytes, std::size_t alignment)
+    {
+        auto base = reinterpret_cast<std::uintptr_t>(mBlock.get());
+        std::size_t padding = paddingFor(base + mOffset, alignment);
+        if (mOffset + padding + bytes <= mCapacity)
+        {
+            void* memory = mBlock.get() + mOffset + padding;
+            mOffset += padding + bytes;
+            return memory;
+        }
+
+        // Each overflow gets a block of its own; there are few of them,
+        // and only until the next reset grows the arena.
+        std::size_t size = bytes + alignment;
+        mSpill.emplace_back(new unsigned char[size]);
+        mSpilled += size;
+        ++mOverflows;
+
+        auto spill = reinterpret_cast<std::uintptr_t>(mSpill.back().get());
+        return mSpill.back().get() + paddingFor(spill, alignment);
+    }
+
+    const char* FrameArena::format(const char* fmt, ...)
+    {
+        std::va_list args;
+        va_start(args, fmt);
+        std::va_list copy;
+        va_copy(copy, args);
+        int length = std::vsnprintf(nullptr, 0, fmt, copy);
+        va_end(copy);
+
+        if (length < 0)
+        {
+            va_end(args);
+            return "";
+        }
+
+        auto text = allocate<char>(static_cast<std::size_t>(length) + 1);
+        std::vsnprintf(text, static_cast<std::size_t>(length) + 1, fmt,
+            args);
+        va_end(args);
+        return text;
+    }
+
+    void FrameArena::reset()
+    {
+        std::size_t frame = mOffset + mSpilled;
+        mHighWater = std::max(mHighWater, frame);
+
+        if (!mSpill.empty())
+        {
+            mSpill.clear();
+
+            // With headroom, so slowly growing frames do not regrow it
+            // every time.
+            mCapacity = frame + frame / 2;
+            mBlock.reset(new unsigned char[mCapacity]);
+        }
+
+        mOffset = 0;
+        mSpilled = 0;
+    }
+
+    std::size_t FrameArena::used() const
+    {
+        return mOffset + mSpilled;
+    }
+
+    std::size_t FrameArena::capacity() const
+    {
+        return mCapacity;
+    }
+
+    std::size_t FrameArena::highWater() const
+    {
+        return mHighWater;
+    }
+
+    std::size_t FrameArena::overflows() const
+    {
+        return mOverflows;
+    }
+}
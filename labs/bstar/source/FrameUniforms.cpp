@@ -0,0 +1,46 @@
+#include "FrameUniforms.hpp"
+
+namespace bstar
+{
+    FrameUniforms::FrameUniforms() :
+        mBuffer(0)
+    {
+        namespace math = atlas::math;
+
+        glGenBuffers(1, &mBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(math::Matrix4), nullptr,
+            GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        glBindBufferBase(GL_UNIFORM_BUFFER, BindingPoint, mBuffer);
+    }
+
+    FrameUniforms::~FrameUniforms()
+    {
+        glDeleteBuffers(1, &mBuffer);
+    }
+
+    void FrameUniforms::update(atlas::math::Matrix4 const& projection,
+        atlas::math::Matrix4 const& view)
+    {
+        namespace math = atlas::math;
+
+        // std140 lays two mat4s out back to back, same as in memory.
+        glBindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(math::Matrix4),
+            &projection[0][0]);
+        glBufferSubData(GL_UNIFORM_BUFFER, sizeof(math::Matrix4),
+            sizeof(math::Matrix4), &view[0][0]);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void FrameUniforms::bindProgram(GLuint program)
+    {
+        GLuint block = glGetUniformBlockIndex(program, "Matrices");
+        if (block != GL_INVALID_INDEX)
+        {
+            glUniformBlockBinding(program, block, BindingPoint);
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#include "Frustum.hpp"
+
+namespace bstar
+{
+    Frustum::Frustum(atlas::math::Matrix4 const& clipFromModel)
+    {
+        namespace math = atlas::math;
+
+        // Each plane is the last row of the matrix plus or minus one of the
+        // others (Gribb and Hartmann). glm stores columns, so row i is the
+        // i-th component of every column.
+        auto row = [&clipFromModel](int i)
+        {
+            return math::Vector4(clipFromModel[0][i], clipFromModel[1][i],
+                clipFromModel[2][i], clipFromModel[3][i]);
+        };
+
+        mPlanes[0] = row(3) + row(0);
+        mPlanes[1] = row(3) - row(0);
+        mPlanes[2] = row(3) + row(1);
+        mPlanes[3] = row(3) - row(1);
+        mPlanes[4] = row(3) + row(2);
+        mPlanes[5] = row(3) - row(2);
+
+        for (auto& plane : mPlanes)
+        {
+            plane = plane / glm::length(math::Vector(plane));
+        }
+    }
+
+    bool Frustum::intersectsSphere(atlas::math::Point const& centre,
+        float radius) const
+    {
+        for (auto const& plane : mPlanes)
+        {
+            if (plane.x * centre.x + plane.y * centre.y + plane.z * centre.z +
+                plane.w < -radius)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    Containment Frustum::classifyBox(atlas::math::Point const& min,
+        atlas::math::Point const& max) const
+    {
+        Containment result = Containment::Inside;
+        for (auto const& plane : mPlanes)
+        {
+            // The corners furthest along and against the plane normal.
+            float outer = plane.w +
+                plane.x * (plane.x > 0.0f ? max.x : min.x) +
+                plane.y * (plane.y > 0.0f ? max.y : min.y) +
+                plane.z * (plane.z > 0.0f ? max.z : min.z);
+            if (outer < 0.0f)
+            {
+                return Containment::Outside;
+            }
+
+            float inner = plane.w +
+                plane.x * (plane.x > 0.0f ? min.x : max.x) +
+                plane.y * (plane.y > 0.0f ? min.y : max.y) +
+                plane.z * (plane.z > 0.0f ? min.z : max.z);
+            if (inner < 0.0f)
+            {
+                result = Containment::Intersecting;
+            }
+        }
+
+        return result;
+    }
+}
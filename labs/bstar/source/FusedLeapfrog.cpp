@@ -0,0 +1,188 @@
+#include "FusedLeapfrog.hpp"
+#include "ForceBackend.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace bstar
+{
+    namespace
+    {
+        void gather(BodyArray& values, std::vector<std::uint32_t> const& order,
+            BodyArray& scratch)
+        {
+            // The look-ahead positions end up in Particles, so they keep
+            // its reservation.
+            scratch.reserveStable(values.reservation());
+            scratch.resize(order.size());
+            for (std::size_t i = 0; i < order.size(); ++i)
+            {
+                scratch[i] = values[order[i]];
+            }
+            values.swap(scratch);
+        }
+
+        // Accelerations of targets [first, first + Width) due to every body,
+        // clamped to the last body for a short final block.
+        template <class Law>
+        void blockAccelerations(Particles const& particles, std::size_t first,
+            Law const& law, double* ax, double* ay, double* az)
+        {
+            constexpr std::size_t Width = FusedLeapfrog::Width;
+            constexpr double G = ForceBackend::G;
+
+            std::size_t count = particles.size();
+            double const* x = particles.x.data();
+            double const* y = particles.y.data();
+            double const* z = particles.z.data();
+            double const* mass = particles.mass.data();
+
+            // Targets and sums live in locals rather than behind the output
+            // pointers, so the compiler can see they alias nothing and keep
+            // them in registers.
+            double tx[Width];
+            double ty[Width];
+            double tz[Width];
+            double sumX[Width];
+            double sumY[Width];
+            double sumZ[Width];
+            for (std::size_t t = 0; t < Width; ++t)
+            {
+                std::size_t i = std::min(first + t, count - 1);
+                tx[t] = x[i];
+                ty[t] = y[i];
+                tz[t] = z[i];
+                sumX[t] = 0.0;
+                sumY[t] = 0.0;
+                sumZ[t] = 0.0;
+            }
+
+            // One source against a whole block of targets, a target per lane.
+            // A body's pull on itself has zero offset, so it only needs its
+            // distance kept away from zero to add nothing.
+            for (std::size_t j = 0; j < count; ++j)
+            {
+                double sx = x[j];
+                double sy = y[j];
+                double sz = z[j];
+                double gm = G * mass[j];
+                for (std::size_t t = 0; t < Width; ++t)
+                {
+                    double dx = sx - tx[t];
+                    double dy = sy - ty[t];
+                    double dz = sz - tz[t];
+                    double r2 = dx * dx + dy * dy + dz * dz;
+                    double safe = (r2 > 0.0) ? r2 : 1.0;
+                    double pull = gm * law(safe);
+                    sumX[t] += dx * pull;
+                    sumY[t] += dy * pull;
+                    sumZ[t] += dz * pull;
+                }
+            }
+
+            for (std::size_t t = 0; t < Width; ++t)
+            {
+                ax[t] = sumX[t];
+                ay[t] = sumY[t];
+                az[t] = sumZ[t];
+            }
+        }
+    }
+
+    // Bound by reference in std::min, so it needs a definition.
+    constexpr std::size_t FusedLeapfrog::Width;
+
+    FusedLeapfrog::FusedLeapfrog() :
+        mValid(false),
+        mDt(0.0)
+    { }
+
+    void FusedLeapfrog::invalidate()
+    {
+        mValid = false;
+    }
+
+    void FusedLeapfrog::step(Particles& particles, double dt,
+        ForceLaw const& law)
+    {
+        visitForceLaw(law, [&](auto const& pull)
+        {
+            if (!mValid || dt != mDt || mNextX.size() != particles.size())
+            {
+                pass(particles, dt, false, pull);
+                mDt = dt;
+                mValid = true;
+            }
+
+            // The look-ahead positions become current and the old ones
+            // become the buffer the next positions are written to.
+            std::swap(particles.x, mNextX);
+            std::swap(particles.y, mNextY);
+            std::swap(particles.z, mNextZ);
+            pass(particles, dt, true, pull);
+        });
+    }
+
+    void FusedLeapfrog::permute(std::vector<std::uint32_t> const& order)
+    {
+        if (!mValid || order.size() != mNextX.size())
+        {
+            mValid = false;
+            return;
+        }
+
+        for (auto values : { &mNextX, &mNextY, &mNextZ, &mHalfVx, &mHalfVy,
+            &mHalfVz })
+        {
+            gather(*values, order, mScratch);
+        }
+    }
+
+    template <class Law>
+    void FusedLeapfrog::pass(Particles& particles, double dt,
+        bool synchronise, Law const& law)
+    {
+        auto& p = particles;
+        std::size_t count = p.size();
+        double halfDt = 0.5 * dt;
+
+        // These trade places with the particle positions every step, so
+        // they carry the same reservation.
+        for (auto values : { &mNextX, &mNextY, &mNextZ })
+        {
+            values->reserveStable(p.x.reservation());
+            values->resize(count);
+        }
+        mHalfVx.resize(count);
+        mHalfVy.resize(count);
+        mHalfVz.resize(count);
+
+        double ax[Width];
+        double ay[Width];
+        double az[Width];
+        for (std::size_t first = 0; first < count; first += Width)
+        {
+            blockAccelerations(p, first, law, ax, ay, az);
+
+            std::size_t lanes = std::min(Width, count - first);
+            for (std::size_t t = 0; t < lanes; ++t)
+            {
+                std::size_t i = first + t;
+                if (synchronise)
+                {
+                    p.vx[i] = mHalfVx[i] + halfDt * ax[t];
+                    p.vy[i] = mHalfVy[i] + halfDt * ay[t];
+                    p.vz[i] = mHalfVz[i] + halfDt * az[t];
+                }
+
+                mHalfVx[i] = p.vx[i] + halfDt * ax[t];
+                mHalfVy[i] = p.vy[i] + halfDt * ay[t];
+                mHalfVz[i] = p.vz[i] + halfDt * az[t];
+                mNextX[i] = p.x[i] + dt * mHalfVx[i];
+                mNextY[i] = p.y[i] + dt * mHalfVy[i];
+                mNextZ[i] = p.z[i] + dt * mHalfVz[i];
+            }
+        }
+    }
+}
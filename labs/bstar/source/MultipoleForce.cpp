@@ -0,0 +1,599 @@
+#include "MultipoleForce.hpp"
+#include "Morton.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace bstar
+{
+    namespace
+    {
+        template <class Law, class Term>
+        void sumCellPair(PairArrays const& bodies, std::uint32_t firstA,
+            std::uint32_t countA, std::uint32_t firstB, std::uint32_t countB,
+            Law const& law, Term const& term)
+        {
+            for (std::uint32_t i = firstA; i < firstA + countA; ++i)
+            {
+                for (std::uint32_t j = firstB; j < firstB + countB; ++j)
+                {
+                    gravityPair(bodies, i, j, ForceBackend::G, law, term);
+                }
+            }
+        }
+
+        template <class Law, class Term>
+        void sumCellSelf(PairArrays const& bodies, std::uint32_t first,
+            std::uint32_t count, Law const& law, Term const& term)
+        {
+            for (std::uint32_t i = first; i < first + count; ++i)
+            {
+                for (std::uint32_t j = i + 1; j < first + count; ++j)
+                {
+                    gravityPair(bodies, i, j, ForceBackend::G, law, term);
+                }
+            }
+        }
+    }
+
+    // Bound by reference in std::min and std::max, so they need
+    // definitions.
+    constexpr int MultipoleForce::MinOrder;
+    constexpr int MultipoleForce::MaxOrder;
+
+    MultipoleForce::MultipoleForce() :
+        mOrder(4),
+        mOpeningAngle(0.5),
+        mLeafSize(16),
+        mTerms(0)
+    {
+        buildTables();
+    }
+
+    void MultipoleForce::accelerations(BodyArray const& x, BodyArray const& y,
+        BodyArray const& z, BodyArray const& vx, BodyArray const& vy,
+        BodyArray const& vz, BodyArray const& mass, BodyArray& ax,
+        BodyArray& ay, BodyArray& az)
+    {
+        std::size_t count = mass.size();
+        ax.assign(count, 0.0);
+        ay.assign(count, 0.0);
+        az.assign(count, 0.0);
+        if (count < 2)
+        {
+            return;
+        }
+
+        sortBodies(x, y, z, vx, vy, vz, mass);
+        buildCell(0, 0);
+
+        mMultipoles.assign(mCells.size() * mTerms, 0.0);
+        mLocals.assign(mCells.size() * mTerms, 0.0);
+        mAx.assign(count, 0.0);
+        mAy.assign(count, 0.0);
+        mAz.assign(count, 0.0);
+
+        upwardPass(0);
+        interactSelf(0);
+        downwardPass(0);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            ax[mOrderOf[i]] = mAx[i];
+            ay[mOrderOf[i]] = mAy[i];
+            az[mOrderOf[i]] = mAz[i];
+        }
+    }
+
+    void MultipoleForce::setOrder(int order)
+    {
+        order = std::min(std::max(order, MinOrder), MaxOrder);
+        if (order != mOrder)
+        {
+            mOrder = order;
+            buildTables();
+        }
+    }
+
+    int MultipoleForce::order() const
+    {
+        return mOrder;
+    }
+
+    void MultipoleForce::setOpeningAngle(double theta)
+    {
+        mOpeningAngle = std::min(std::max(theta, 0.05), 1.0);
+    }
+
+    double MultipoleForce::openingAngle() const
+    {
+        return mOpeningAngle;
+    }
+
+    void MultipoleForce::setLeafSize(std::size_t size)
+    {
+        mLeafSize = std::max<std::size_t>(size, 1);
+    }
+
+    void MultipoleForce::buildTables()
+    {
+        int p = mOrder;
+        int side = p + 1;
+
+        // Degree-major order means every recurrence and shift only reads
+        // entries that are already filled.
+        mPowers.clear();
+        mIndex.assign(side * side * side, -1);
+        for (int degree = 0; degree <= p; ++degree)
+        {
+            for (int a = degree; a >= 0; --a)
+            {
+                for (int b = degree - a; b >= 0; --b)
+                {
+                    int c = degree - a - b;
+                    mIndex[(a * side + b) * side + c] =
+                        static_cast<int>(mPowers.size() / 3);
+                    mPowers.push_back(a);
+                    mPowers.push_back(b);
+                    mPowers.push_back(c);
+                }
+            }
+        }
+        mTerms = mPowers.size() / 3;
+
+        auto index = [this, side](int a, int b, int c)
+        {
+            return static_cast<std::uint16_t>(
+                mIndex[(a * side + b) * side + c]);
+        };
+
+        mParity.resize(mTerms);
+        for (std::size_t n = 0; n < mTerms; ++n)
+        {
+            int degree = mPowers[3 * n] + mPowers[3 * n + 1] +
+                mPowers[3 * n + 2];
+            mParity[n] = (degree % 2 == 0) ? 1.0 : -1.0;
+        }
+
+        mM2M.clear();
+        mM2L.clear();
+        mL2L.clear();
+        for (std::size_t n = 0; n < mTerms; ++n)
+        {
+            int a = mPowers[3 * n];
+            int b = mPowers[3 * n + 1];
+            int c = mPowers[3 * n + 2];
+            std::uint16_t target = static_cast<std::uint16_t>(n);
+
+            for (std::size_t k = 0; k < mTerms; ++k)
+            {
+                int i = mPowers[3 * k];
+                int j = mPowers[3 * k + 1];
+                int l = mPowers[3 * k + 2];
+                std::uint16_t other = static_cast<std::uint16_t>(k);
+
+                // M2M: M_n += M_k * d^(n-k) / (n-k)! for k <= n.
+                if (i <= a && j <= b && l <= c)
+                {
+                    mM2M.push_back({ target, other,
+                        index(a - i, b - j, c - l), 1.0 });
+                }
+
+                // M2L: L_n += (-1)^|k| M_k D_(n+k), and L2L:
+                // L_n += L_(n+k) d^k / k!, both truncated at the order.
+                if (a + b + c + i + j + l <= p)
+                {
+                    std::uint16_t sum = index(a + i, b + j, c + l);
+                    mM2L.push_back({ target, other, sum, mParity[k] });
+                    mL2L.push_back({ target, sum, other, 1.0 });
+                }
+            }
+        }
+
+        // The field at a body needs the local coefficients one degree up
+        // from each monomial, so only monomials below the order are used.
+        mGradient.clear();
+        for (std::size_t n = 0; n < mTerms; ++n)
+        {
+            int a = mPowers[3 * n];
+            int b = mPowers[3 * n + 1];
+            int c = mPowers[3 * n + 2];
+            if (a + b + c < p)
+            {
+                mGradient.push_back(index(a + 1, b, c));
+                mGradient.push_back(index(a, b + 1, c));
+                mGradient.push_back(index(a, b, c + 1));
+            }
+        }
+    }
+
+    void MultipoleForce::sortBodies(BodyArray const& x, BodyArray const& y,
+        BodyArray const& z, BodyArray const& vx, BodyArray const& vy,
+        BodyArray const& vz, BodyArray const& mass)
+    {
+        std::size_t count = mass.size();
+
+        morton::Cube cube = morton::boundingCube(x, y, z);
+        morton::encodeAll(x, y, z, cube, mCodes);
+        morton::radixSort(mCodes, mOrderOf, mCodeScratch, mOrderScratch);
+
+        mX.resize(count);
+        mY.resize(count);
+        mZ.resize(count);
+        mMass.resize(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            std::uint32_t from = mOrderOf[i];
+            mX[i] = x[from];
+            mY[i] = y[from];
+            mZ[i] = z[from];
+            mMass[i] = mass[from];
+        }
+
+        // Only velocity-dependent terms read velocities.
+        if (mForceTerms.postNewtonian)
+        {
+            mVx.resize(count);
+            mVy.resize(count);
+            mVz.resize(count);
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                std::uint32_t from = mOrderOf[i];
+                mVx[i] = vx[from];
+                mVy[i] = vy[from];
+                mVz[i] = vz[from];
+            }
+        }
+
+        double half = 0.5 * cube.size;
+        Cell root;
+        root.centre[0] = cube.origin[0] + half;
+        root.centre[1] = cube.origin[1] + half;
+        root.centre[2] = cube.origin[2] + half;
+        root.halfSize = half;
+        root.radius = 0.0;
+        root.first = 0;
+        root.count = static_cast<std::uint32_t>(count);
+        root.firstChild = 0;
+        root.childCount = 0;
+
+        mCells.clear();
+        mCells.push_back(root);
+    }
+
+    void MultipoleForce::buildCell(std::uint32_t cell, unsigned depth)
+    {
+        Cell parent = mCells[cell];
+        if (parent.count <= mLeafSize || depth >= morton::BitsPerAxis)
+        {
+            return;
+        }
+
+        // Codes are sorted, so each octant's bodies are one run.
+        std::uint32_t firstChild = static_cast<std::uint32_t>(mCells.size());
+        std::uint32_t end = parent.first + parent.count;
+        std::uint32_t begin = parent.first;
+        double quarter = 0.5 * parent.halfSize;
+        while (begin < end)
+        {
+            unsigned octant = morton::octant(mCodes[begin], depth);
+            std::uint32_t stop = begin + 1;
+            while (stop < end && morton::octant(mCodes[stop], depth) == octant)
+            {
+                ++stop;
+            }
+
+            Cell child;
+            child.centre[0] = parent.centre[0] + ((octant & 1) ? quarter :
+                -quarter);
+            child.centre[1] = parent.centre[1] + ((octant & 2) ? quarter :
+                -quarter);
+            child.centre[2] = parent.centre[2] + ((octant & 4) ? quarter :
+                -quarter);
+            child.halfSize = quarter;
+            child.radius = 0.0;
+            child.first = begin;
+            child.count = stop - begin;
+            child.firstChild = 0;
+            child.childCount = 0;
+            mCells.push_back(child);
+
+            begin = stop;
+        }
+
+        std::uint32_t childCount =
+            static_cast<std::uint32_t>(mCells.size()) - firstChild;
+        mCells[cell].firstChild = firstChild;
+        mCells[cell].childCount = childCount;
+
+        for (std::uint32_t i = 0; i < childCount; ++i)
+        {
+            buildCell(firstChild + i, depth + 1);
+        }
+    }
+
+    void MultipoleForce::upwardPass(std::uint32_t cell)
+    {
+        double shift[MaxTerms];
+        Cell& c = mCells[cell];
+        double* multipole = &mMultipoles[cell * mTerms];
+
+        if (c.childCount == 0)
+        {
+            double radius2 = 0.0;
+            for (std::uint32_t i = c.first; i < c.first + c.count; ++i)
+            {
+                double dx = mX[i] - c.centre[0];
+                double dy = mY[i] - c.centre[1];
+                double dz = mZ[i] - c.centre[2];
+                radius2 = std::max(radius2, dx * dx + dy * dy + dz * dz);
+
+                monomials(dx, dy, dz, shift);
+                for (std::size_t n = 0; n < mTerms; ++n)
+                {
+                    multipole[n] += mMass[i] * shift[n];
+                }
+            }
+            c.radius = std::sqrt(radius2);
+            return;
+        }
+
+        double radius = 0.0;
+        for (std::uint32_t k = 0; k < c.childCount; ++k)
+        {
+            std::uint32_t child = c.firstChild + k;
+            upwardPass(child);
+
+            Cell const& d = mCells[child];
+            double dx = d.centre[0] - c.centre[0];
+            double dy = d.centre[1] - c.centre[1];
+            double dz = d.centre[2] - c.centre[2];
+            radius = std::max(radius,
+                std::sqrt(dx * dx + dy * dy + dz * dz) + d.radius);
+
+            monomials(dx, dy, dz, shift);
+            double const* source = &mMultipoles[child * mTerms];
+            for (auto const& term : mM2M)
+            {
+                multipole[term.target] += source[term.source] *
+                    shift[term.weight];
+            }
+        }
+        c.radius = radius;
+    }
+
+    void MultipoleForce::interact(std::uint32_t a, std::uint32_t b)
+    {
+        Cell const& ca = mCells[a];
+        Cell const& cb = mCells[b];
+
+        // An expansion costs about as much as this many body pairs, so
+        // small pairs of cells are summed directly whatever their distance.
+        if (static_cast<std::size_t>(ca.count) * cb.count <= mTerms)
+        {
+            directPair(a, b);
+            return;
+        }
+
+        double dx = ca.centre[0] - cb.centre[0];
+        double dy = ca.centre[1] - cb.centre[1];
+        double dz = ca.centre[2] - cb.centre[2];
+        double distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+        if (ca.radius + cb.radius < mOpeningAngle * distance)
+        {
+            multipoleToLocal(a, b);
+            return;
+        }
+
+        if (ca.childCount == 0 && cb.childCount == 0)
+        {
+            directPair(a, b);
+            return;
+        }
+
+        // Open the larger cell, or the only one that can be opened.
+        bool splitA = (cb.childCount == 0) ||
+            (ca.childCount != 0 && ca.radius >= cb.radius);
+        if (splitA)
+        {
+            for (std::uint32_t k = 0; k < ca.childCount; ++k)
+            {
+                interact(ca.firstChild + k, b);
+            }
+        }
+        else
+        {
+            for (std::uint32_t k = 0; k < cb.childCount; ++k)
+            {
+                interact(a, cb.firstChild + k);
+            }
+        }
+    }
+
+    void MultipoleForce::interactSelf(std::uint32_t a)
+    {
+        Cell const& c = mCells[a];
+        if (c.childCount == 0)
+        {
+            directSelf(a);
+            return;
+        }
+
+        for (std::uint32_t i = 0; i < c.childCount; ++i)
+        {
+            interactSelf(c.firstChild + i);
+            for (std::uint32_t j = i + 1; j < c.childCount; ++j)
+            {
+                interact(c.firstChild + i, c.firstChild + j);
+            }
+        }
+    }
+
+    void MultipoleForce::directPair(std::uint32_t a, std::uint32_t b)
+    {
+        Cell const& ca = mCells[a];
+        Cell const& cb = mCells[b];
+        PairArrays bodies = pairArrays();
+        visitKernels([&](auto const& law, auto const& term)
+        {
+            sumCellPair(bodies, ca.first, ca.count, cb.first, cb.count, law,
+                term);
+        });
+    }
+
+    void MultipoleForce::directSelf(std::uint32_t a)
+    {
+        Cell const& c = mCells[a];
+        PairArrays bodies = pairArrays();
+        visitKernels([&](auto const& law, auto const& term)
+        {
+            sumCellSelf(bodies, c.first, c.count, law, term);
+        });
+    }
+
+    PairArrays MultipoleForce::pairArrays()
+    {
+        PairArrays bodies = { mX.data(), mY.data(), mZ.data(), mVx.data(),
+            mVy.data(), mVz.data(), mMass.data(), mAx.data(), mAy.data(),
+            mAz.data() };
+        return bodies;
+    }
+
+    void MultipoleForce::multipoleToLocal(std::uint32_t a, std::uint32_t b)
+    {
+        Cell const& ca = mCells[a];
+        Cell const& cb = mCells[b];
+
+        // The derivatives at -R are those at R times (-1)^|n|, so one set
+        // serves both directions.
+        double derivative[MaxTerms];
+        derivatives(ca.centre[0] - cb.centre[0], ca.centre[1] - cb.centre[1],
+            ca.centre[2] - cb.centre[2], derivative);
+
+        double const* ma = &mMultipoles[a * mTerms];
+        double const* mb = &mMultipoles[b * mTerms];
+        double* la = &mLocals[a * mTerms];
+        double* lb = &mLocals[b * mTerms];
+        for (auto const& term : mM2L)
+        {
+            double d = derivative[term.weight];
+            la[term.target] += term.sign * mb[term.source] * d;
+            lb[term.target] += mParity[term.target] * ma[term.source] * d;
+        }
+    }
+
+    void MultipoleForce::downwardPass(std::uint32_t cell)
+    {
+        double shift[MaxTerms];
+        Cell const& c = mCells[cell];
+        double const* local = &mLocals[cell * mTerms];
+
+        if (c.childCount == 0)
+        {
+            std::size_t gradients = mGradient.size() / 3;
+            for (std::uint32_t i = c.first; i < c.first + c.count; ++i)
+            {
+                monomials(mX[i] - c.centre[0], mY[i] - c.centre[1],
+                    mZ[i] - c.centre[2], shift);
+
+                double fx = 0.0;
+                double fy = 0.0;
+                double fz = 0.0;
+                for (std::size_t n = 0; n < gradients; ++n)
+                {
+                    fx += local[mGradient[3 * n]] * shift[n];
+                    fy += local[mGradient[3 * n + 1]] * shift[n];
+                    fz += local[mGradient[3 * n + 2]] * shift[n];
+                }
+
+                mAx[i] += G * fx;
+                mAy[i] += G * fy;
+                mAz[i] += G * fz;
+            }
+            return;
+        }
+
+        for (std::uint32_t k = 0; k < c.childCount; ++k)
+        {
+            std::uint32_t child = c.firstChild + k;
+            Cell const& d = mCells[child];
+            monomials(d.centre[0] - c.centre[0], d.centre[1] - c.centre[1],
+                d.centre[2] - c.centre[2], shift);
+
+            double* target = &mLocals[child * mTerms];
+            for (auto const& term : mL2L)
+            {
+                target[term.target] += local[term.source] *
+                    shift[term.weight];
+            }
+
+            downwardPass(child);
+        }
+    }
+
+    void MultipoleForce::monomials(double dx, double dy, double dz,
+        double* out) const
+    {
+        double px[MaxOrder + 1];
+        double py[MaxOrder + 1];
+        double pz[MaxOrder + 1];
+        px[0] = py[0] = pz[0] = 1.0;
+        for (int k = 1; k <= mOrder; ++k)
+        {
+            px[k] = px[k - 1] * dx / k;
+            py[k] = py[k - 1] * dy / k;
+            pz[k] = pz[k - 1] * dz / k;
+        }
+
+        for (std::size_t n = 0; n < mTerms; ++n)
+        {
+            out[n] = px[mPowers[3 * n]] * py[mPowers[3 * n + 1]] *
+                pz[mPowers[3 * n + 2]];
+        }
+    }
+
+    void MultipoleForce::derivatives(double rx, double ry, double rz,
+        double* out) const
+    {
+        // |n| r^2 D_n = -(2|n| - 1) sum_i n_i r_i D_(n - e_i)
+        //               - (|n| - 1) sum_i n_i (n_i - 1) D_(n - 2 e_i)
+        double r2 = rx * rx + ry * ry + rz * rz;
+        double invR2 = 1.0 / r2;
+        int side = mOrder + 1;
+        double const r[3] = { rx, ry, rz };
+
+        out[0] = std::sqrt(invR2);
+        for (std::size_t n = 1; n < mTerms; ++n)
+        {
+            int power[3] = { mPowers[3 * n], mPowers[3 * n + 1],
+                mPowers[3 * n + 2] };
+            int degree = power[0] + power[1] + power[2];
+
+            double first = 0.0;
+            double second = 0.0;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                if (power[axis] == 0)
+                {
+                    continue;
+                }
+
+                int lower[3] = { power[0], power[1], power[2] };
+                --lower[axis];
+                first += power[axis] * r[axis] *
+                    out[mIndex[(lower[0] * side + lower[1]) * side + lower[2]]];
+
+                if (power[axis] > 1)
+                {
+                    --lower[axis];
+                    second += power[axis] * (power[axis] - 1) *
+                        out[mIndex[(lower[0] * side + lower[1]) * side +
+                        lower[2]]];
+                }
+            }
+
+            out[n] = -((2 * degree - 1) * first + (degree - 1) * second) *
+                invR2 / degree;
+        }
+    }
+}
@@ -0,0 +1,184 @@
+#include "Particles.hpp"
+
+namespace bstar
+{
+    namespace
+    {
+        template <typename Array>
+        void swapRemove(Array& values, std::size_t index)
+        {
+            values[index] = values.back();
+            values.pop_back();
+        }
+
+        template <typename Array>
+        void gather(Array& values, Array& scratch,
+            std::vector<std::uint32_t> const& order)
+        {
+            // Keep the reservation with whichever buffer ends up live.
+            scratch.reserveStable(values.reservation());
+            scratch.resize(values.size());
+            for (std::size_t i = 0; i < order.size(); ++i)
+            {
+                scratch[i] = values[order[i]];
+            }
+            values.swap(scratch);
+        }
+    }
+
+    Particles::Particles() :
+        mLayoutVersion(0)
+    { }
+
+    void Particles::reserve(std::size_t capacity)
+    {
+        for (auto array : { &x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az, &mass,
+            &radius })
+        {
+            array->reserveStable(capacity);
+        }
+
+        colour.reserveStable(capacity);
+        mIds.reserveStable(capacity);
+        mIndexOfSlot.reserveStable(capacity);
+        mSlotIds.reserveStable(capacity);
+        mFreeIds.reserveStable(capacity);
+    }
+
+    void Particles::clear()
+    {
+        for (auto array : { &x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az, &mass,
+            &radius })
+        {
+            array->clear();
+        }
+
+        colour.clear();
+        mIds.clear();
+        mIndexOfSlot.clear();
+
+        // Generations start over with the slots, so the first bodies
+        // after a clear get the same ids every time.
+        mSlotIds.clear();
+        mFreeIds.clear();
+        ++mLayoutVersion;
+    }
+
+    Particles::Id Particles::add(double px, double py, double pz,
+        double pvx, double pvy, double pvz, double pmass, double pradius,
+        std::uint32_t pcolour)
+    {
+        Id newId;
+        if (mFreeIds.empty())
+        {
+            // Slot SlotMask would alias InvalidId at its last generation.
+            if (mSlotIds.size() == SlotMask)
+            {
+                return InvalidId;
+            }
+
+            newId = static_cast<Id>(mSlotIds.size());
+            mSlotIds.push_back(newId);
+            mIndexOfSlot.push_back(0);
+        }
+        else
+        {
+            newId = mFreeIds.back();
+            mFreeIds.pop_back();
+        }
+
+        mIndexOfSlot[slotOf(newId)] = mIds.size();
+        mIds.push_back(newId);
+
+        x.push_back(px);
+        y.push_back(py);
+        z.push_back(pz);
+        vx.push_back(pvx);
+        vy.push_back(pvy);
+        vz.push_back(pvz);
+        ax.push_back(0.0);
+        ay.push_back(0.0);
+        az.push_back(0.0);
+        mass.push_back(pmass);
+        radius.push_back(pradius);
+        colour.push_back(pcolour);
+
+        ++mLayoutVersion;
+        return newId;
+    }
+
+    void Particles::remove(std::size_t index)
+    {
+        Id removed = mIds[index];
+        Id moved = mIds.back();
+
+        for (auto array : { &x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az, &mass,
+            &radius })
+        {
+            swapRemove(*array, index);
+        }
+
+        swapRemove(colour, index);
+        swapRemove(mIds, index);
+
+        std::size_t slot = slotOf(removed);
+        mIndexOfSlot[slotOf(moved)] = index;
+        mIndexOfSlot[slot] = InvalidIndex;
+
+        // The next body in this slot gets a new id; the old one is stale.
+        Id generation = ((removed >> SlotBits) + 1) << SlotBits;
+        mSlotIds[slot] = static_cast<Id>(slot) | generation;
+        mFreeIds.push_back(mSlotIds[slot]);
+        ++mLayoutVersion;
+    }
+
+    void Particles::permute(std::vector<std::uint32_t> const& order)
+    {
+        for (auto array : { &x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az, &mass,
+            &radius })
+        {
+            gather(*array, mScratch, order);
+        }
+
+        gather(colour, mColourScratch, order);
+        gather(mIds, mIdScratch, order);
+
+        for (std::size_t i = 0; i < mIds.size(); ++i)
+        {
+            mIndexOfSlot[slotOf(mIds[i])] = i;
+        }
+        ++mLayoutVersion;
+    }
+
+    std::size_t Particles::size() const
+    {
+        return mIds.size();
+    }
+
+    std::size_t Particles::capacity() const
+    {
+        return x.capacity();
+    }
+
+    Particles::Id Particles::id(std::size_t index) const
+    {
+        return mIds[index];
+    }
+
+    std::size_t Particles::indexOf(Id id) const
+    {
+        std::size_t slot = slotOf(id);
+        return (slot < mSlotIds.size() && mSlotIds[slot] == id) ?
+            mIndexOfSlot[slot] : InvalidIndex;
+    }
+
+    std::size_t Particles::slotOf(Id id)
+    {
+        return id & SlotMask;
+    }
+
+    std::uint64_t Particles::layoutVersion() const
+    {
+        return mLayoutVersion;
+    }
+}
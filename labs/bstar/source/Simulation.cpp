@@ -0,0 +1,414 @@
+#include "Simulation.hpp"
+#include "Morton.hpp"
+
+#include <cmath>
+
+namespace bstar
+{
+    Simulation::Simulation() :
+        mForceMethod(ForceMethod::Direct),
+        mIntegrator(Integrator::Euler),
+        mCollisionsEnabled(true),
+        mAccelerationsValid(false),
+        mMerges(0),
+        mSortInterval(32),
+        mStepsSinceSort(0)
+    {
+        reset();
+    }
+
+    void Simulation::reset()
+    {
+        const double starMass = 1.0e13;
+        const double planetMass = 1.0e11;
+        const double separation = 6.0;
+        const double planetDistance = 10.0;
+
+        // Each star circles the centre of mass at half the separation.
+        double starSpeed = std::sqrt(G * starMass * 0.5 * separation) /
+            separation;
+
+        // Far enough out, the binary pulls like one body of both masses.
+        double planetSpeed = std::sqrt(G * 2.0 * starMass / planetDistance);
+
+        mParticles.clear();
+        mParticles.add(0.0, 0.0, planetDistance, planetSpeed, 0.0, 0.0,
+            planetMass, 0.1, 0x000000ff);
+        mParticles.add(0.5 * separation, 0.0, 0.0, 0.0, 0.0, -starSpeed,
+            starMass, 0.25, 0xffffffff);
+        mParticles.add(-0.5 * separation, 0.0, 0.0, 0.0, 0.0, starSpeed,
+            starMass, 0.25, 0xffffffff);
+
+        mAccelerationsValid = false;
+        mFusedLeapfrog.invalidate();
+        mMerges = 0;
+        mStepsSinceSort = 0;
+    }
+
+    void Simulation::step(double dt)
+    {
+        if (mSortInterval != 0 && ++mStepsSinceSort >= mSortInterval)
+        {
+            sortBodies();
+            mStepsSinceSort = 0;
+        }
+
+        mX0 = mParticles.x;
+        mY0 = mParticles.y;
+        mZ0 = mParticles.z;
+
+        switch (mIntegrator)
+        {
+        case Integrator::Euler:
+            eulerStep(dt);
+            break;
+
+        case Integrator::ImplicitEuler:
+            implicitEulerStep(dt);
+            break;
+
+        case Integrator::Verlet:
+            verletStep(dt);
+            break;
+
+        case Integrator::RungeKutta:
+            rk4Step(dt);
+            break;
+
+        case Integrator::FusedVerlet:
+            fusedVerletStep(dt);
+            break;
+
+        default:
+            break;
+        }
+
+        if (mCollisionsEnabled)
+        {
+            std::size_t merged = mCollisions.resolve(mParticles, mX0, mY0,
+                mZ0);
+            if (merged != 0)
+            {
+                mMerges += merged;
+                mAccelerationsValid = false;
+                mFusedLeapfrog.invalidate();
+            }
+        }
+    }
+
+    Particles const& Simulation::particles() const
+    {
+        return mParticles;
+    }
+
+    Particles& Simulation::particles()
+    {
+        return mParticles;
+    }
+
+    void Simulation::setIntegrator(Integrator integrator)
+    {
+        mIntegrator = integrator;
+        mFusedLeapfrog.invalidate();
+    }
+
+    Integrator Simulation::integrator() const
+    {
+        return mIntegrator;
+    }
+
+    void Simulation::setCollisions(bool enabled)
+    {
+        mCollisionsEnabled = enabled;
+    }
+
+    bool Simulation::collisions() const
+    {
+        return mCollisionsEnabled;
+    }
+
+    void Simulation::setMass(Particles::Id id, double mass)
+    {
+        std::size_t index = mParticles.indexOf(id);
+        if (index != Particles::InvalidIndex)
+        {
+            mParticles.mass[index] = mass;
+            mAccelerationsValid = false;
+            mFusedLeapfrog.invalidate();
+        }
+    }
+
+    double Simulation::mass(Particles::Id id) const
+    {
+        std::size_t index = mParticles.indexOf(id);
+        return (index != Particles::InvalidIndex) ?
+            mParticles.mass[index] : 0.0;
+    }
+
+    std::size_t Simulation::merges() const
+    {
+        return mMerges;
+    }
+
+    void Simulation::setForceMethod(ForceMethod method)
+    {
+        if (method != mForceMethod)
+        {
+            mForceMethod = method;
+            mAccelerationsValid = false;
+            mFusedLeapfrog.invalidate();
+        }
+    }
+
+    ForceMethod Simulation::forceMethod() const
+    {
+        return mForceMethod;
+    }
+
+    MultipoleForce& Simulation::multipoleForce()
+    {
+        // Settings may change the accelerations the next step starts from.
+        mAccelerationsValid = false;
+        return mMultipoleForce;
+    }
+
+    TiledForce& Simulation::tiledForce()
+    {
+        return mTiledForce;
+    }
+
+    void Simulation::setForceTerms(ForceTerms const& terms)
+    {
+        mDirectForce.setForceTerms(terms);
+        mMultipoleForce.setForceTerms(terms);
+        mTiledForce.setForceTerms(terms);
+        mAccelerationsValid = false;
+        mFusedLeapfrog.invalidate();
+    }
+
+    ForceTerms const& Simulation::forceTerms() const
+    {
+        return mDirectForce.forceTerms();
+    }
+
+    void Simulation::setForceLaw(ForceLaw const& law)
+    {
+        mDirectForce.setForceLaw(law);
+        mMultipoleForce.setForceLaw(law);
+        mTiledForce.setForceLaw(law);
+        mAccelerationsValid = false;
+        mFusedLeapfrog.invalidate();
+    }
+
+    ForceLaw const& Simulation::forceLaw() const
+    {
+        return mDirectForce.forceLaw();
+    }
+
+    void Simulation::setSortInterval(std::size_t steps)
+    {
+        mSortInterval = steps;
+        mStepsSinceSort = 0;
+    }
+
+    std::size_t Simulation::sortInterval() const
+    {
+        return mSortInterval;
+    }
+
+    void Simulation::computeAccelerations(BodyArray const& x,
+        BodyArray const& y, BodyArray const& z, BodyArray const& vx,
+        BodyArray const& vy, BodyArray const& vz, BodyArray& ax, BodyArray& ay,
+        BodyArray& az)
+    {
+        ForceBackend* backend = &mDirectForce;
+        if (mForceMethod == ForceMethod::Multipole)
+        {
+            backend = &mMultipoleForce;
+        }
+        else if (mForceMethod == ForceMethod::Tiled)
+        {
+            backend = &mTiledForce;
+        }
+        backend->accelerations(x, y, z, vx, vy, vz, mParticles.mass, ax, ay,
+            az);
+    }
+
+    void Simulation::eulerStep(double dt)
+    {
+        updateAccelerations();
+
+        auto& p = mParticles;
+        for (std::size_t i = 0; i < p.size(); ++i)
+        {
+            p.x[i] += dt * p.vx[i];
+            p.y[i] += dt * p.vy[i];
+            p.z[i] += dt * p.vz[i];
+            p.vx[i] += dt * p.ax[i];
+            p.vy[i] += dt * p.ay[i];
+            p.vz[i] += dt * p.az[i];
+        }
+
+        mAccelerationsValid = false;
+    }
+
+    void Simulation::implicitEulerStep(double dt)
+    {
+        updateAccelerations();
+
+        // Semi-implicit: the position update uses the new velocity.
+        auto& p = mParticles;
+        for (std::size_t i = 0; i < p.size(); ++i)
+        {
+            p.vx[i] += dt * p.ax[i];
+            p.vy[i] += dt * p.ay[i];
+            p.vz[i] += dt * p.az[i];
+            p.x[i] += dt * p.vx[i];
+            p.y[i] += dt * p.vy[i];
+            p.z[i] += dt * p.vz[i];
+        }
+
+        mAccelerationsValid = false;
+    }
+
+    void Simulation::verletStep(double dt)
+    {
+        // Velocity Verlet as kick-drift-kick; the closing kick's
+        // accelerations are the next step's opening ones.
+        updateAccelerations();
+
+        auto& p = mParticles;
+        double halfDt = 0.5 * dt;
+        for (std::size_t i = 0; i < p.size(); ++i)
+        {
+            p.vx[i] += halfDt * p.ax[i];
+            p.vy[i] += halfDt * p.ay[i];
+            p.vz[i] += halfDt * p.az[i];
+            p.x[i] += dt * p.vx[i];
+            p.y[i] += dt * p.vy[i];
+            p.z[i] += dt * p.vz[i];
+        }
+
+        // Velocity-dependent terms see the half-kicked velocities; the
+        // scheme stays second order but is no longer exactly symplectic.
+        computeAccelerations(p.x, p.y, p.z, p.vx, p.vy, p.vz, p.ax, p.ay,
+            p.az);
+        mAccelerationsValid = true;
+
+        for (std::size_t i = 0; i < p.size(); ++i)
+        {
+            p.vx[i] += halfDt * p.ax[i];
+            p.vy[i] += halfDt * p.ay[i];
+            p.vz[i] += halfDt * p.az[i];
+        }
+    }
+
+    void Simulation::rk4Step(double dt)
+    {
+        auto& p = mParticles;
+        std::size_t count = p.size();
+
+        mVx0 = p.vx;
+        mVy0 = p.vy;
+        mVz0 = p.vz;
+        mSvx = p.vx;
+        mSvy = p.vy;
+        mSvz = p.vz;
+        mSx.resize(count);
+        mSy.resize(count);
+        mSz.resize(count);
+
+        // Stage 1 at the start of the step.
+        updateAccelerations();
+        mKx = mSvx;
+        mKy = mSvy;
+        mKz = mSvz;
+        mKvx = p.ax;
+        mKvy = p.ay;
+        mKvz = p.az;
+
+        const double offsets[] = { 0.5, 0.5, 1.0 };
+        const double weights[] = { 2.0, 2.0, 1.0 };
+        for (int stage = 0; stage < 3; ++stage)
+        {
+            double h = offsets[stage] * dt;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                mSx[i] = mX0[i] + h * mSvx[i];
+                mSy[i] = mY0[i] + h * mSvy[i];
+                mSz[i] = mZ0[i] + h * mSvz[i];
+                mSvx[i] = mVx0[i] + h * p.ax[i];
+                mSvy[i] = mVy0[i] + h * p.ay[i];
+                mSvz[i] = mVz0[i] + h * p.az[i];
+            }
+
+            computeAccelerations(mSx, mSy, mSz, mSvx, mSvy, mSvz, p.ax, p.ay,
+                p.az);
+
+            double w = weights[stage];
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                mKx[i] += w * mSvx[i];
+                mKy[i] += w * mSvy[i];
+                mKz[i] += w * mSvz[i];
+                mKvx[i] += w * p.ax[i];
+                mKvy[i] += w * p.ay[i];
+                mKvz[i] += w * p.az[i];
+            }
+        }
+
+        double sixth = dt / 6.0;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            p.x[i] = mX0[i] + sixth * mKx[i];
+            p.y[i] = mY0[i] + sixth * mKy[i];
+            p.z[i] = mZ0[i] + sixth * mKz[i];
+            p.vx[i] = mVx0[i] + sixth * mKvx[i];
+            p.vy[i] = mVy0[i] + sixth * mKvy[i];
+            p.vz[i] = mVz0[i] + sixth * mKvz[i];
+        }
+
+        // The stored accelerations are the last stage's, not the new
+        // state's.
+        mAccelerationsValid = false;
+    }
+
+    void Simulation::fusedVerletStep(double dt)
+    {
+        if (mForceMethod != ForceMethod::Direct ||
+            forceTerms().postNewtonian)
+        {
+            verletStep(dt);
+            return;
+        }
+
+        mFusedLeapfrog.step(mParticles, dt, forceLaw());
+
+        // The fused step keeps its accelerations to itself.
+        mAccelerationsValid = false;
+    }
+
+    void Simulation::updateAccelerations()
+    {
+        if (!mAccelerationsValid)
+        {
+            auto& p = mParticles;
+            computeAccelerations(p.x, p.y, p.z, p.vx, p.vy, p.vz, p.ax,
+                p.ay, p.az);
+            mAccelerationsValid = true;
+        }
+    }
+
+    void Simulation::sortBodies()
+    {
+        // Accelerations are permuted with everything else, so the cached
+        // ones stay valid.
+        auto& p = mParticles;
+        morton::encodeAll(p.x, p.y, p.z, morton::boundingCube(p.x, p.y, p.z),
+            mSortCodes);
+        morton::radixSort(mSortCodes, mSortOrder, mSortCodeScratch,
+            mSortOrderScratch);
+        p.permute(mSortOrder);
+        mFusedLeapfrog.permute(mSortOrder);
+    }
+}
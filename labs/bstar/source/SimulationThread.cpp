@@ -0,0 +1,272 @@
+#include "SimulationThread.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace bstar
+{
+    SimulationThread::SimulationThread() :
+        mPlaying(false),
+        mRate(60.0),
+        mSteps(0),
+        mResets(0),
+        mRunning(true)
+    {
+        // One entry per setting and named body at most, so the backlog
+        // never grows past this.
+        mBacklog.reserve(32);
+
+        // The reader has a valid state before the first step.
+        publish();
+        mThread = std::thread(&SimulationThread::run, this);
+    }
+
+    SimulationThread::~SimulationThread()
+    {
+        mRunning.store(false, std::memory_order_release);
+        if (mThread.joinable())
+        {
+            mThread.join();
+        }
+    }
+
+    void SimulationThread::send(SimulationCommand command, double value,
+        Particles::Id id)
+    {
+        SimulationMessage message{ command, id, value };
+
+        // Anything still held back has to reach the simulation first.
+        flushBacklog();
+        if (mBacklog.empty() && mCommands.push(message))
+        {
+            return;
+        }
+
+        // Only the latest value of a setting matters. It moves to the
+        // back so it still follows everything sent before it, such as a
+        // Reset.
+        auto held = std::find_if(mBacklog.begin(), mBacklog.end(),
+            [&message](SimulationMessage const& other)
+            {
+                return other.command == message.command &&
+                    other.id == message.id;
+            });
+        if (held != mBacklog.end())
+        {
+            mBacklog.erase(held);
+        }
+        mBacklog.push_back(message);
+    }
+
+    bool SimulationThread::acquire()
+    {
+        // Called every frame, so the backlog drains even when the GUI
+        // sends nothing new.
+        flushBacklog();
+        return mStates.acquire();
+    }
+
+    void SimulationThread::flushBacklog()
+    {
+        std::size_t sent = 0;
+        while (sent < mBacklog.size() && mCommands.push(mBacklog[sent]))
+        {
+            ++sent;
+        }
+        mBacklog.erase(mBacklog.begin(), mBacklog.begin() + sent);
+    }
+
+    SimulationState const& SimulationThread::state() const
+    {
+        return mStates.readBuffer();
+    }
+
+    void SimulationThread::run()
+    {
+        using Clock = std::chrono::steady_clock;
+
+        // Sleeps are capped so commands are picked up promptly even at
+        // low step rates.
+        const auto poll = std::chrono::milliseconds(1);
+        auto next = Clock::now();
+
+        while (mRunning.load(std::memory_order_acquire))
+        {
+            bool changed = false;
+            SimulationMessage message;
+            while (mCommands.pop(message))
+            {
+                apply(message);
+                changed = true;
+                if (message.command == SimulationCommand::SetPlaying ||
+                    message.command == SimulationCommand::SetRate)
+                {
+                    next = Clock::now();
+                }
+            }
+
+            auto now = Clock::now();
+            if (mPlaying && now >= next)
+            {
+                mSimulation.step(1.0 / mRate);
+                ++mSteps;
+                publish();
+
+                // A step that overran its slot does not bank the lost time;
+                // the simulation slows down rather than trying to catch up.
+                auto period = std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(1.0 / mRate));
+                next = std::max(next + period, now);
+                continue;
+            }
+
+            if (changed)
+            {
+                publish();
+            }
+
+            std::this_thread::sleep_until(mPlaying ?
+                std::min(next, now + poll) : now + poll);
+        }
+    }
+
+    void SimulationThread::apply(SimulationMessage const& message)
+    {
+        switch (message.command)
+        {
+        case SimulationCommand::SetPlaying:
+            mPlaying = (message.value != 0.0);
+            break;
+
+        case SimulationCommand::SetRate:
+            if (message.value > 0.0)
+            {
+                mRate = message.value;
+            }
+            break;
+
+        case SimulationCommand::SetIntegrator:
+            mSimulation.setIntegrator(
+                static_cast<Integrator>(static_cast<int>(message.value)));
+            break;
+
+        case SimulationCommand::SetCollisions:
+            mSimulation.setCollisions(message.value != 0.0);
+            break;
+
+        case SimulationCommand::SetMass:
+            mSimulation.setMass(message.id, message.value);
+            break;
+
+        case SimulationCommand::SetForceMethod:
+            mSimulation.setForceMethod(
+                static_cast<ForceMethod>(static_cast<int>(message.value)));
+            break;
+
+        case SimulationCommand::SetExpansionOrder:
+            mSimulation.multipoleForce().setOrder(
+                static_cast<int>(message.value));
+            break;
+
+        case SimulationCommand::SetOpeningAngle:
+            mSimulation.multipoleForce().setOpeningAngle(message.value);
+            break;
+
+        case SimulationCommand::SetForceThreads:
+            mSimulation.tiledForce().setThreads(
+                static_cast<std::size_t>(std::max(message.value, 0.0)));
+            break;
+
+        case SimulationCommand::SetSortInterval:
+            mSimulation.setSortInterval(
+                static_cast<std::size_t>(std::max(message.value, 0.0)));
+            break;
+
+        case SimulationCommand::SetPostNewtonian:
+        {
+            ForceTerms terms = mSimulation.forceTerms();
+            terms.postNewtonian = message.value != 0.0;
+            mSimulation.setForceTerms(terms);
+            break;
+        }
+
+        case SimulationCommand::SetSpeedOfLight:
+            if (message.value > 0.0)
+            {
+                ForceTerms terms = mSimulation.forceTerms();
+                terms.speedOfLight = message.value;
+                mSimulation.setForceTerms(terms);
+            }
+            break;
+
+        case SimulationCommand::SetForceLaw:
+        {
+            ForceLaw law = mSimulation.forceLaw();
+            law.kind = static_cast<ForceLawKind>(
+                static_cast<int>(message.value));
+            mSimulation.setForceLaw(law);
+            break;
+        }
+
+        case SimulationCommand::SetSoftening:
+            if (message.value > 0.0)
+            {
+                ForceLaw law = mSimulation.forceLaw();
+                law.softening = message.value;
+                mSimulation.setForceLaw(law);
+            }
+            break;
+
+        case SimulationCommand::Reset:
+            mSimulation.reset();
+            mSteps = 0;
+            ++mResets;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    void SimulationThread::publish()
+    {
+        auto const& particles = mSimulation.particles();
+        std::size_t count = particles.size();
+
+        SimulationState& state = mStates.writeBuffer();
+        state.x.resize(count);
+        state.y.resize(count);
+        state.z.resize(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            state.x[i] = static_cast<float>(particles.x[i]);
+            state.y[i] = static_cast<float>(particles.y[i]);
+            state.z[i] = static_cast<float>(particles.z[i]);
+        }
+
+        // Each buffer remembers the layout it last held, so a buffer coming
+        // back round after a few steps still skips this.
+        if (state.layout != particles.layoutVersion())
+        {
+            state.layout = particles.layoutVersion();
+            state.radius.resize(count);
+            state.ids.resize(count);
+            state.colour.assign(particles.colour.begin(),
+                particles.colour.end());
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                state.radius[i] = static_cast<float>(particles.radius[i]);
+                state.ids[i] = particles.id(i);
+            }
+        }
+
+        state.namedMasses = { mSimulation.mass(Simulation::PlanetId),
+            mSimulation.mass(Simulation::FirstStarId),
+            mSimulation.mass(Simulation::SecondStarId) };
+        state.steps = mSteps;
+        state.resets = mResets;
+        state.merges = mSimulation.merges();
+
+        mStates.publish();
+    }
+}
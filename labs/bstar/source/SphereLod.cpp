@@ -0,0 +1,93 @@
+#include "SphereLod.hpp"
+
+#include <cmath>
+
+namespace bstar
+{
+    void SphereLod::addMesh(float const* vertices, std::size_t vertexCount,
+        GLuint const* indices, std::size_t indexCount)
+    {
+        Level level;
+        level.indexCount = static_cast<GLsizei>(indexCount);
+        level.firstIndex = mIndices.size();
+        level.baseVertex =
+            static_cast<GLint>(mVertices.size() / FloatsPerVertex);
+        mLevels.push_back(level);
+
+        mVertices.insert(mVertices.end(), vertices,
+            vertices + vertexCount * FloatsPerVertex);
+        mIndices.insert(mIndices.end(), indices, indices + indexCount);
+    }
+
+    void SphereLod::addUvSphere(int slices, int stacks)
+    {
+        const float pi = 3.14159265358979f;
+
+        std::vector<float> vertices;
+        std::vector<GLuint> indices;
+
+        // The seam column is duplicated so texture coordinates wrap.
+        for (int i = 0; i <= stacks; ++i)
+        {
+            float v = static_cast<float>(i) / stacks;
+            float phi = v * pi;
+            for (int j = 0; j <= slices; ++j)
+            {
+                float u = static_cast<float>(j) / slices;
+                float theta = u * 2.0f * pi;
+
+                float x = std::sin(phi) * std::cos(theta);
+                float y = std::cos(phi);
+                float z = std::sin(phi) * std::sin(theta);
+
+                // On the unit sphere the normal is the position.
+                vertices.insert(vertices.end(), { x, y, z, x, y, z, u, v });
+            }
+        }
+
+        GLuint row = static_cast<GLuint>(slices + 1);
+        for (int i = 0; i < stacks; ++i)
+        {
+            for (int j = 0; j < slices; ++j)
+            {
+                GLuint a = i * row + j;
+                GLuint b = a + row;
+
+                // Counter-clockwise seen from outside. The first and last
+                // stacks collapse to a point, so only one triangle of each
+                // quad has any area there.
+                if (i != 0)
+                {
+                    indices.insert(indices.end(), { a, a + 1, b });
+                }
+                if (i != stacks - 1)
+                {
+                    indices.insert(indices.end(), { a + 1, b + 1, b });
+                }
+            }
+        }
+
+        addMesh(vertices.data(), vertices.size() / FloatsPerVertex,
+            indices.data(), indices.size());
+    }
+
+    std::size_t SphereLod::levelCount() const
+    {
+        return mLevels.size();
+    }
+
+    SphereLod::Level const& SphereLod::level(std::size_t index) const
+    {
+        return mLevels[index];
+    }
+
+    std::vector<float> const& SphereLod::vertices() const
+    {
+        return mVertices;
+    }
+
+    std::vector<GLuint> const& SphereLod::indices() const
+    {
+        return mIndices;
+    }
+}
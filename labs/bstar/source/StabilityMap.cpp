@@ -0,0 +1,602 @@
+// Headless stability map of a planet around a binary.
+//
+// Each pixel is one planet-and-binary system, integrated and classified
+// exactly as in bstar_sweep. The map spans either the planet's semi-major
+// axis and eccentricity (the planet starting at apoapsis) or its starting
+// x and z position. The image is cut into square tiles that are run in
+// parallel, and finished bands of tiles are written as soon as every band
+// above them is out, so only a few bands are ever held in memory.
+//
+// Output is an 8-bit PGM image or a PFM float grid. For --value outcome
+// the PGM shades escaped, collided, chaotic, undecided and stable from
+// black to white; the other values are scaled from --range onto 0-255.
+// --deterministic runs the kernel built without FMA contraction, as in
+// bstar_sweep, so maps from different machines match pixel for pixel.
+//
+// Usage: bstar_map [--map ae|xz] [--x LO:HI] [--y LO:HI] [--width N]
+//        [--height N] [--tile N] [--planet-mass M] [--star1-mass M]
+//        [--star2-mass M] [--separation D] [--speed-scale S] [--dt DT]
+//        [--steps N] [--escape-radius R] [--collision-radius R]
+//        [--megno-time T] [--chaotic-megno Y] [--stable-tolerance D]
+//        [--stable-time T] [--value outcome|megno|lyapunov|time]
+//        [--range LO:HI] [--deterministic] [--format pgm|pfm]
+//        [--threads N] [--out FILE]
+
+#include "BinaryEnsemble.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using namespace bstar;
+
+    enum class MapKind
+    {
+        SemiMajorEccentricity,
+        StartPosition
+    };
+
+    enum class MapValue
+    {
+        Outcome,
+        Megno,
+        Lyapunov,
+        Time
+    };
+
+    // Grey level of each Outcome in a PGM outcome map.
+    const unsigned char outcomeShades[] = { 0, 0, 64, 128, 255, 192 };
+    constexpr int OutcomeCount = 6;
+
+    struct MapOptions
+    {
+        MapKind kind = MapKind::SemiMajorEccentricity;
+        double xLo = 6.0;
+        double xHi = 30.0;
+        double yLo = 0.0;
+        double yHi = 0.9;
+        std::size_t width = 512;
+        std::size_t height = 512;
+        std::size_t tile = 32;
+
+        // The rest of the system is the viewer's starting one.
+        double planetMass = 1.0e11;
+        double firstStarMass = 1.0e13;
+        double secondStarMass = 1.0e13;
+        double separation = 6.0;
+        double speedScale = 1.0;
+        double dt = 1.0 / 60.0;
+        std::size_t steps = 36000;
+        ClassifierSettings classifier;
+        bool deterministic = false;
+
+        MapValue value = MapValue::Outcome;
+        double rangeLo = 0.0;
+        double rangeHi = 8.0;
+        std::string format = "pgm";
+        unsigned int threads = 0;
+        std::string out;
+    };
+
+    bool parseInterval(const char* text, double& lo, double& hi)
+    {
+        char* end = nullptr;
+        lo = std::strtod(text, &end);
+        if (end == text || *end != ':')
+        {
+            return false;
+        }
+
+        const char* hiText = end + 1;
+        hi = std::strtod(hiText, &end);
+        return end != hiText && *end == '\0';
+    }
+
+    bool parseOptions(int argc, char** argv, MapOptions& options)
+    {
+        bool xSet = false;
+        bool ySet = false;
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "--deterministic")
+            {
+                options.deterministic = true;
+                continue;
+            }
+
+            if (i + 1 >= argc)
+            {
+                std::fprintf(stderr, "missing value for %s\n", arg.c_str());
+                return false;
+            }
+
+            std::string value = argv[++i];
+            if (arg == "--map")
+            {
+                if (value == "ae")
+                {
+                    options.kind = MapKind::SemiMajorEccentricity;
+                }
+                else if (value == "xz")
+                {
+                    options.kind = MapKind::StartPosition;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            else if (arg == "--x" || arg == "--y" || arg == "--range")
+            {
+                double& lo = (arg == "--x") ? options.xLo :
+                    (arg == "--y") ? options.yLo : options.rangeLo;
+                double& hi = (arg == "--x") ? options.xHi :
+                    (arg == "--y") ? options.yHi : options.rangeHi;
+                if (!parseInterval(value.c_str(), lo, hi))
+                {
+                    std::fprintf(stderr, "bad interval %s for %s\n",
+                        value.c_str(), arg.c_str());
+                    return false;
+                }
+                xSet = xSet || arg == "--x";
+                ySet = ySet || arg == "--y";
+            }
+            else if (arg == "--width")
+            {
+                options.width = std::strtoul(value.c_str(), nullptr, 10);
+            }
+            else if (arg == "--height")
+            {
+                options.height = std::strtoul(value.c_str(), nullptr, 10);
+            }
+            else if (arg == "--tile")
+            {
+                options.tile = std::strtoul(value.c_str(), nullptr, 10);
+            }
+            else if (arg == "--planet-mass")
+            {
+                options.planetMass = std::strtod(value.c_str(), nullptr);
+            }
+            else if (arg == "--star1-mass")
+            {
+                options.firstStarMass = std::strtod(value.c_str(), nullptr);
+            }
+            else if (arg == "--star2-mass")
+            {
+                options.secondStarMass = std::strtod(value.c_str(), nullptr);
+            }
+            else if (arg == "--separation")
+            {
+                options.separation = std::strtod(value.c_str(), nullptr);
+            }
+            else if (arg == "--speed-scale")
+            {
+                options.speedScale = std::strtod(value.c_str(), nullptr);
+            }
+            else if (arg == "--dt")
+            {
+                options.dt = std::strtod(value.c_str(), nullptr);
+            }
+            else if (arg == "--steps")
+            {
+                options.steps = std::strtoul(value.c_str(), nullptr, 10);
+            }
+            else if (arg == "--escape-radius")
+            {
+                options.classifier.escapeRadius =
+                    std::strtod(value.c_str(), nullptr);
+            }
+            else if (arg == "--collision-radius")
+            {
+                options.classifier.collisionRadius =
+                    std::strtod(value.c_str(), nullptr);
+            }
+            else if (arg == "--megno-time")
+            {
+                options.classifier.megnoTime =
+                    std::strtod(value.c_str(), nullptr);
+            }
+            else if (arg == "--chaotic-megno")
+            {
+                options.classifier.chaoticMegno =
+                    std::strtod(value.c_str(), nullptr);
+            }
+            else if (arg == "--stable-tolerance")
+            {
+                options.classifier.stableTolerance =
+                    std::strtod(value.c_str(), nullptr);
+            }
+            else if (arg == "--stable-time")
+            {
+                options.classifier.stableTime =
+                    std::strtod(value.c_str(), nullptr);
+            }
+            else if (arg == "--value")
+            {
+                if (value == "outcome")
+                {
+                    options.value = MapValue::Outcome;
+                }
+                else if (value == "megno")
+                {
+                    options.value = MapValue::Megno;
+                }
+                else if (value == "lyapunov")
+                {
+                    options.value = MapValue::Lyapunov;
+                }
+                else if (value == "time")
+                {
+                    options.value = MapValue::Time;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            else if (arg == "--format")
+            {
+                options.format = value;
+            }
+            else if (arg == "--threads")
+            {
+                options.threads = std::strtoul(value.c_str(), nullptr, 10);
+            }
+            else if (arg == "--out")
+            {
+                options.out = value;
+            }
+            else
+            {
+                std::fprintf(stderr, "unknown option %s\n", arg.c_str());
+                return false;
+            }
+        }
+
+        // A position map wants both axes to span the same sort of distance.
+        if (options.kind == MapKind::StartPosition)
+        {
+            options.xLo = xSet ? options.xLo : -30.0;
+            options.xHi = xSet ? options.xHi : 30.0;
+            options.yLo = ySet ? options.yLo : -30.0;
+            options.yHi = ySet ? options.yHi : 30.0;
+        }
+
+        return options.width > 0 && options.height > 0 && options.tile > 0 &&
+            options.dt > 0.0 && options.steps > 0 &&
+            (options.format == "pgm" || options.format == "pfm");
+    }
+
+    // PGM rows run top to bottom and PFM rows bottom to top, so the file
+    // row maps onto y accordingly and both are written in file order.
+    double pixelX(MapOptions const& options, std::size_t column)
+    {
+        return options.xLo + (options.xHi - options.xLo) *
+            (column + 0.5) / options.width;
+    }
+
+    double pixelY(MapOptions const& options, std::size_t row)
+    {
+        double t = (row + 0.5) / options.height;
+        return (options.format == "pgm") ?
+            options.yHi - (options.yHi - options.yLo) * t :
+            options.yLo + (options.yHi - options.yLo) * t;
+    }
+
+    SystemParameters parametersOf(MapOptions const& options, double x,
+        double y)
+    {
+        SystemParameters params;
+        params.planetMass = options.planetMass;
+        params.firstStarMass = options.firstStarMass;
+        params.secondStarMass = options.secondStarMass;
+        params.separation = options.separation;
+        if (options.kind == MapKind::SemiMajorEccentricity)
+        {
+            // At apoapsis the speed is the circular speed scaled by
+            // sqrt(1 - e).
+            double e = std::min(std::max(y, 0.0), 0.999);
+            params.planetX = 0.0;
+            params.planetZ = x * (1.0 + e);
+            params.speedScale = std::sqrt(1.0 - e);
+        }
+        else
+        {
+            params.planetX = x;
+            params.planetZ = y;
+            params.speedScale = options.speedScale;
+        }
+        return params;
+    }
+
+    float valueOf(MapOptions const& options, SystemResult const& result)
+    {
+        switch (options.value)
+        {
+        case MapValue::Megno:
+            return static_cast<float>(result.megno);
+        case MapValue::Lyapunov:
+            return static_cast<float>(result.lyapunov);
+        case MapValue::Time:
+            return static_cast<float>(result.time);
+        default:
+            return static_cast<float>(static_cast<int>(result.outcome));
+        }
+    }
+
+    // Rows of tiles completed out of order wait here until every band
+    // above them has been written. Workers do not start a tile more than
+    // the window's worth of bands ahead of the writer.
+    class BandWriter
+    {
+    public:
+        BandWriter(MapOptions const& options, std::FILE* out,
+            std::size_t window) :
+            mOptions(options),
+            mOut(out),
+            mTilesPerBand((options.width + options.tile - 1) / options.tile),
+            mWritten(0),
+            mBands(window),
+            mRemaining(window, mTilesPerBand),
+            mLine(options.width)
+        {
+            for (auto& band : mBands)
+            {
+                band.resize(options.width * options.tile);
+            }
+        }
+
+        // Blocks until the band may be filled, then returns its rows.
+        float* acquire(std::size_t band)
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCanFill.wait(lock, [this, band]()
+            {
+                return band < mWritten + mBands.size();
+            });
+            return mBands[band % mBands.size()].data();
+        }
+
+        void complete(std::size_t band)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            --mRemaining[band % mBands.size()];
+
+            bool flushed = false;
+            while (mWritten * mOptions.tile < mOptions.height &&
+                mRemaining[mWritten % mBands.size()] == 0)
+            {
+                std::size_t slot = mWritten % mBands.size();
+                writeBand(mBands[slot], mWritten);
+                mRemaining[slot] = mTilesPerBand;
+                ++mWritten;
+                flushed = true;
+            }
+
+            if (flushed)
+            {
+                mCanFill.notify_all();
+            }
+        }
+
+    private:
+        void writeBand(std::vector<float> const& band, std::size_t index)
+        {
+            std::size_t rows = std::min(mOptions.tile,
+                mOptions.height - index * mOptions.tile);
+            for (std::size_t r = 0; r < rows; ++r)
+            {
+                float const* row = band.data() + r * mOptions.width;
+                if (mOptions.format == "pfm")
+                {
+                    std::fwrite(row, sizeof(float), mOptions.width, mOut);
+                    continue;
+                }
+
+                for (std::size_t c = 0; c < mOptions.width; ++c)
+                {
+                    mLine[c] = shade(row[c]);
+                }
+                std::fwrite(mLine.data(), 1, mOptions.width, mOut);
+            }
+        }
+
+        unsigned char shade(float value) const
+        {
+            if (mOptions.value == MapValue::Outcome)
+            {
+                int outcome = static_cast<int>(value);
+                return outcomeShades[std::min(std::max(outcome, 0),
+                    OutcomeCount - 1)];
+            }
+
+            double t = (value - mOptions.rangeLo) /
+                (mOptions.rangeHi - mOptions.rangeLo);
+            t = std::isfinite(t) ? std::min(std::max(t, 0.0), 1.0) : 1.0;
+            return static_cast<unsigned char>(t * 255.0 + 0.5);
+        }
+
+        MapOptions const& mOptions;
+        std::FILE* mOut;
+        std::size_t mTilesPerBand;
+        std::size_t mWritten;
+        std::vector<std::vector<float>> mBands;
+        std::vector<std::size_t> mRemaining;
+        std::vector<unsigned char> mLine;
+        std::mutex mMutex;
+        std::condition_variable mCanFill;
+    };
+
+    struct TileStats
+    {
+        std::size_t counts[OutcomeCount] = {};
+        double steps = 0.0;
+    };
+
+    void runTile(MapOptions const& options, std::size_t band,
+        std::size_t column, float* rows, TileStats& stats)
+    {
+        std::size_t row0 = band * options.tile;
+        std::size_t col0 = column * options.tile;
+        std::size_t tileRows = std::min(options.tile, options.height - row0);
+        std::size_t tileCols = std::min(options.tile, options.width - col0);
+
+        std::vector<SystemParameters> params;
+        params.reserve(tileRows * tileCols);
+        for (std::size_t r = 0; r < tileRows; ++r)
+        {
+            double y = pixelY(options, row0 + r);
+            for (std::size_t c = 0; c < tileCols; ++c)
+            {
+                params.push_back(parametersOf(options,
+                    pixelX(options, col0 + c), y));
+            }
+        }
+
+        BinaryEnsemble ensemble;
+        ensemble.setClassifier(options.classifier);
+        ensemble.setDeterministic(options.deterministic);
+        ensemble.setup(params.data(), params.size());
+        ensemble.run(options.dt, options.steps);
+
+        std::vector<SystemResult> results(params.size());
+        ensemble.results(results.data());
+        for (std::size_t r = 0; r < tileRows; ++r)
+        {
+            for (std::size_t c = 0; c < tileCols; ++c)
+            {
+                SystemResult const& result = results[r * tileCols + c];
+                rows[r * options.width + col0 + c] =
+                    valueOf(options, result);
+                ++stats.counts[static_cast<int>(result.outcome)];
+                stats.steps += static_cast<double>(result.steps);
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    using Clock = std::chrono::steady_clock;
+
+    MapOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        std::fprintf(stderr, "usage: %s [--map ae|xz] [--x LO:HI] "
+            "[--y LO:HI] [--width N] [--height N] [--tile N] "
+            "[--planet-mass M] [--star1-mass M] [--star2-mass M] "
+            "[--separation D] [--speed-scale S] [--dt DT] [--steps N] "
+            "[--escape-radius R] [--collision-radius R] [--megno-time T] "
+            "[--chaotic-megno Y] [--stable-tolerance D] [--stable-time T] "
+            "[--value outcome|megno|lyapunov|time] [--range LO:HI] "
+            "[--deterministic] [--format pgm|pfm] [--threads N] "
+            "[--out FILE]\n", argv[0]);
+        return 1;
+    }
+
+    std::FILE* out = stdout;
+    if (!options.out.empty())
+    {
+        out = std::fopen(options.out.c_str(), "wb");
+        if (out == nullptr)
+        {
+            std::fprintf(stderr, "could not open %s\n", options.out.c_str());
+            return 1;
+        }
+    }
+
+    if (options.format == "pfm")
+    {
+        // Negative scale marks little-endian floats.
+        std::fprintf(out, "Pf\n%zu %zu\n-1.0\n", options.width,
+            options.height);
+    }
+    else
+    {
+        std::fprintf(out, "P5\n%zu %zu\n255\n", options.width,
+            options.height);
+    }
+
+    unsigned int threads = options.threads;
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Tiles are handed out band by band, so bands finish roughly in order
+    // and two bands per worker is enough slack to keep every worker busy.
+    std::size_t tilesPerBand = (options.width + options.tile - 1) /
+        options.tile;
+    std::size_t bands = (options.height + options.tile - 1) / options.tile;
+    std::size_t tiles = tilesPerBand * bands;
+    BandWriter writer(options, out, std::min<std::size_t>(2 * threads,
+        bands));
+    std::vector<TileStats> stats(threads);
+
+    auto start = Clock::now();
+    std::atomic<std::size_t> next(0);
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]()
+        {
+            std::size_t tile;
+            while ((tile = next.fetch_add(1)) < tiles)
+            {
+                std::size_t band = tile / tilesPerBand;
+                float* rows = writer.acquire(band);
+                runTile(options, band, tile % tilesPerBand, rows, stats[t]);
+                writer.complete(band);
+            }
+        });
+    }
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(
+        Clock::now() - start).count();
+
+    if (out != stdout)
+    {
+        std::fclose(out);
+    }
+
+    TileStats total;
+    for (auto const& s : stats)
+    {
+        for (int o = 0; o < OutcomeCount; ++o)
+        {
+            total.counts[o] += s.counts[o];
+        }
+        total.steps += s.steps;
+    }
+
+    std::size_t pixels = options.width * options.height;
+    std::fprintf(stderr, "%zux%zu map in %zu tiles, %.3f s on %u threads "
+        "(%.1f ns per system-step taken)\n", options.width, options.height,
+        tiles, seconds, threads, 1e9 * seconds / std::max(total.steps, 1.0));
+    const char* names[] = { "running", "escaped", "collided", "chaotic",
+        "stable", "undecided" };
+    for (int o = 1; o < OutcomeCount; ++o)
+    {
+        std::fprintf(stderr, "%s%s %zu", (o == 1) ? "" : ", ", names[o],
+            total.counts[o]);
+    }
+    std::fprintf(stderr, "; early termination skipped %.1f%% of steps\n",
+        100.0 * (1.0 - total.steps /
+        (static_cast<double>(pixels) * options.steps)));
+    return 0;
+}
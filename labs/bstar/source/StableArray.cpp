@@ -0,0 +1,85 @@
+#include "StableArray.hpp"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace bstar
+{
+    namespace addressspace
+    {
+        std::size_t pageSize()
+        {
+#if defined(_WIN32)
+            static std::size_t const size = []()
+            {
+                SYSTEM_INFO info;
+                GetSystemInfo(&info);
+                return static_cast<std::size_t>(info.dwPageSize);
+            }();
+#else
+            static std::size_t const size =
+                static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#endif
+            return size;
+        }
+
+        void* reserve(std::size_t bytes)
+        {
+#if defined(_WIN32)
+            void* start = VirtualAlloc(nullptr, bytes, MEM_RESERVE,
+                PAGE_NOACCESS);
+            if (start == nullptr)
+            {
+                throw std::bad_alloc();
+            }
+#else
+            // Reserved pages count against nothing until they are
+            // committed.
+            void* start = mmap(nullptr, bytes, PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (start == MAP_FAILED)
+            {
+                throw std::bad_alloc();
+            }
+#endif
+            return start;
+        }
+
+        void commit(void* start, std::size_t bytes)
+        {
+            if (bytes == 0)
+            {
+                return;
+            }
+
+#if defined(_WIN32)
+            if (VirtualAlloc(start, bytes, MEM_COMMIT, PAGE_READWRITE) ==
+                nullptr)
+            {
+                throw std::bad_alloc();
+            }
+#else
+            if (mprotect(start, bytes, PROT_READ | PROT_WRITE) != 0)
+            {
+                throw std::bad_alloc();
+            }
+#endif
+        }
+
+        void release(void* start, std::size_t bytes)
+        {
+#if defined(_WIN32)
+            (void)bytes;
+            VirtualFree(start, 0, MEM_RELEASE);
+#else
+            munmap(start, bytes);
+#endif
+        }
+    }
+}
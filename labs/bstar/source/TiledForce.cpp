@@ -0,0 +1,239 @@
+#include "TiledForce.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace bstar
+{
+    namespace
+    {
+        // Pulls between target bodies [firstI, endI) and source bodies
+        // [firstJ, endJ), or between the pairs of a single tile when the
+        // ranges are the same. Coincident bodies add nothing, as in
+        // gravityPair.
+        template <class Law>
+        void lawTile(PairArrays const& b, std::size_t firstI,
+            std::size_t endI, std::size_t firstJ, std::size_t endJ,
+            Law const& law)
+        {
+            constexpr double G = ForceBackend::G;
+            bool self = (firstI == firstJ);
+            std::size_t sources = endJ - firstJ;
+
+            // The sources' reactions gather in locals, which the compiler
+            // knows alias nothing, and are written out once per tile pair.
+            double reactX[TiledForce::TileSize];
+            double reactY[TiledForce::TileSize];
+            double reactZ[TiledForce::TileSize];
+            for (std::size_t j = 0; j < sources; ++j)
+            {
+                reactX[j] = 0.0;
+                reactY[j] = 0.0;
+                reactZ[j] = 0.0;
+            }
+
+            double const* x = b.x + firstJ;
+            double const* y = b.y + firstJ;
+            double const* z = b.z + firstJ;
+            double const* mass = b.mass + firstJ;
+            for (std::size_t i = firstI; i < endI; ++i)
+            {
+                double xi = b.x[i];
+                double yi = b.y[i];
+                double zi = b.z[i];
+                double mi = b.mass[i];
+                double sumX = 0.0;
+                double sumY = 0.0;
+                double sumZ = 0.0;
+
+                std::size_t first = self ? i - firstI + 1 : 0;
+                for (std::size_t j = first; j < sources; ++j)
+                {
+                    double dx = x[j] - xi;
+                    double dy = y[j] - yi;
+                    double dz = z[j] - zi;
+                    double r2 = dx * dx + dy * dy + dz * dz;
+                    double safe = (r2 > 0.0) ? r2 : 1.0;
+                    double pull = G * law(safe);
+                    double pullI = mass[j] * pull;
+                    double pullJ = mi * pull;
+                    sumX += dx * pullI;
+                    sumY += dy * pullI;
+                    sumZ += dz * pullI;
+                    reactX[j] -= dx * pullJ;
+                    reactY[j] -= dy * pullJ;
+                    reactZ[j] -= dz * pullJ;
+                }
+
+                b.ax[i] += sumX;
+                b.ay[i] += sumY;
+                b.az[i] += sumZ;
+            }
+
+            for (std::size_t j = 0; j < sources; ++j)
+            {
+                b.ax[firstJ + j] += reactX[j];
+                b.ay[firstJ + j] += reactY[j];
+                b.az[firstJ + j] += reactZ[j];
+            }
+        }
+
+        template <class Law, class Term>
+        void sumTile(PairArrays const& b, std::size_t firstI,
+            std::size_t endI, std::size_t firstJ, std::size_t endJ,
+            Law const& law, Term const& term)
+        {
+            bool self = (firstI == firstJ);
+            for (std::size_t i = firstI; i < endI; ++i)
+            {
+                for (std::size_t j = self ? i + 1 : firstJ; j < endJ; ++j)
+                {
+                    gravityPair(b, i, j, ForceBackend::G, law, term);
+                }
+            }
+        }
+
+        // Without a term the dedicated kernel vectorizes.
+        template <class Law>
+        void sumTile(PairArrays const& b, std::size_t firstI,
+            std::size_t endI, std::size_t firstJ, std::size_t endJ,
+            Law const& law, NoPairTerm const&)
+        {
+            lawTile(b, firstI, endI, firstJ, endJ, law);
+        }
+    }
+
+    // Bound by reference in std::min, so they need definitions.
+    constexpr std::size_t TiledForce::TileSize;
+    constexpr std::size_t TiledForce::MinParallelBodies;
+
+    TiledForce::TiledForce() :
+        mThreads(0),
+        mNextPair(0)
+    { }
+
+    void TiledForce::setThreads(std::size_t threads)
+    {
+        mThreads = threads;
+    }
+
+    std::size_t TiledForce::threads() const
+    {
+        if (mThreads == 0)
+        {
+            return std::max(1u, std::thread::hardware_concurrency());
+        }
+        return mThreads;
+    }
+
+    void TiledForce::accelerations(BodyArray const& x, BodyArray const& y,
+        BodyArray const& z, BodyArray const& vx, BodyArray const& vy,
+        BodyArray const& vz, BodyArray const& mass, BodyArray& ax,
+        BodyArray& ay, BodyArray& az)
+    {
+        std::size_t count = mass.size();
+
+        ax.assign(count, 0.0);
+        ay.assign(count, 0.0);
+        az.assign(count, 0.0);
+
+        PairArrays bodies = { x.data(), y.data(), z.data(), vx.data(),
+            vy.data(), vz.data(), mass.data(), ax.data(), ay.data(),
+            az.data() };
+        visitKernels([&](auto const& law, auto const& term)
+        {
+            sumTiles(bodies, count, law, term);
+        });
+    }
+
+    template <class Law, class Term>
+    void TiledForce::sumTiles(PairArrays const& bodies, std::size_t count,
+        Law const& law, Term const& term)
+    {
+        std::size_t tiles = (count + TileSize - 1) / TileSize;
+        std::size_t pairs = tiles * (tiles + 1) / 2;
+        if (mTileFirst.size() != pairs)
+        {
+            // Pairs sharing a target tile are adjacent, so a thread that
+            // takes several in a row keeps its targets' sums warm.
+            mTileFirst.clear();
+            mTileSecond.clear();
+            for (std::uint32_t a = 0; a < tiles; ++a)
+            {
+                for (std::uint32_t b = a; b < tiles; ++b)
+                {
+                    mTileFirst.push_back(a);
+                    mTileSecond.push_back(b);
+                }
+            }
+        }
+
+        std::size_t threads = (count < MinParallelBodies) ? 1 :
+            this->threads();
+        if (threads > 1 && (!mPool || mPool->size() != threads))
+        {
+            mPool.reset(new WorkerPool(threads));
+            mSumX.resize(threads - 1);
+            mSumY.resize(threads - 1);
+            mSumZ.resize(threads - 1);
+        }
+
+        mNextPair.store(0, std::memory_order_relaxed);
+        auto sumPairs = [&](std::size_t thread)
+        {
+            PairArrays own = bodies;
+            if (thread > 0)
+            {
+                for (auto sums : { &mSumX, &mSumY, &mSumZ })
+                {
+                    (*sums)[thread - 1].assign(count, 0.0);
+                }
+                own.ax = mSumX[thread - 1].data();
+                own.ay = mSumY[thread - 1].data();
+                own.az = mSumZ[thread - 1].data();
+            }
+
+            for (;;)
+            {
+                std::size_t pair = mNextPair.fetch_add(1,
+                    std::memory_order_relaxed);
+                if (pair >= pairs)
+                {
+                    break;
+                }
+
+                std::size_t firstI = mTileFirst[pair] * TileSize;
+                std::size_t firstJ = mTileSecond[pair] * TileSize;
+                sumTile(own, firstI, std::min(firstI + TileSize, count),
+                    firstJ, std::min(firstJ + TileSize, count), law, term);
+            }
+        };
+
+        if (threads == 1)
+        {
+            sumPairs(0);
+            return;
+        }
+        mPool->run(sumPairs);
+
+        // Each thread adds every buffer into its own slice of the output.
+        mPool->run([&](std::size_t thread)
+        {
+            std::size_t first = count * thread / threads;
+            std::size_t end = count * (thread + 1) / threads;
+            for (std::size_t t = 0; t + 1 < threads; ++t)
+            {
+                double const* sumX = mSumX[t].data();
+                double const* sumY = mSumY[t].data();
+                double const* sumZ = mSumZ[t].data();
+                for (std::size_t i = first; i < end; ++i)
+                {
+                    bodies.ax[i] += sumX[i];
+                    bodies.ay[i] += sumY[i];
+                    bodies.az[i] += sumZ[i];
+                }
+            }
+        });
+    }
+}
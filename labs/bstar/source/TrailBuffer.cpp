@@ -0,0 +1,152 @@
+#include "TrailBuffer.hpp"
+
+#include <algorithm>
+
+namespace bstar
+{
+    TrailBuffer::TrailBuffer() :
+        mBuffer(0),
+        mTexture(0),
+        mBodies(0),
+        mRequested(256),
+        mCapacity(256),
+        mHead(0),
+        mCount(0),
+        mPendingRows(0)
+    {
+        glGenBuffers(1, &mBuffer);
+        glGenTextures(1, &mTexture);
+    }
+
+    TrailBuffer::~TrailBuffer()
+    {
+        glDeleteTextures(1, &mTexture);
+        glDeleteBuffers(1, &mBuffer);
+    }
+
+    void TrailBuffer::setCapacity(std::size_t capacity)
+    {
+        mRequested = std::max<std::size_t>(capacity, 2);
+        reset(mBodies);
+    }
+
+    void TrailBuffer::clear()
+    {
+        reset(mBodies);
+    }
+
+    void TrailBuffer::push(std::vector<atlas::math::Vector4> const& points)
+    {
+        if (points.size() != mBodies)
+        {
+            reset(points.size());
+        }
+
+        if (mBodies == 0)
+        {
+            return;
+        }
+
+        // Rows older than a full trail would be overwritten in the same
+        // upload anyway.
+        if (mPendingRows == mCapacity)
+        {
+            mPending.erase(mPending.begin(), mPending.begin() + mBodies);
+            --mPendingRows;
+        }
+
+        mPending.insert(mPending.end(), points.begin(), points.end());
+        ++mPendingRows;
+
+        mHead = (mHead + 1) % mCapacity;
+        mCount = std::min(mCount + 1, mCapacity);
+    }
+
+    void TrailBuffer::upload()
+    {
+        namespace math = atlas::math;
+
+        if (mPendingRows == 0)
+        {
+            return;
+        }
+
+        // The pending rows end just before the head and may wrap around
+        // the end of the ring.
+        std::size_t first = (mHead + mCapacity - mPendingRows) % mCapacity;
+        std::size_t rowBytes = mBodies * sizeof(math::Vector4);
+        std::size_t head = std::min(mPendingRows, mCapacity - first);
+
+        glBindBuffer(GL_TEXTURE_BUFFER, mBuffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, first * rowBytes, head * rowBytes,
+            mPending.data());
+        if (head < mPendingRows)
+        {
+            glBufferSubData(GL_TEXTURE_BUFFER, 0,
+                (mPendingRows - head) * rowBytes,
+                mPending.data() + head * mBodies);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        mPending.clear();
+        mPendingRows = 0;
+    }
+
+    void TrailBuffer::bindTexture(GLenum unit) const
+    {
+        glActiveTexture(unit);
+        glBindTexture(GL_TEXTURE_BUFFER, mTexture);
+    }
+
+    std::size_t TrailBuffer::bodies() const
+    {
+        return mBodies;
+    }
+
+    std::size_t TrailBuffer::capacity() const
+    {
+        return mCapacity;
+    }
+
+    std::size_t TrailBuffer::count() const
+    {
+        return mCount;
+    }
+
+    std::size_t TrailBuffer::oldest() const
+    {
+        return (mHead + mCapacity - mCount) % mCapacity;
+    }
+
+    void TrailBuffer::reset(std::size_t bodies)
+    {
+        namespace math = atlas::math;
+
+        mBodies = bodies;
+        mHead = 0;
+        mCount = 0;
+        mPending.clear();
+        mPendingRows = 0;
+
+        // Large runs shorten the trails rather than outgrow what a buffer
+        // texture can address.
+        GLint maxTexels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        mCapacity = mRequested;
+        if (mBodies != 0)
+        {
+            mCapacity = std::max<std::size_t>(2, std::min(mCapacity,
+                static_cast<std::size_t>(maxTexels) / mBodies));
+        }
+
+        glBindBuffer(GL_TEXTURE_BUFFER, mBuffer);
+        glBufferData(GL_TEXTURE_BUFFER,
+            mBodies * mCapacity * sizeof(math::Vector4), nullptr,
+            GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        glBindTexture(GL_TEXTURE_BUFFER, mTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, mBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+}
@@ -0,0 +1,137 @@
+#include "VisibilityGrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace bstar
+{
+    VisibilityGrid::VisibilityGrid() :
+        mInstances(nullptr),
+        mResolution(1),
+        mMin(0.0f),
+        mInvCellSize(0.0f)
+    { }
+
+    void VisibilityGrid::build(std::vector<BodyInstance> const& instances)
+    {
+        namespace math = atlas::math;
+
+        mInstances = &instances;
+        mOccupied.clear();
+
+        std::size_t count = instances.size();
+        if (count == 0)
+        {
+            mCellStart.assign(2, 0);
+            return;
+        }
+
+        const float inf = std::numeric_limits<float>::max();
+        math::Point lo(inf), hi(-inf);
+        for (auto const& instance : instances)
+        {
+            lo = glm::min(lo, math::Point(instance.sphere));
+            hi = glm::max(hi, math::Point(instance.sphere));
+        }
+
+        // Cubic cells over the longest side keep the cell test cheap; a
+        // flat disc of bodies simply leaves most layers empty.
+        float extent = std::max(hi.x - lo.x, std::max(hi.y - lo.y,
+            hi.z - lo.z));
+        int resolution = static_cast<int>(std::ceil(std::cbrt(
+            static_cast<float>(count) / BodiesPerCell)));
+        mResolution = std::min(std::max(resolution, 1), MaxResolution);
+        mMin = lo;
+        mInvCellSize = (extent > 0.0f) ? mResolution / extent : 0.0f;
+
+        std::size_t cells = std::size_t(mResolution) * mResolution *
+            mResolution;
+        mCellStart.assign(cells + 1, 0);
+        mItemCells.resize(count);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            math::Point cell = (math::Point(instances[i].sphere) - mMin) *
+                mInvCellSize;
+            int x = std::min(static_cast<int>(cell.x), mResolution - 1);
+            int y = std::min(static_cast<int>(cell.y), mResolution - 1);
+            int z = std::min(static_cast<int>(cell.z), mResolution - 1);
+
+            std::uint32_t index = static_cast<std::uint32_t>(
+                (z * mResolution + y) * mResolution + x);
+            mItemCells[i] = index;
+            ++mCellStart[index + 1];
+        }
+
+        for (std::size_t c = 0; c < cells; ++c)
+        {
+            if (mCellStart[c + 1] != 0)
+            {
+                mOccupied.push_back(static_cast<std::uint32_t>(c));
+            }
+            mCellStart[c + 1] += mCellStart[c];
+        }
+
+        mCellMin.assign(cells, math::Point(inf));
+        mCellMax.assign(cells, math::Point(-inf));
+        mItems.resize(count);
+
+        mCursor.assign(mCellStart.begin(), mCellStart.end() - 1);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            std::uint32_t cell = mItemCells[i];
+            mItems[mCursor[cell]++] = static_cast<std::uint32_t>(i);
+
+            math::Point centre(instances[i].sphere);
+            math::Vector radius(instances[i].sphere.w);
+            mCellMin[cell] = glm::min(mCellMin[cell], centre - radius);
+            mCellMax[cell] = glm::max(mCellMax[cell], centre + radius);
+        }
+    }
+
+    void VisibilityGrid::query(Frustum const& frustum,
+        std::vector<std::uint32_t>& visible) const
+    {
+        namespace math = atlas::math;
+
+        if (mInstances == nullptr)
+        {
+            return;
+        }
+
+        auto const& instances = *mInstances;
+        for (std::uint32_t cell : mOccupied)
+        {
+            auto first = mItems.begin() + mCellStart[cell];
+            auto last = mItems.begin() + mCellStart[cell + 1];
+
+            switch (frustum.classifyBox(mCellMin[cell], mCellMax[cell]))
+            {
+            case Containment::Inside:
+                visible.insert(visible.end(), first, last);
+                break;
+
+            case Containment::Intersecting:
+                for (auto it = first; it != last; ++it)
+                {
+                    auto const& sphere = instances[*it].sphere;
+                    if (frustum.intersectsSphere(math::Point(sphere),
+                        sphere.w))
+                    {
+                        visible.push_back(*it);
+                    }
+                }
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+
+    std::size_t VisibilityGrid::occupiedCells() const
+    {
+        return mOccupied.size();
+    }
+}
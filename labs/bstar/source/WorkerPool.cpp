@@ -0,0 +1,101 @@
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+
+namespace bstar
+{
+    WorkerPool::WorkerPool(std::size_t threads) :
+        mJob(nullptr),
+        mCall(nullptr),
+        mGeneration(0),
+        mPending(0),
+        mStopping(false)
+    {
+        threads = std::max<std::size_t>(threads, 1);
+        mThreads.reserve(threads - 1);
+        for (std::size_t t = 1; t < threads; ++t)
+        {
+            mThreads.emplace_back(&WorkerPool::work, this, t);
+        }
+    }
+
+    WorkerPool::~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+        }
+        mStart.notify_all();
+
+        for (auto& thread : mThreads)
+        {
+            thread.join();
+        }
+    }
+
+    std::size_t WorkerPool::size() const
+    {
+        return mThreads.size() + 1;
+    }
+
+    void WorkerPool::runErased(void const* job, Call call)
+    {
+        if (mThreads.empty())
+        {
+            call(job, 0);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mJob = job;
+            mCall = call;
+            mPending = mThreads.size();
+            ++mGeneration;
+        }
+        mStart.notify_all();
+
+        call(job, 0);
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        mDone.wait(lock, [this] { return mPending == 0; });
+        mJob = nullptr;
+        mCall = nullptr;
+    }
+
+    void WorkerPool::work(std::size_t thread)
+    {
+        std::uint64_t seen = 0;
+        for (;;)
+        {
+            void const* job;
+            Call call;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mStart.wait(lock, [this, seen]
+                {
+                    return mStopping || mGeneration != seen;
+                });
+                if (mStopping)
+                {
+                    return;
+                }
+                seen = mGeneration;
+                job = mJob;
+                call = mCall;
+            }
+
+            call(job, thread);
+
+            bool last;
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                last = (--mPending == 0);
+            }
+            if (last)
+            {
+                mDone.notify_one();
+            }
+        }
+    }
+}